@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+# Simulator throughput benchmark ("make bench")
+#
+# Runs sim over the SPEC traces and a few larger synthetic traces under a set
+# of representative configurations, and reports for every run the requests
+# simulated per second and ns per request (from the simulator's CPU time,
+# fastest of several runs) and the peak RSS of the simulator.
+# Results are written as JSON (one object per run) and compared against a
+# stored baseline; runs that got slower by more than the threshold are
+# flagged as regressions and make the script exit with status 1.
+#
+#   bench/bench.py [--sim ./sim] [--out out/bench.json] [--baseline bench/baseline.json]
+#                  [--repeat 5] [--threshold 0.15] [--update-baseline]
+#
+# Timings are per machine: refresh the baseline with --update-baseline
+# ("make bench-baseline") on the machine the comparisons are made on.
+import argparse, json, os, random, struct, subprocess, sys, time
+
+repoPath = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+specTraces = ["gcc", "go", "perl", "compress", "vortex"]
+
+# name: BLOCKSIZE L1_SIZE L1_ASSOC L2_SIZE L2_ASSOC PREF_N PREF_M
+configs = {
+    "l1_direct":      "32 8192 1 0 0 0 0",
+    "l1_16way":       "64 32768 16 0 0 0 0",
+    "l1_l2":          "32 8192 4 262144 8 0 0",
+    "l1_l2_32way":    "64 32768 8 1048576 32 0 0",
+    "l1_prefetch":    "64 8192 4 0 0 8 4",
+    "l1_l2_prefetch": "32 8192 4 262144 8 4 8",
+}
+
+syntheticRecords = 2000000
+
+
+# Writes a plain-layout binary trace (see src/trace.cpp) of the given (rw, addr) requests
+def writeBinaryTrace(path, requests):
+    with open(path, "wb") as f:
+        f.write(b"CTRC" + struct.pack("<HHQ", 1, 0, len(requests)))
+        f.write(b"".join(struct.pack("<BI", 1 if rw == "w" else 0, addr) for rw, addr in requests))
+
+
+# Synthetic traces, generated once with a fixed seed and kept in out/bench/
+def syntheticTrace(name, count):
+    rng = random.Random(563)
+    requests = []
+    if name == "streams":
+        # Four interleaved sequential streams with occasional restarts
+        cursors = [rng.randrange(1 << 28) & ~63 for _ in range(4)]
+        for i in range(count):
+            s = i % 4
+            if rng.random() < 0.001:
+                cursors[s] = rng.randrange(1 << 28) & ~63
+            cursors[s] += 4
+            requests.append(("w" if rng.random() < 0.3 else "r", cursors[s] & 0xFFFFFFFF))
+    elif name == "hotcold":
+        # 80% of requests to a 256 KB hot region, the rest over 64 MB
+        for i in range(count):
+            if rng.random() < 0.8:
+                addr = 0x10000000 + rng.randrange(1 << 18)
+            else:
+                addr = 0x20000000 + rng.randrange(1 << 26)
+            requests.append(("w" if rng.random() < 0.25 else "r", addr & ~3))
+    elif name == "random":
+        # Uniform over 1 GB: almost every request misses
+        for i in range(count):
+            requests.append(("w" if rng.random() < 0.25 else "r", rng.randrange(1 << 30) & ~3))
+    return requests
+
+
+def traceList(workPath):
+    traces = []
+    for name in specTraces:
+        path = os.path.join(repoPath, "spec", "traces", f"{name}_trace.txt")
+        with open(path) as f:
+            count = sum(1 for line in f if line.strip())
+        traces.append((name, path, count))
+    for name in ["streams", "hotcold", "random"]:
+        path = os.path.join(workPath, f"{name}_{syntheticRecords}.bin")
+        if not os.path.exists(path):
+            print(f"generating {path}", file=sys.stderr)
+            writeBinaryTrace(path, syntheticTrace(name, syntheticRecords))
+        traces.append((name, path, syntheticRecords))
+    return traces
+
+
+# Runs sim once; returns (CPU seconds, wall seconds, peak RSS in KB)
+# Throughput is computed from CPU time (user + system), which other load on
+# the machine disturbs much less than wall time. The RSS comes from sim
+# itself (--report-rss): the rusage of a child also counts what this script
+# had resident when it forked.
+def runOnce(sim, config, tracePath):
+    start = time.perf_counter()
+    proc = subprocess.Popen([sim, "--report-rss"] + config.split() + [tracePath],
+                            stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+    stderr = proc.stderr.read()
+    _, status, usage = os.wait4(proc.pid, 0)
+    wall = time.perf_counter() - start
+    proc.stderr.close()
+    if status != 0:
+        sys.exit(f"error: {sim} {config} {tracePath} failed")
+    rss = [int(line.split()[1]) for line in stderr.splitlines() if line.startswith("peak_rss_kb:")]
+    return usage.ru_utime + usage.ru_stime, wall, rss[0] if rss else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Measure simulator throughput")
+    parser.add_argument("--sim", default=os.path.join(repoPath, "sim"))
+    parser.add_argument("--out", default=os.path.join(repoPath, "out", "bench.json"))
+    parser.add_argument("--baseline", default=os.path.join(repoPath, "bench", "baseline.json"))
+    parser.add_argument("--repeat", type=int, default=5, help="runs per point; the fastest one counts")
+    parser.add_argument("--threshold", type=float, default=0.15, help="slowdown that counts as a regression")
+    parser.add_argument("--update-baseline", action="store_true", help="store the results as the new baseline")
+    args = parser.parse_args()
+
+    workPath = os.path.join(repoPath, "out", "bench")
+    os.makedirs(workPath, exist_ok=True)
+    results = []
+    for traceName, tracePath, count in traceList(workPath):
+        for configName, config in configs.items():
+            runs = [runOnce(args.sim, config, tracePath) for _ in range(args.repeat)]
+            cpu = max(min(run[0] for run in runs), 1e-6)
+            results.append({
+                "trace": traceName,
+                "config": configName,
+                "params": config,
+                "accesses": count,
+                "cpu_seconds": round(cpu, 6),
+                "wall_seconds": round(min(run[1] for run in runs), 6),
+                "accesses_per_sec": round(count / cpu),
+                "ns_per_access": round(cpu * 1e9 / count, 2),
+                "peak_rss_kb": max(run[2] for run in runs),
+            })
+
+    with open(args.out, "w") as f:
+        json.dump(results, f, indent=1)
+    if args.update_baseline:
+        with open(args.baseline, "w") as f:
+            json.dump(results, f, indent=1)
+            f.write("\n")
+
+    baseline = {}
+    if os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            baseline = {(r["trace"], r["config"]): r for r in json.load(f)}
+
+    regressions = 0
+    print(f"{'trace':10} {'config':16} {'Maccess/s':>10} {'ns/access':>10} {'RSS KB':>8} {'vs base':>8}")
+    for r in results:
+        base = baseline.get((r["trace"], r["config"]))
+        change = ""
+        if base is not None:
+            ratio = r["ns_per_access"] / base["ns_per_access"]
+            change = f"{(ratio - 1) * 100:+.1f}%"
+            if ratio > 1 + args.threshold:
+                change += " REGRESSION"
+                regressions += 1
+        print(f"{r['trace']:10} {r['config']:16} {r['accesses_per_sec'] / 1e6:10.2f} {r['ns_per_access']:10.1f} {r['peak_rss_kb']:8} {change:>8}")
+    print(f"results written to {args.out}")
+    if regressions:
+        print(f"{regressions} regression(s) beyond {args.threshold * 100:.0f}% against {args.baseline}")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -8,14 +8,15 @@ blocksizes = [16, 32,64, 128]
 assoc = 4
 # No L2; No prefetching
 
-for l1Size in l1Sizes:
-    newpath = f"{expath}/out/experiment3/l1_{str(l1Size)}/"
-    mkdirCmd = f"mkdir -p {newpath} "
-    subprocess.check_call(mkdirCmd, shell=True)
-    for blocksize in blocksizes:
-        cmd = f"make BLOCKSIZE={str(blocksize)} " \
-                       f"L1_SIZE={l1Size} L1_ASSOC={str(assoc)} " \
-                       f"L2_SIZE=0 L2_ASSOC=0 " \
-                       f"PREF_N=0 PREF_M=0 test > {newpath}/blocksize_{str(blocksize)}.txt "
-        print(cmd)
-        subprocess.check_call(cmd, shell=True)
\ No newline at end of file
+newpath = f"{expath}/out/experiment3/"
+mkdirCmd = f"mkdir -p {newpath} "
+subprocess.check_call(mkdirCmd, shell=True)
+# Every (l1Size, blocksize) point is simulated in one pass of the trace by sim's sweep mode
+sweepFile = f"{newpath}/sweep.txt"
+with open(sweepFile, "w") as f:
+    sizes = ",".join(str(l1Size) for l1Size in l1Sizes)
+    blocksizeList = ",".join(str(blocksize) for blocksize in blocksizes)
+    f.write(f"{blocksizeList} {sizes} {assoc} 0 0 0 0\n")
+cmd = f"make sweep_file={sweepFile} sweep_out={newpath}/results.csv sweep"
+print(cmd)
+subprocess.check_call(cmd, shell=True)
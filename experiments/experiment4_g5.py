@@ -10,14 +10,15 @@ l2Sizes = [2**size for size in range(14,17)]
 # L1_ASSOC=4; L2_ASSOC=8
 
 blocksize = 32
-for l2Size in l2Sizes:
-    newpath = f"{expath}/out/experiment4/l2_{str(l2Size)}/"
-    mkdirCmd = f"mkdir -p {newpath} "
-    subprocess.check_call(mkdirCmd, shell=True)
-    for l1Size in l1Sizes:
-        cmd = f"make BLOCKSIZE={str(blocksize)} " \
-                       f"L1_SIZE={l1Size} L1_ASSOC=4 " \
-                       f"L2_SIZE={l2Size} L2_ASSOC=8 " \
-                       f"PREF_N=0 PREF_M=0 test > {newpath}/content_{str(l1Size)}.txt "
-        print(cmd)
-        subprocess.check_call(cmd, shell=True)
\ No newline at end of file
+newpath = f"{expath}/out/experiment4/"
+mkdirCmd = f"mkdir -p {newpath} "
+subprocess.check_call(mkdirCmd, shell=True)
+# Every (l2Size, l1Size) point is simulated in one pass of the trace by sim's sweep mode
+sweepFile = f"{newpath}/sweep.txt"
+with open(sweepFile, "w") as f:
+    l1List = ",".join(str(l1Size) for l1Size in l1Sizes)
+    l2List = ",".join(str(l2Size) for l2Size in l2Sizes)
+    f.write(f"{blocksize} {l1List} 4 {l2List} 8 0 0\n")
+cmd = f"make sweep_file={sweepFile} sweep_out={newpath}/results.csv sweep"
+print(cmd)
+subprocess.check_call(cmd, shell=True)
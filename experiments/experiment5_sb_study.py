@@ -18,11 +18,12 @@ blocksize = 16
 newpath = f"{expath}/out/experiment5/"
 mkdirCmd = f"mkdir -p {newpath} "
 subprocess.check_call(mkdirCmd, shell=True)
-for pref_n, pref_m in prefetchesBuffers:
-    cmd = f"make BLOCKSIZE={str(blocksize)} " \
-                    f"L1_SIZE={l1Size} L1_ASSOC=1 " \
-                    f"L2_SIZE=0 L2_ASSOC=0 " \
-                    f"PREF_N={str(pref_n)} PREF_M={str(pref_m)} trace_file={traceFilePath} test " \
-                    f" > {newpath}/n{str(pref_n)}m{str(pref_m)}.txt "
-    print(cmd)
-    subprocess.check_call(cmd, shell=True)
\ No newline at end of file
+# Every (PREF_N, PREF_M) point is simulated in one pass of the trace by sim's sweep mode
+sweepFile = f"{newpath}/sweep.txt"
+with open(sweepFile, "w") as f:
+    for pref_n, pref_m in prefetchesBuffers:
+        f.write(f"{blocksize} {l1Size} 1 0 0 {pref_n} {pref_m}\n")
+cmd = f"make sweep_file={sweepFile} sweep_out={newpath}/results.csv " \
+                f"trace_file={traceFilePath} sweep"
+print(cmd)
+subprocess.check_call(cmd, shell=True)
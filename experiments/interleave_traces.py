@@ -0,0 +1,35 @@
+#!/usr/bin/env python3
+# Interleaves single-core text traces into one multi-core trace for sim --cores
+#
+# The i-th input becomes core i. Requests are taken round-robin, QUANTUM at a
+# time from each core, until every input is exhausted; each output line is
+# "CORE r|w ADDRESS".
+#
+#   experiments/interleave_traces.py [--quantum 1] trace0.txt trace1.txt ... > mixed.txt
+import argparse, sys
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Interleave text traces into a multi-core trace")
+    parser.add_argument("--quantum", type=int, default=1, help="requests taken from a core in a row")
+    parser.add_argument("traces", nargs="+")
+    args = parser.parse_args()
+    if len(args.traces) > 128:
+        sys.exit("at most 128 cores")
+
+    inputs = [open(path) for path in args.traces]
+    active = list(range(len(inputs)))
+    out = sys.stdout
+    while active:
+        for core in list(active):
+            for _ in range(args.quantum):
+                line = inputs[core].readline()
+                if not line:
+                    active.remove(core)
+                    break
+                if line.strip():
+                    out.write(f"{core} {line.strip()}\n")
+
+
+if __name__ == "__main__":
+    main()
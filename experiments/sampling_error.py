@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+# Error of set sampling (sim --sample) against full simulation on the SPEC traces
+#
+# For every trace, configuration and sampling setting, prints the exact L1/L2
+# miss rates and memory traffic of a full run next to the sampled estimate,
+# its relative error and whether the exact value lies inside the estimate's
+# 95% confidence interval.
+#
+#   experiments/sampling_error.py [--sim ./sim]
+import argparse, os, re, subprocess
+
+repoPath = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+specTraces = ["gcc", "go", "perl", "compress", "vortex"]
+
+# BLOCKSIZE L1_SIZE L1_ASSOC L2_SIZE L2_ASSOC PREF_N PREF_M
+configs = [
+    "32 8192 4 262144 8 0 0",
+    "64 32768 8 1048576 16 0 0",
+]
+
+samplings = ["1/4", "1/16", "1/16 --sample-select=random:563"]
+
+metrics = ["L1 miss rate", "L2 miss rate", "memory traffic"]
+
+
+def run(sim, args):
+    return subprocess.run([sim] + args, check=True, capture_output=True, text=True).stdout
+
+
+def fullResults(output):
+    return {
+        "L1 miss rate": float(re.search(r"L1 miss rate:\s+(\S+)", output).group(1)),
+        "L2 miss rate": float(re.search(r"L2 miss rate:\s+(\S+)", output).group(1)),
+        "memory traffic": float(re.search(r"memory traffic:\s+(\S+)", output).group(1)),
+    }
+
+
+def sampledResults(output):
+    return {name: (float(value), float(halfWidth))
+            for name, value, halfWidth in re.findall(r"^(.+?):\s+(\S+) \+/- (\S+)$", output, re.M)}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare sampled estimates with full simulation")
+    parser.add_argument("--sim", default=os.path.join(repoPath, "sim"))
+    args = parser.parse_args()
+
+    inside = total = 0
+    print(f"{'trace':9} {'config':26} {'sample':18} {'metric':15} {'full':>9} {'estimate':>9} {'+/-':>8} {'error':>7}")
+    for trace in specTraces:
+        tracePath = os.path.join(repoPath, "spec", "traces", f"{trace}_trace.txt")
+        for config in configs:
+            full = fullResults(run(args.sim, config.split() + [tracePath]))
+            for sampling in samplings:
+                options = ["--sample=" + sampling.split()[0]] + sampling.split()[1:]
+                sampled = sampledResults(run(args.sim, options + config.split() + [tracePath]))
+                for metric in metrics:
+                    exact = full[metric]
+                    estimate, halfWidth = sampled[metric]
+                    error = (estimate - exact) / exact if exact != 0 else 0.0
+                    covered = abs(estimate - exact) <= halfWidth
+                    inside += covered
+                    total += 1
+                    print(f"{trace:9} {config:26} {sampling.replace('--sample-select=', ''):18} {metric:15} "
+                          f"{exact:9.4g} {estimate:9.4g} {halfWidth:8.3g} {error * 100:+6.1f}%{'' if covered else ' outside'}")
+    print(f"{inside} of {total} exact values inside the 95% confidence interval")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,50 @@
+#include <stdlib.h>
+#include <inttypes.h>
+#include <new>
+#include <atomic>
+
+// Heap allocation counting
+//
+// Built with -DCOUNT_ALLOCS=1 ("make allocheck"), the global operator new is
+// replaced by one that counts every allocation, so the simulator can check
+// that processing the trace allocates nothing once the caches are built.
+// Without it getAllocationCount() is always 0 and nothing is replaced.
+#ifndef COUNT_ALLOCS
+#define COUNT_ALLOCS 0
+#endif
+
+#if COUNT_ALLOCS
+static std::atomic<uint64_t> allocationCount(0);
+
+// The replacements are kept out of line; inlined into library code, GCC
+// would mistake free() of operator new's storage for a mismatched release.
+__attribute__((noinline)) void* operator new(size_t bytes) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* storage = malloc(bytes != 0 ? bytes : 1);
+    if (storage == nullptr) {
+        throw std::bad_alloc();
+    }
+    return storage;
+}
+
+void* operator new[](size_t bytes) {
+    return operator new(bytes);
+}
+
+__attribute__((noinline)) void operator delete(void* storage) noexcept {
+    free(storage);
+}
+
+__attribute__((noinline)) void operator delete[](void* storage) noexcept {
+    free(storage);
+}
+#endif
+
+// Heap allocations made through operator new so far
+static uint64_t getAllocationCount() {
+#if COUNT_ALLOCS
+    return allocationCount.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
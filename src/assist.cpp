@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+
+// Victim and miss caches (Jouppi, ISCA 1990)
+//
+// A small fully associative cache next to one level, probed together with
+// its sets and stream buffers. A request that misses in the sets but finds
+// its block here is served from it: the request does not count as a miss
+// and nothing is fetched from the next level.
+//    victim cache  holds the blocks the level evicted. A hit moves the block
+//                  back into its set and the block evicted for it into the
+//                  victim cache (a swap). Dirty blocks stay dirty; they are
+//                  written back only when the victim cache evicts them.
+//    miss cache    holds a clean copy of every block the level fetched. A hit
+//                  copies the block into its set again; evictions of the level
+//                  are written back as without a miss cache.
+// Both replace their least recently used entry. The entries are kept in
+// recency order, most recent first; with the handful of entries these caches
+// have, shifting them on an access costs less than any index would.
+
+enum AssistCacheKind {ASSIST_NONE=0, ASSIST_VICTIM, ASSIST_MISS};
+
+#define ASSIST_MAX_ENTRIES 1024
+
+// Counters of one victim or miss cache
+typedef
+struct {
+   uint64_t hits;	// requests that missed in the sets and were served by this cache
+   uint64_t swaps;	// victim cache hits that moved the evicted block into the victim cache
+   uint64_t writebacks;	// dirty blocks the victim cache evicted and wrote back
+} assist_counters_t;
+
+class AssistCache {
+public:
+    enum : uint32_t { NO_ENTRY = 0xFFFFFFFFu };
+
+private:
+    uint32_t kind; // an AssistCacheKind
+    uint32_t count; // entries in use, the first count of blocks and dirty
+    std::vector<uint32_t> blocks; // block numbers (tag and index), most recently used first
+    std::vector<uint8_t> dirty;
+
+    // Moves entry to the front, shifting the more recent entries back by one
+    void moveToFront(uint32_t entry) {
+        uint32_t block = blocks[entry];
+        uint8_t blockDirty = dirty[entry];
+        memmove(blocks.data() + 1, blocks.data(), entry * sizeof(uint32_t));
+        memmove(dirty.data() + 1, dirty.data(), entry * sizeof(uint8_t));
+        blocks[0] = block;
+        dirty[0] = blockDirty;
+    }
+
+public:
+    assist_counters_t counters;
+
+    AssistCache(uint32_t kind, uint32_t entries) : kind(kind), count(0), blocks(entries, 0), dirty(entries, 0) {
+        counters.hits = 0;
+        counters.swaps = 0;
+        counters.writebacks = 0;
+    }
+
+    uint32_t getKind() const {
+        return kind;
+    }
+
+    uint32_t getEntryCount() const {
+        return uint32_t(blocks.size());
+    }
+
+    // Entry holding block, or NO_ENTRY
+    uint32_t find(uint32_t block) const {
+        uint32_t entry = findTag(blocks.data(), count, block);
+        return (entry != count) ? entry : NO_ENTRY;
+    }
+
+    // Makes entry the most recently used one
+    void touch(uint32_t entry) {
+        this->moveToFront(entry);
+    }
+
+    // Removes entry; returns true if its block was dirty
+    bool take(uint32_t entry) {
+        bool wasDirty = dirty[entry] != 0;
+        count--;
+        memmove(blocks.data() + entry, blocks.data() + entry + 1, (count - entry) * sizeof(uint32_t));
+        memmove(dirty.data() + entry, dirty.data() + entry + 1, (count - entry) * sizeof(uint8_t));
+        return wasDirty;
+    }
+
+    // Adds block as the most recently used entry. If the cache was full, the
+    // least recently used entry makes room; returns true and sets *evicted
+    // and *evictedDirty to its block and dirty bit.
+    bool insert(uint32_t block, bool blockDirty, uint32_t* evicted, bool* evictedDirty) {
+        bool full = (count == blocks.size());
+        if (full) {
+            count--;
+            *evicted = blocks[count];
+            *evictedDirty = dirty[count] != 0;
+        }
+        blocks[count] = block;
+        dirty[count] = blockDirty ? 1 : 0;
+        count++;
+        this->moveToFront(count - 1);
+        return full;
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.put(count);
+        out.putVector(blocks);
+        out.putVector(dirty);
+        out.put(counters);
+    }
+
+    void restore(SnapshotReader& in) {
+        in.get(&count);
+        in.getVector(&blocks);
+        in.getVector(&dirty);
+        in.get(&counters);
+        if (count > blocks.size()) {
+            SnapshotReader::corrupt();
+        }
+    }
+
+    // Blocks held, most recently used first, in the format of the set lines of the contents
+    void printContents() const {
+        for (uint32_t entry = 0; entry < count; ++entry) {
+            printf(dirty[entry] ? "%8x D" : "%8x  ", blocks[entry]);
+        }
+        printf("\n");
+    }
+};
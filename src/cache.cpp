@@ -2,21 +2,25 @@
 #include <vector>
 #include <algorithm>
 #include <cmath>
-#include <cstdarg> // Include the cstdarg header for variable argument handling
+#include <limits>
+#include <new>
+#include <stdlib.h>
+#include "debug.cpp"
+#include "snapshot.cpp"
+#include "policy.cpp"
+#include "sampling.cpp"
+#include "classify.cpp"
+#include "tagmatch.cpp"
+#include "assist.cpp"
+#include "writebuf.cpp"
+#include "prefetch.cpp"
+#include "dram.cpp"
+#include "timing.cpp"
 
 // Address size is fixed to 32 bits
 #define ADDRESS_SIZE 32
-// Enable/disable debug prints using DEBUG macro
-# define DEBUG 0
-
-void debugPrint(const char* format, ...) {
-   #if DEBUG
-      va_list args;
-      va_start(args, format);
-      vprintf(format, args);
-      va_end(args);
-   #endif
-}
+// Size of a host cache line; Cache objects are aligned to it
+#define CACHE_LINE_SIZE 64
 // Misceallaneous functions
 class Utility {
 public:
@@ -38,85 +42,186 @@ public:
     }
 };
 
-// Memory traffic variable
-uint32_t memTraffic = 0;
-
 // Memory Block structure
+// Used as a snapshot of one way of a set when printing cache contents
 struct memBlock {
     uint32_t tag;
     bool dirtyBit;
     bool valid;
-    uint32_t lruRank;
-    uint32_t addr;
 };
 
-struct sbMemBlock {
-    uint32_t tagAndIndex;
+// Tag value held by invalid ways; only a geometry with 1-byte blocks and a
+// single set can produce it as a tag (see CacheSet::findWay)
+#define INVALID_TAG 0xFFFFFFFFu
+// Way index returned when a lookup finds nothing
+#define NO_WAY 0xFFFFFFFFu
+
+// Inclusion policy of a level towards the level above it
+//    nine       non-inclusive non-exclusive: the two levels fill and evict independently
+//    inclusive  every block of the level above is held here too; a block leaving
+//               this level is invalidated above as well (back-invalidation)
+//    exclusive  this level only holds blocks the level above evicted: a hit
+//               moves the block up and the block evicted for it down (a swap),
+//               and a miss fills the level above alone
+enum InclusionPolicy {
+    INCLUSION_NINE = 0,
+    INCLUSION_INCLUSIVE,
+    INCLUSION_EXCLUSIVE,
+    INCLUSION_POLICY_COUNT
+};
+
+static const char* const inclusionPolicyNames[INCLUSION_POLICY_COUNT] = {
+    "nine", "inclusive", "exclusive"
+};
+
+// Looks up an inclusion policy by name; returns false if there is no such policy
+static bool parseInclusionPolicy(const char* name, uint32_t* inclusion) {
+    for (uint32_t i = 0; i < INCLUSION_POLICY_COUNT; ++i) {
+        if (strcmp(name, inclusionPolicyNames[i]) == 0) {
+            *inclusion = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Storage for all the blocks of one cache level
+// Every array is laid out set after set, with a set's ways contiguous,
+// i.e. the state of way w of set s lives at position s * assoc + w
+struct TagStore {
+    std::vector<uint32_t> tags;
+    std::vector<uint8_t> valid;
+    std::vector<uint8_t> dirty;
+
+    void resize(uint32_t setCount, uint32_t assoc) {
+        size_t blockCount = size_t(setCount) * assoc;
+        tags.assign(blockCount, INVALID_TAG);
+        valid.assign(blockCount, 0);
+        dirty.assign(blockCount, 0);
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.putVector(tags);
+        out.putVector(valid);
+        out.putVector(dirty);
+    }
+
+    // Lookups rely on invalid ways holding INVALID_TAG, so that is
+    // re-established here rather than trusted to the snapshot
+    void restore(SnapshotReader& in) {
+        in.getVector(&tags);
+        in.getVector(&valid);
+        in.getVector(&dirty);
+        for (size_t i = 0; i < tags.size(); ++i) {
+            if (valid[i] > 1 || dirty[i] > 1) {
+                SnapshotReader::corrupt();
+            }
+            if (!valid[i]) {
+                tags[i] = INVALID_TAG;
+            }
+        }
+    }
 };
 
 // Stream buffer class 
+// A valid stream buffer always holds M consecutive memory blocks, so it is
+// kept as the block number (tag and index) of its first block and the number
+// of blocks it holds. Checking for a block is a range check and consuming
+// blocks from the front just moves the head forward. A new stream prefetches
+// its M blocks at once, so that time is kept once for all of them; a block
+// prefetched later, as the buffer moves along the stream, keeps its own at
+// its block number modulo M, which differs for every block the buffer holds.
+// Times are the low 32 bits of the clock; only the few requests between a
+// prefetch and its hit are ever compared, which the wrap-around keeps right.
 class StreamBuffer {
 private:
-    int M;  // size of the stream buffer
-    bool valid; // indicates if a stream buffer is valid or not
-    std::vector<sbMemBlock> buffer; // represents the collection of memory blocks within a stream buffer
+    uint32_t M;  // size of the stream buffer
+    uint32_t head; // tag and index of the first (next expected) block in the buffer
+    uint32_t length; // number of consecutive blocks held from head on; 0 if the buffer is invalid
+    uint32_t streamLast; // last block prefetched when the buffer started on its stream
+    uint32_t streamIssuedAt; // value of the clock then
+    std::vector<uint32_t> issuedAt; // value of the clock when each later block was prefetched, at its block number % M
 
 public:
     uint32_t lruRank; // keeps track of lru rank of a stream buffer
-    // Initialise all the memory blocks in a stream buffer as invalid
-    StreamBuffer(int M) : M(M), valid(false) {
-        buffer.resize(M);
-        for (int i = 0; i < M; ++i) {
-            buffer[i].tagAndIndex = -1;
-        }
+    // Initialise the stream buffer as invalid
+    StreamBuffer(uint32_t M) : M(M), head(0), length(0), streamLast(0), streamIssuedAt(0), issuedAt(M, 0), lruRank(0) {
     }
 
     // Function to check the validity of a stream buffer
     bool isValid() {
-        return valid;
+        return length != 0;
     }
 
-    // function to update the validity of a stream buffer
-    void setValid(bool value) {
-        valid = value;
+    // Check if Stream Buffer has a memory block
+    // Unsigned wrap-around makes blocks before head compare as out of range
+    bool hasSBMemoryBlock(uint32_t tagAndIndex) {
+        return tagAndIndex - head < length;
     }
 
-    // Getter for memory blocks vector
-    std::vector<sbMemBlock>& getSBMemoryBlocks() {
-        return this->buffer;
+    // Position of a memory block the buffer holds; 0 is the head
+    uint32_t getSBMemoryBlockPosition(uint32_t tagAndIndex) {
+        return tagAndIndex - head;
     }
 
-    // Check if Stream Buffer has a memory block
-    bool hasSBMemoryBlock(uint32_t tagAndIndex) {
-        bool value = false;
-        if (this-> isValid()) {
-            for (auto& sbMemBlock : buffer) {
-                if (sbMemBlock.tagAndIndex == tagAndIndex) {
-                    value = true;
-                    break;
-                }
-            }
+    // Make the buffer hold the M blocks starting at first
+    void setBlocks(uint32_t first) {
+        head = first;
+        length = M;
+    }
+
+    // Number of blocks the buffer holds
+    uint32_t getLength() const {
+        return length;
+    }
+
+    // Make the buffer start on the stream of the M blocks from first on, prefetched at time
+    void startStream(uint32_t first, uint32_t time) {
+        this->setBlocks(first);
+        streamLast = first + M - 1;
+        streamIssuedAt = time;
+    }
+
+    // Value of the clock when a block the buffer holds was prefetched
+    uint32_t getIssuedAt(uint32_t tagAndIndex) const {
+        return (int32_t(tagAndIndex - streamLast) <= 0) ? streamIssuedAt : issuedAt[tagAndIndex % M];
+    }
+
+    // Record that count blocks from first on were prefetched at time
+    void setIssuedAt(uint32_t first, uint32_t count, uint32_t time) {
+        uint32_t slot = first % M;
+        for (uint32_t i = 0; i < count; ++i) {
+            issuedAt[slot] = time;
+            slot = (slot + 1 == M) ? 0 : slot + 1;
         }
-        return value;
     }
-    
-    // Method to find a memBlock using its pointer
-    sbMemBlock* getSBMemoryBlock(uint32_t tagAndIndex) {
-        for (auto& sbMemBlock : buffer) {
-            if (sbMemBlock.tagAndIndex == tagAndIndex) {
-                return &sbMemBlock;
-            }
+
+    void save(SnapshotWriter& out) const {
+        out.put(head);
+        out.put(length);
+        out.put(streamLast);
+        out.put(streamIssuedAt);
+        out.putVector(issuedAt);
+        out.put(lruRank);
+    }
+
+    void restore(SnapshotReader& in) {
+        in.get(&head);
+        in.get(&length);
+        in.get(&streamLast);
+        in.get(&streamIssuedAt);
+        in.getVector(&issuedAt);
+        in.get(&lruRank);
+        if (length > M || issuedAt.size() != M) {
+            SnapshotReader::corrupt();
         }
-        return nullptr; // Return nullptr if not found
     }
 
     // Function to get a stream buffer's content
     std::string getContent() {
         std::string value = "";
-        std::vector<sbMemBlock>& sbMemBlocks = this->getSBMemoryBlocks();
-        for (auto& sbMemBlock : sbMemBlocks) {
-            uint32_t tagAndIndex = sbMemBlock.tagAndIndex;
-            std::string hexString = Utility::toHexString(tagAndIndex);
+        for (uint32_t i = 0; i < length; ++i) {
+            std::string hexString = Utility::toHexString(head + i);
             while (hexString.length() < 8) {
                 hexString = " "+hexString;
             }
@@ -127,29 +232,25 @@ public:
 }; // Stream buffer class ends here
 
 // Class to model sets within a cache
+// A set does not own its blocks; it is a view over one row of the
+// per-level TagStore, so all ways of a set sit next to each other in memory.
+// Replacement state lives in the level's Policy (see policy.cpp).
+template <class Policy>
 class CacheSet {
     private:
-        uint32_t setCount;
+        TagStore* store; // tag store of the cache level this set belongs to
+        Policy* policy; // replacement state of the cache level this set belongs to
+        uint32_t setIndex; // index of this set within the cache
         uint32_t assoc;
-        std::vector<memBlock> memBlocks;
+        uint32_t base; // position of way 0 of this set within the tag store arrays
 
     public:
         // Constructor for CacheSet
-        CacheSet(int setCount, int assoc) : setCount(setCount), assoc(assoc) {
-            // Create as many memory block containers as the asscociativity
-            for (int i = 0; i < assoc; ++i) {
-                memBlock memoryBlock;
-                memoryBlock.tag = -1;
-                memoryBlock.dirtyBit = false;
-                memoryBlock.valid = false;
-                memoryBlock.lruRank = -1;
-                memoryBlock.addr = -1;
-                memBlocks.push_back(memoryBlock);
-            }
+        CacheSet(TagStore* store, Policy* policy, uint32_t setIndex, uint32_t assoc) : store(store), policy(policy), setIndex(setIndex), assoc(assoc), base(setIndex * assoc) {
         }
     // Return set count of the set
     uint32_t getSetIndex() {
-        return setCount;
+        return setIndex;
     }
 
     // Generates the set content as a string
@@ -172,152 +273,178 @@ class CacheSet {
         return value;
     }
 
-    // Check if a memory block with a given tag and index exists in the set
-    bool hasMemoryBlock(uint32_t tag) {
-        for (const auto& memBlock : memBlocks) {
-            if (memBlock.tag == tag) {
-                return true;
+    // Returns the way holding a given tag, or NO_WAY if the set does not have it
+    // All ways are compared at once (see tagmatch.cpp). Invalid ways hold the
+    // tag INVALID_TAG, which a tag of 32 bits (1-byte blocks in a single set)
+    // can equal too, so that tag is looked up among the valid ways only.
+    uint32_t findWay(uint32_t tag) {
+        if (__builtin_expect(tag == INVALID_TAG, 0)) {
+            return this->findValidWay(tag);
+        }
+        uint32_t way = findTag(&store->tags[base], assoc, tag);
+        return (way < assoc) ? way : NO_WAY;
+    }
+
+    __attribute__((noinline)) uint32_t findValidWay(uint32_t tag) {
+        for (uint32_t way = 0; way < assoc; ++way) {
+            if (store->valid[base + way] && store->tags[base + way] == tag) {
+                return way;
             }
         }
-        return false;
-   }
+        return NO_WAY;
+    }
+
+    // Check if a memory block with a given tag and index exists in the set
+    bool hasMemoryBlock(uint32_t tag) {
+        return this->findWay(tag) != NO_WAY;
+    }
 
-    // Get all memory blocks in the set
-    std::vector<memBlock> getMemoryBlocks() {
-        return memBlocks;
+    // Get a snapshot of the memory block held in a way
+    memBlock getMemoryBlock(uint32_t way) {
+        memBlock block;
+        block.tag = store->tags[base + way];
+        block.dirtyBit = store->dirty[base + way] != 0;
+        block.valid = store->valid[base + way] != 0;
+        return block;
     }
 
-    // Get valid blocks sorted in order of MRU
+    // Get valid blocks in the order the replacement policy prints them (MRU first for LRU)
     std::vector<memBlock> getMRUSortedMemoryBlocks() {
-        // copy of memBlocks to avoid modifying the original memBlocks vector
+        std::vector<uint32_t> ways;
+        policy->getPrintOrder(setIndex, &store->valid[base], &ways);
         std::vector<memBlock> sortedMemBlocks;
-        // Copy valid blocks to validMemBlocks vector
-        for (const auto& block : memBlocks) {
-            if (block.valid) {
-                sortedMemBlocks.push_back(block); // still unsorted
-            }
+        sortedMemBlocks.reserve(ways.size());
+        for (uint32_t way : ways) {
+            sortedMemBlocks.push_back(this->getMemoryBlock(way));
         }
-        // custom comparator function to sort by lruRank in ascending order
-        auto comparator = [](const memBlock& a, const memBlock& b) {
-            return a.lruRank < b.lruRank;
-        };
-        // now perfrom the sort in ascending order of lruRank using the above comparator function
-        std::sort(sortedMemBlocks.begin(), sortedMemBlocks.end(), comparator);
         return sortedMemBlocks;
     }
 
-    // Get a memory block with a given tag and index from the set
-    memBlock* getMemoryBlock(uint32_t tag) {
-        for (auto& iterMemBlock : memBlocks) {
-             if (iterMemBlock.tag == tag) {
-                return const_cast<memBlock*>(&iterMemBlock);
-            }
-        }
-        return nullptr; // Return a nullptr if not found
+    // Accessors for the state of a single way
+    uint32_t getTag(uint32_t way) {
+        return store->tags[base + way];
+    }
+
+    bool isDirty(uint32_t way) {
+        return store->dirty[base + way] != 0;
+    }
+
+    void setDirty(uint32_t way) {
+        store->dirty[base + way] = 1;
     }
 
     // Allocate a memory block. Find the first invalid memory block
     // and fill it with the requested tag
-    memBlock* allocateMemoryBlock(uint32_t tag, uint32_t addr) {
-        memBlock* value = nullptr;
-        for(auto& iterMemBlock: memBlocks) {
-            if (!iterMemBlock.valid) {
-                iterMemBlock.valid = true;
-                iterMemBlock.tag = tag;
-                iterMemBlock.dirtyBit = false;
-                iterMemBlock.addr = addr;
-                value = &iterMemBlock;
-                break;
+    uint32_t allocateMemoryBlock(uint32_t tag) {
+        for (uint32_t way = 0; way < assoc; ++way) {
+            if (!store->valid[base + way]) {
+                store->valid[base + way] = 1;
+                store->tags[base + way] = tag;
+                store->dirty[base + way] = 0;
+                policy->onFill(setIndex, way);
+                return way;
             }
         }
-        return value;
+        return NO_WAY;
     }
 
     // Check if there is an invalid memory block within the cache set
     bool hasInvalidMemoryBlock() {
-        for (const auto& memBlock : memBlocks) {
-            if (!memBlock.valid) {
+        const uint8_t* valid = &store->valid[base];
+        for (uint32_t way = 0; way < assoc; ++way) {
+            if (!valid[way]) {
                 return true;
             }
         }
         return false;
     }
 
-    // Get the least recently used (LRU) memory block within the cache set
-    memBlock* getLRUMemoryBlock() {
-        memBlock* lruMemoryBlock = nullptr;
-        bool notFoundValidBlock = true;
-        // Iterate through each memBlock in the vector
-        for (auto& block : memBlocks) {
-            // If a memBlock is valid, update the lruMemoryBlock pointer if it has a higher lruRank
-            if (block.valid) {
-                if (notFoundValidBlock || block.lruRank > lruMemoryBlock->lruRank) {
-                    lruMemoryBlock = &block;
-                    notFoundValidBlock = false;
-                }
-            }
-            // If there is at least one invalid memBlock, return nullptr
-            else {
-                return nullptr;
-            }
-        }
-        // Return the pointer to the memBlock with the highest lruRank among valid memBlocks
-        return lruMemoryBlock;
+    // Get the way the replacement policy evicts next
+    // Only meaningful when every way of the set is valid
+    uint32_t getVictimMemoryBlock() {
+        return policy->getVictim(setIndex);
     }
 
-    // Updates the LRU rank of all the valid blocks
-    // The requested MRUMemBlock's rank becomes 0; rank of all other blocks increases by 1
-    void updateLRURank(memBlock* MRUMemBlock) {
-        // Set the lru rank of MRUMemBlock to zero
-        MRUMemBlock->lruRank = 0;
-        for (auto& memBlock : memBlocks) {
-            if (&memBlock != MRUMemBlock && memBlock.valid) {
-                memBlock.lruRank += 1;
-            }
-        }
+    // Tell the replacement policy that the block in a way was referenced
+    void touchMemoryBlock(uint32_t way) {
+        policy->onHit(setIndex, way);
     }
 
-    // Evict a memory block with a given tag and index from the set
-    void invalidateMemoryBlock(memBlock* lruMemBlock) {
-        lruMemBlock->tag = -1;
-        lruMemBlock->valid = false;
-        lruMemBlock->dirtyBit = false;
-        lruMemBlock->lruRank = -1;
-        lruMemBlock->addr = -1;
-
+    // Evict the memory block held in a way
+    void invalidateMemoryBlock(uint32_t way) {
+        policy->onInvalidate(setIndex, way);
+        store->tags[base + way] = INVALID_TAG;
+        store->valid[base + way] = 0;
+        store->dirty[base + way] = 0;
     }
 }; // class CacheSet ends
 
 // Cache class to model any cache level l1, l2 etc.
-class Cache {
+// Policy is the replacement policy of the level (see policy.cpp); every
+// policy gets its own instantiation of the whole access path.
+// Objects start on a host cache line and are padded to whole lines, so the
+// counters of caches simulated on different threads never share a line
+template <class Policy>
+class alignas(CACHE_LINE_SIZE) Cache {
 private:
+    typedef CacheSet<Policy> Set;
+
     uint32_t cacheLevelIndex; // stores the cache level; 1 for L1, 2 for L2 etc
     uint32_t size; // cache size
     uint32_t blocksize; // size of memory block
     uint32_t assoc; // set associativity of the cache
     uint32_t N; // number of stream buffers
     uint32_t M; // size of each stream buffer
-    std::string writePolicy; // write policy; fixed as wbwa in this simulator
+    uint32_t writePolicy; // a WritePolicy (see writebuf.cpp)
+    bool writeThrough; // writes are passed on to the next level at once and blocks are never dirty
+    bool writeAllocate; // write misses fetch the block
     uint32_t addressSize; // size of address
     uint32_t setCount; // count the number of sets based on cache size, block size and assoc
     uint32_t indexBitCount; // no. of bits that represent index
     uint32_t blockOffsetBitCount; // no. of bits that represent block offset
     uint32_t tagBitCount; // no. of bits that represent tag
-    std::vector<CacheSet> sets; // vector to hold objects of set class
+    uint32_t indexMask; // mask applied to the address after dropping the block offset bits
+    TagStore tagStore; // contiguous storage for tags and valid/dirty bits of every block
+    Policy policy; // replacement state of every set
+    std::vector<Set> sets; // vector to hold objects of set class; sets[i] is the set with index i
     std::vector<StreamBuffer> streamBuffers; // vector to hold objects of stream buffer class
     uint32_t addr; // holds the address being serviced
+    uint64_t memTraffic; // blocks transferred between this level and main memory
     struct CacheMeasurement{
-        uint32_t reads;
-        uint32_t readMisses;
-        uint32_t writes;
-        uint32_t writeMisses;
-        uint32_t writebacks;
-        uint32_t prefetches;
-        uint32_t readsPrefetch;
-        uint32_t readMissesPrefetch;
+        uint64_t reads;
+        uint64_t readMisses;
+        uint64_t writes;
+        uint64_t writeMisses;
+        uint64_t writebacks;
+        uint64_t prefetches;
+        uint64_t readsPrefetch;
+        uint64_t readMissesPrefetch;
         double missRate;       
     }; CacheMeasurement cacheStats; // declare a variable of type struct CacheMeasurement to keep track of the same
     Cache* nextCacheLevel; // pointer to the next Cache object in the linked list
+    const SetSampler* sampler; // sets simulated in sampling mode; nullptr simulates every set
+    MissClassifier* classifier; // sorts the misses into compulsory, capacity and conflict; nullptr if not asked for
+    PrefetchUnit* prefetcher; // prefetcher filling the sets of this level (see prefetch.cpp); nullptr if it has none
+    AssistCache* assistCache; // victim or miss cache of this level; nullptr if it has none
+    Cache* previousCacheLevel; // the level above, if this level is inclusive or exclusive of it
+    uint32_t inclusion; // an InclusionPolicy: what this level holds of the level above
+    bool plainMissPath; // wbwa, no victim or miss cache, no write buffer and no inclusive or exclusive level here or next: misses skip their checks
+    struct InclusionMeasurement {
+        uint64_t backInvalidations; // blocks of the level above invalidated because this level evicted them
+        uint64_t dirtyBackInvalidations; // ...of which were dirty there and written back from here
+        uint64_t victimFills; // blocks the level above evicted into this exclusive level
+    }; InclusionMeasurement inclusionStats;
+    WriteBuffer* writeBuffer; // holds the writes passed on to the next level; nullptr if this level has none
+    struct WriteMeasurement {
+        uint64_t writeThroughs; // writes passed on because this level is write-through
+        uint64_t writeArounds; // write misses passed on because this level does not allocate on writes
+    }; WriteMeasurement writeStats;
+    uint64_t streamBufferHits; // misses of the sets served by the stream buffers: their useful prefetches
+    uint64_t streamBufferLate; // ...of which came less than streamBufferLatency requests after the prefetch
+    uint64_t streamBufferUnused; // blocks the stream buffers dropped without serving a miss
+    uint32_t streamBufferLatency; // requests of the trace a stream buffer prefetch takes to arrive
+    const uint64_t* streamBufferClock; // requests of the trace issued so far
+    MemoryLog* memoryLog; // logs the blocks read from and written to main memory for the DRAM model (see dram.cpp); nullptr if there is none
 
     // Private methods
     
@@ -346,8 +473,8 @@ private:
         cacheStats.writebacks++;
     }
 
-    void incrementPrefetches() {
-        cacheStats.prefetches++;
+    void incrementPrefetches(uint32_t count = 1) {
+        cacheStats.prefetches += count;
     }
 
     void incrementReadPrefetches() {
@@ -399,7 +526,7 @@ public:
         uint32_t assoc,
         uint32_t N=0,
         uint32_t M=0,
-        const std::string& writePolicy = "wbwa", 
+        uint32_t writePolicy = WRITE_WBWA, 
         uint32_t addressSize = ADDRESS_SIZE)
         : 
         cacheLevelIndex(cacheLevelIndex), 
@@ -409,21 +536,42 @@ public:
         N(N),
         M(M),
         writePolicy(writePolicy), 
+        writeThrough(isWriteThrough(writePolicy)),
+        writeAllocate(isWriteAllocate(writePolicy)),
         addressSize(addressSize), 
-        nextCacheLevel(nullptr) {
+        memTraffic(0),
+        nextCacheLevel(nullptr),
+        sampler(nullptr),
+        classifier(nullptr),
+        prefetcher(nullptr),
+        assistCache(nullptr),
+        previousCacheLevel(nullptr),
+        inclusion(INCLUSION_NINE),
+        plainMissPath(true),
+        writeBuffer(nullptr),
+        streamBufferHits(0),
+        streamBufferLate(0),
+        streamBufferUnused(0),
+        streamBufferLatency(PREFETCH_LATENCY),
+        streamBufferClock(nullptr),
+        memoryLog(nullptr) {
         
         // Address bits calculation
         setCount = size / (assoc * blocksize);
         indexBitCount = static_cast<uint32_t>(log2(setCount));
         blockOffsetBitCount = static_cast<uint32_t>(log2(blocksize));
         tagBitCount = addressSize - indexBitCount - blockOffsetBitCount;
-        // Add empty 'set' to vector 'sets'
+        indexMask = (indexBitCount >= 32) ? 0xFFFFFFFFu : ((1u << indexBitCount) - 1);
+        // Allocate the flat tag store holding every block of this level
+        tagStore.resize(setCount, this->assoc);
+        policy.init(setCount, this->assoc);
+        // Add 'set' views to vector 'sets' such that the set with index i is at position i
         // Reserve memory for as many sets as the setCount
         sets.reserve(setCount);
         for (uint32_t everySet = 0; everySet < setCount; ++everySet) {
             // Directly add the set object to the vector without having to 
             // temporarily create an instance of set class and then push to vector sets
-            sets.emplace_back(everySet, this->assoc); 
+            sets.emplace_back(&tagStore, &policy, everySet, this->assoc);
         }
         // Initialize cache measurement params
         cacheStats.reads = 0;
@@ -435,12 +583,40 @@ public:
         cacheStats.readsPrefetch = 0;
         cacheStats.readMissesPrefetch = 0;
         cacheStats.missRate = 0.0;
+        inclusionStats.backInvalidations = 0;
+        inclusionStats.dirtyBackInvalidations = 0;
+        inclusionStats.victimFills = 0;
+        writeStats.writeThroughs = 0;
+        writeStats.writeArounds = 0;
+        this->updateMissPath();
     }
     
-    // Add stream buffers if they are configured to be present
-    void addStreamBuffers(uint32_t sbSize, uint32_t mbSize) {
+    ~Cache() {
+        delete classifier;
+        delete assistCache;
+        delete writeBuffer;
+        delete prefetcher;
+    }
+
+    // C++11 new does not honour the class alignment, so allocate aligned storage explicitly
+    static void* operator new(size_t bytes) {
+        void* storage = nullptr;
+        if (posix_memalign(&storage, CACHE_LINE_SIZE, bytes) != 0) {
+            throw std::bad_alloc();
+        }
+        return storage;
+    }
+
+    static void operator delete(void* storage) {
+        free(storage);
+    }
+
+    // Add stream buffers if they are configured to be present; clock counts
+    // the requests of the trace, which time the prefetches
+    void addStreamBuffers(uint32_t sbSize, uint32_t mbSize, const uint64_t* clock) {
         this->N= sbSize;
         this->M = mbSize;
+        this->streamBufferClock = clock;
         if (N > 0) {
             this->streamBuffers.reserve(N);
             for (uint32_t everySB = 0; everySB < N; ++everySB) {
@@ -449,49 +625,145 @@ public:
         }
     }
 
+    // Add a victim or miss cache of the given number of entries (see assist.cpp)
+    void addAssistCache(uint32_t kind, uint32_t entries) {
+        delete assistCache;
+        assistCache = new AssistCache(kind, entries);
+        this->updateMissPath();
+    }
+
+    // The victim or miss cache, or nullptr if this level has none
+    const AssistCache* getAssistCache() const {
+        return assistCache;
+    }
+
+    // ------------------------------------- Methods for write policies -------------------------------------
+    // Set the write policy, a WritePolicy (see writebuf.cpp); must be called before any request is issued
+    void setWritePolicy(uint32_t policy) {
+        writePolicy = policy;
+        writeThrough = isWriteThrough(policy);
+        writeAllocate = isWriteAllocate(policy);
+        this->updateMissPath();
+    }
+
+    uint32_t getWritePolicy() const {
+        return writePolicy;
+    }
+
+    // Buffer the writes this level passes on in a write buffer of entries
+    // entries, one of which drains every interval requests counted by clock
+    void addWriteBuffer(uint32_t entries, uint32_t interval, const uint64_t* clock) {
+        delete writeBuffer;
+        writeBuffer = new WriteBuffer(entries, interval, clock);
+        this->updateMissPath();
+    }
+
+    // The write buffer, or nullptr if this level has none
+    const WriteBuffer* getWriteBuffer() const {
+        return writeBuffer;
+    }
+
+    uint64_t getWriteThroughs() const {
+        return writeStats.writeThroughs;
+    }
+
+    uint64_t getWriteArounds() const {
+        return writeStats.writeArounds;
+    }
+
+    // ------------------------------------- Methods for prefetchers -------------------------------------
+    // Prefetch into the sets with a prefetcher of kind, a PrefetcherKind (see prefetch.cpp), asking for up to
+    // degree blocks at a time; a prefetch arrives latency requests counted by clock after it is issued
+    void addPrefetcher(uint32_t kind, uint32_t degree, uint32_t latency, const uint64_t* clock) {
+        delete prefetcher;
+        prefetcher = new PrefetchUnit(kind, degree, latency, clock, this->getBlockCount());
+    }
+
+    // The prefetcher, or nullptr if this level has none
+    const PrefetchUnit* getPrefetcher() const {
+        return prefetcher;
+    }
+
+    uint32_t getStreamBufferCount() const {
+        return N;
+    }
+
+    uint32_t getStreamBufferSize() const {
+        return M;
+    }
+
+    uint64_t getStreamBufferHits() const {
+        return streamBufferHits;
+    }
+
+    uint64_t getStreamBufferLate() const {
+        return streamBufferLate;
+    }
+
+    uint64_t getStreamBufferUnused() const {
+        return streamBufferUnused;
+    }
+
+    uint32_t getStreamBufferLatency() const {
+        return streamBufferLatency;
+    }
+
+    // A stream buffer hit less than latency requests after its prefetch counts as late
+    void setStreamBufferLatency(uint32_t latency) {
+        streamBufferLatency = latency;
+    }
+
     // ------------------------------------- Methods for getting cache parameters measurements -------------------------------------
-    uint32_t getReads() {
+    uint64_t getReads() {
         return cacheStats.reads;
     }
 
-    uint32_t getReadMisses() {
+    uint64_t getReadMisses() {
         return cacheStats.readMisses;
     }
 
-    uint32_t getWrites() {
+    uint64_t getWrites() {
         return cacheStats.writes;
     }
 
-    uint32_t getWriteMisses() {
+    uint64_t getWriteMisses() {
         return cacheStats.writeMisses;
     }
 
-    uint32_t getWritebacks() {
+    uint64_t getWritebacks() {
         return cacheStats.writebacks;
     }
 
-    uint32_t getPrefetches() {
+    uint64_t getPrefetches() {
         return cacheStats.prefetches;
     }
     
-    uint32_t getReadPrefetches() {
-        //return cacheStats.readsPrefetch;
-        return 0;
+    uint64_t getReadPrefetches() {
+        return cacheStats.readsPrefetch;
     }
 
-    uint32_t getReadMissPrefetches() {
-        //return cacheStats.readMissesPrefetch;
-        return 0;
+    uint64_t getReadMissPrefetches() {
+        return cacheStats.readMissesPrefetch;
     }
 
     double getMissRate() {     
         return cacheStats.missRate;
     }
 
+    uint64_t getMemTraffic() {
+        return memTraffic;
+    }
+
+    // Log the blocks this level reads from and writes to main memory in log, for the DRAM model
+    void setMemoryLog(MemoryLog* log) {
+        memoryLog = log;
+    }
+
     // ------------------------------------- Methods for accessing the next level of cache from the current level -------------------------------------
     // Function to set the next cache in the linked list
     void setNextCacheLevel(Cache* next) {
         nextCacheLevel = next;
+        this->updateMissPath();
     }
 
     // Function to get the next cache in the linked list
@@ -499,11 +771,249 @@ public:
         return nextCacheLevel;
     }
    
+    // ------------------------------------- Methods for snapshots -------------------------------------
+    // Write the whole state of this level: counters, blocks, replacement state, stream buffers, the victim or miss cache,
+    // the inclusion and write policies, the write buffer and the prefetcher
+    void save(SnapshotWriter& out) const {
+        out.put(cacheStats.reads);
+        out.put(cacheStats.readMisses);
+        out.put(cacheStats.writes);
+        out.put(cacheStats.writeMisses);
+        out.put(cacheStats.writebacks);
+        out.put(cacheStats.prefetches);
+        out.put(cacheStats.readsPrefetch);
+        out.put(cacheStats.readMissesPrefetch);
+        out.put(memTraffic);
+        tagStore.save(out);
+        policy.save(out);
+        for (auto& streamBuffer : streamBuffers) {
+            streamBuffer.save(out);
+        }
+        uint32_t assistKind = (assistCache != nullptr) ? assistCache->getKind() : ASSIST_NONE;
+        out.put(assistKind);
+        if (assistCache != nullptr) {
+            assistCache->save(out);
+        }
+        out.put(inclusion);
+        out.put(inclusionStats);
+        out.put(writePolicy);
+        out.put(writeStats);
+        uint32_t bufferInterval = (writeBuffer != nullptr) ? writeBuffer->getInterval() : 0;
+        out.put(bufferInterval);
+        if (writeBuffer != nullptr) {
+            writeBuffer->save(out);
+        }
+        out.put(streamBufferHits);
+        out.put(streamBufferLate);
+        out.put(streamBufferUnused);
+        uint32_t prefetcherKind = (prefetcher != nullptr) ? prefetcher->getKind() : PREFETCH_NONE;
+        uint32_t prefetcherDegree = (prefetcher != nullptr) ? prefetcher->getDegree() : 0;
+        out.put(prefetcherKind);
+        out.put(prefetcherDegree);
+        if (prefetcher != nullptr) {
+            prefetcher->save(out);
+        }
+    }
+
+    // Read back a state written by save() into a level built with the same parameters
+    void restore(SnapshotReader& in) {
+        in.get(&cacheStats.reads);
+        in.get(&cacheStats.readMisses);
+        in.get(&cacheStats.writes);
+        in.get(&cacheStats.writeMisses);
+        in.get(&cacheStats.writebacks);
+        in.get(&cacheStats.prefetches);
+        in.get(&cacheStats.readsPrefetch);
+        in.get(&cacheStats.readMissesPrefetch);
+        in.get(&memTraffic);
+        tagStore.restore(in);
+        policy.restore(in);
+        for (auto& streamBuffer : streamBuffers) {
+            streamBuffer.restore(in);
+        }
+        uint32_t assistKind;
+        in.get(&assistKind);
+        if (assistKind != ((assistCache != nullptr) ? assistCache->getKind() : ASSIST_NONE)) {
+            printf("Error: Snapshot was taken with a different victim or miss cache configuration.\n");
+            exit(EXIT_FAILURE);
+        }
+        if (assistCache != nullptr) {
+            assistCache->restore(in);
+        }
+        uint32_t savedInclusion;
+        in.get(&savedInclusion);
+        if (savedInclusion != inclusion) {
+            printf("Error: Snapshot was taken with a different inclusion policy.\n");
+            exit(EXIT_FAILURE);
+        }
+        in.get(&inclusionStats);
+        uint32_t savedWritePolicy;
+        in.get(&savedWritePolicy);
+        if (savedWritePolicy != writePolicy) {
+            printf("Error: Snapshot was taken with a different write policy.\n");
+            exit(EXIT_FAILURE);
+        }
+        in.get(&writeStats);
+        uint32_t bufferInterval;
+        in.get(&bufferInterval);
+        if (bufferInterval != ((writeBuffer != nullptr) ? writeBuffer->getInterval() : 0)) {
+            printf("Error: Snapshot was taken with a different write buffer configuration.\n");
+            exit(EXIT_FAILURE);
+        }
+        if (writeBuffer != nullptr) {
+            writeBuffer->restore(in);
+        }
+        in.get(&streamBufferHits);
+        in.get(&streamBufferLate);
+        in.get(&streamBufferUnused);
+        uint32_t prefetcherKind;
+        uint32_t prefetcherDegree;
+        in.get(&prefetcherKind);
+        in.get(&prefetcherDegree);
+        if (prefetcherKind != ((prefetcher != nullptr) ? prefetcher->getKind() : PREFETCH_NONE)
+            || prefetcherDegree != ((prefetcher != nullptr) ? prefetcher->getDegree() : 0)) {
+            printf("Error: Snapshot was taken with a different prefetcher configuration.\n");
+            exit(EXIT_FAILURE);
+        }
+        if (prefetcher != nullptr) {
+            prefetcher->restore(in);
+        }
+        this->updateMissRate();
+    }
+
+    // Classify every demand miss of this level from now on (see classify.cpp)
+    void enableMissClassification() {
+        if (classifier == nullptr) {
+            classifier = new MissClassifier(addressSize - blockOffsetBitCount, setCount, assoc);
+        }
+    }
+
+    // The miss classification, or nullptr if it was not enabled
+    const MissClassifier* getMissClassifier() const {
+        return classifier;
+    }
+
+    // Simulate only the sets the sampler keeps; requests to any other set are dropped
+    void setSampler(const SetSampler* setSampler) {
+        sampler = setSampler;
+    }
+
     // Getter for cache's current level
     uint32_t getCacheLevel() {
         return cacheLevelIndex;
     }
 
+    // ------------------------------------- Methods for inclusion -------------------------------------
+    // Make this level inclusive or exclusive of the level above, upper; must be called before any request is issued
+    void setInclusionPolicy(Cache* upper, uint32_t policy) {
+        previousCacheLevel = upper;
+        inclusion = policy;
+        this->updateMissPath();
+        upper->updateMissPath();
+    }
+
+    // Whether misses of this level can skip the victim and miss cache, inclusion, write policy and write buffer checks
+    void updateMissPath() {
+        plainMissPath = assistCache == nullptr && inclusion == INCLUSION_NINE
+            && (nextCacheLevel == nullptr || nextCacheLevel->inclusion == INCLUSION_NINE)
+            && writePolicy == WRITE_WBWA && writeBuffer == nullptr;
+    }
+
+    uint32_t getInclusionPolicy() const {
+        return inclusion;
+    }
+
+    uint64_t getBackInvalidations() const {
+        return inclusionStats.backInvalidations;
+    }
+
+    uint64_t getDirtyBackInvalidations() const {
+        return inclusionStats.dirtyBackInvalidations;
+    }
+
+    uint64_t getVictimFills() const {
+        return inclusionStats.victimFills;
+    }
+
+    // Drop the block at blockAddr from this level, its victim or miss cache
+    // included, because the level below evicted it; returns true if it was
+    // held and sets *dirty to whether it was dirty
+    bool backInvalidate(uint32_t blockAddr, bool* dirty) {
+        uint32_t position = this->findBlock(blockAddr);
+        if (position != NO_WAY) {
+            *dirty = this->isBlockDirty(position);
+            this->invalidateBlock(position);
+            return true;
+        }
+        if (assistCache != nullptr) {
+            uint32_t entry = assistCache->find(this->getTagAndIndex(blockAddr));
+            if (entry != AssistCache::NO_ENTRY) {
+                *dirty = assistCache->take(entry);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Blocks held in the sets
+    uint32_t getValidBlockCount() const {
+        uint32_t count = 0;
+        for (auto valid : tagStore.valid) {
+            count += valid;
+        }
+        return count;
+    }
+
+    // Blocks held in the sets of both this level and other
+    uint32_t getBlocksAlsoIn(Cache* other) {
+        uint32_t count = 0;
+        for (uint32_t position = 0; position < this->getBlockCount(); ++position) {
+            if (tagStore.valid[position] && other->findBlock(this->getTagllIndex(tagStore.tags[position], position / assoc)) != NO_WAY) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    // ------------------------------------- Methods for coherence -------------------------------------
+    // Blocks are identified by their position in the tag store, set * assoc + way,
+    // which stays the same for as long as the block is cached
+    uint32_t getBlockCount() const {
+        return setCount * assoc;
+    }
+
+    // Position of the block holding addr, or NO_WAY if it is not cached; the
+    // replacement state is left alone
+    uint32_t findBlock(uint32_t addr) {
+        uint32_t index = this->getIndex(addr);
+        uint32_t way = sets[index].findWay(this->getTag(addr));
+        return (way != NO_WAY) ? index * assoc + way : NO_WAY;
+    }
+
+    bool isBlockDirty(uint32_t position) {
+        return tagStore.dirty[position] != 0;
+    }
+
+    // Write a dirty block back to the next level, or to main memory, and keep it
+    // cached as clean; another core needs the data
+    void flushBlock(uint32_t position) {
+        uint32_t index = position / assoc;
+        uint32_t blockAddr = this->getTagllIndex(tagStore.tags[position], index);
+        Cache* nextCache = this->getNextCacheLevel();
+        if (nextCache != nullptr) {
+            nextCache->executeInstruction('w', blockAddr);
+        }
+        else {
+            this->toMemory(blockAddr, true);
+        }
+        tagStore.dirty[position] = 0;
+    }
+
+    // Drop a block another core is about to write; a dirty block must be flushed first
+    void invalidateBlock(uint32_t position) {
+        sets[position / assoc].invalidateMemoryBlock(position % assoc);
+    }
+
     // ------------------------------------- Methods for printing output -------------------------------------
     // Generate debug tabs
     std::string generateTabs() {
@@ -516,11 +1026,18 @@ public:
 
     // Function to print the cache configuration
     void printContents() {
-        printf("===== L%d contents =====\n",this->getCacheLevel());
+        char name[16];
+        snprintf(name, sizeof(name), "L%u", this->getCacheLevel());
+        this->printContents(name);
+    }
+
+    // Same, under a heading naming the cache, e.g. "L1 (core 2)"
+    void printContents(const char* name) {
+        printf("===== %s contents =====\n", name);
         for (uint32_t setCount = 0; setCount < this->getSetCount(); ++setCount) {
             // set      setCount: 
             printf("set %6d: ", setCount);
-            CacheSet* set = this->getSet(setCount);
+            Set* set = this->getSet(setCount);
             std::vector<memBlock> memBlocks = set->getMRUSortedMemoryBlocks();
             // iterate over memBlocks
             for (auto& memBlock : memBlocks) {
@@ -543,13 +1060,21 @@ public:
     void printStreamBufferContents() {
         if (this->N !=0 ) {
             printf("===== Stream Buffer(s) contents =====\n");
-            std::vector<StreamBuffer> streamBuffers = this->getMRUSortedStreamBuffers();
+            std::vector<StreamBuffer*> streamBuffers = this->getMRUSortedStreamBuffers();
             for (auto& streamBuffer : streamBuffers) {
-                printf("%s\n", streamBuffer.getContent().c_str());
+                printf("%s\n", streamBuffer->getContent().c_str());
             }
         }
     }
 
+    // Function to print the victim or miss cache contents if it exists
+    void printAssistCacheContents() {
+        if (assistCache != nullptr) {
+            printf("===== L%u %s cache contents =====\n", this->getCacheLevel(), assistCache->getKind() == ASSIST_VICTIM ? "victim" : "miss");
+            assistCache->printContents();
+        }
+    }
+
     // ------------------------------------- Methods for sets -------------------------------------
     // Fucntion to get the #sets in this cache
     uint32_t getSetCount() const {
@@ -557,16 +1082,15 @@ public:
     }
 
     // Function to return a vector of objects of set class
-    const std::vector<CacheSet>& getSets() const {
+    const std::vector<Set>& getSets() const {
         return sets;
     }
 
-    // Searches and returns the pointer to the set whose index is same as the target index
-    CacheSet* getSet(uint32_t index) {
-        for (auto& iteratorSet:sets) {
-            if (iteratorSet.getSetIndex() == index) {
-                return &iteratorSet;
-            }
+    // Returns the pointer to the set whose index is same as the target index
+    // Sets are stored in index order, so this is a direct lookup
+    Set* getSet(uint32_t index) {
+        if (index < sets.size()) {
+            return &sets[index];
         }
         return nullptr;
     }
@@ -574,26 +1098,18 @@ public:
     // ------------------------------------- Methods for splitting requested address into tag, index, offset and its combinations -------------------------------------
     // Returns the index as integer of the requested address
     uint32_t getIndex(uint32_t addr) {
-            uint32_t start = blockOffsetBitCount;
-            uint32_t end = blockOffsetBitCount + indexBitCount - 1;
-            uint32_t index = this->extractBits(addr, start, end);
-            return index;
+            return (addr >> blockOffsetBitCount) & indexMask;
     }
 
     // Returns the tag as integer of the requested address
     uint32_t getTag(uint32_t addr) {
             uint32_t start = blockOffsetBitCount + indexBitCount;
-            uint32_t end  = addressSize - 1;
-            uint32_t tag = this->extractBits(addr, start, end);
-            return tag;
+            return (start >= 32) ? 0 : (addr >> start);
     }
 
     // Returns the tag and index as integer of the requested address without any shifting
     uint32_t getTagAndIndex(uint32_t addr) {
-            uint32_t start = blockOffsetBitCount;
-            uint32_t end = addressSize - 1;
-            uint32_t tagAndIndex = this->extractBits(addr, start, end);
-            return tagAndIndex;
+            return addr >> blockOffsetBitCount;
     }
     
     // Concatenate Tag and Index of a block and lshift it block offset times
@@ -660,52 +1176,46 @@ public:
         }
     }
 
-    // Function to get MRU sorted stream buffers
-    std::vector<StreamBuffer> getMRUSortedStreamBuffers() {
-        // Create a vector to store valid StreamBuffer objects
-        std::vector<StreamBuffer> validStreamBuffers;
-
-        // Iterate through input streamBuffers and copy only valid StreamBuffer objects
+    // Function to get the valid stream buffers sorted in MRU order
+    std::vector<StreamBuffer*> getMRUSortedStreamBuffers() {
+        std::vector<StreamBuffer*> validStreamBuffers;
         for (auto& buffer : this->streamBuffers) {
             if (buffer.isValid()) {
-                validStreamBuffers.push_back(buffer);
-            }
-        }
-        // Bubble Sort: Compare and swap elements based on lruRank in ascending order
-        for (size_t i = 0; i < validStreamBuffers.size() - 1; ++i) {
-            for (size_t j = 0; j < validStreamBuffers.size() - i - 1; ++j) {
-                if (validStreamBuffers[j].lruRank > validStreamBuffers[j + 1].lruRank) {
-                    // Swap elements if they are in the wrong order
-                    StreamBuffer temp = validStreamBuffers[j];
-                    validStreamBuffers[j] = validStreamBuffers[j + 1];
-                    validStreamBuffers[j + 1] = temp;
-                }
+                validStreamBuffers.push_back(&buffer);
             }
         }
-        // Return the sorted vector of valid StreamBuffer objects
+        // Ranks of valid stream buffers are distinct, so this order is total
+        std::sort(validStreamBuffers.begin(), validStreamBuffers.end(),
+                  [](const StreamBuffer* a, const StreamBuffer* b) { return a->lruRank < b->lruRank; });
         return validStreamBuffers;
     }
 
     // Prefetch blocks into stream buffer
+    // The streamSize blocks following tagAndIndex are fetched; afterwards the
+    // buffer holds the M blocks ending with the last one fetched
     void prefetchBlocksIntoStreamBuffer(uint32_t tagAndIndex, uint32_t streamSize, StreamBuffer* targetStreamBuffer = nullptr) {
+        // Nothing to prefetch into if the prefetch unit is absent
+        if (this->N == 0 || this->M == 0) {
+            return;
+        }
         if (targetStreamBuffer == nullptr) {
             targetStreamBuffer = this->getLRUStreamBuffer();
+            // A new stream replaces what the buffer held, unused, even blocks it prefetches again
+            streamBufferUnused += targetStreamBuffer->getLength();
+            targetStreamBuffer->startStream(tagAndIndex + streamSize + 1 - M, uint32_t(*streamBufferClock));
         }
-        std::vector<sbMemBlock>& targetSBMemBlocks = targetStreamBuffer->getSBMemoryBlocks();
-        uint32_t startIndex = (M - streamSize) % M;
-        tagAndIndex++;
-        for (uint32_t i = startIndex; i < M; ++i) {
-            targetSBMemBlocks[i].tagAndIndex = tagAndIndex;
-            tagAndIndex++;
-            // Increment prefetch counter
-            this->incrementPrefetches();
-            // Increment memory traffic counter as well because prefetch will get the data from memory
-            memTraffic++;
+        else {
+            targetStreamBuffer->setBlocks(tagAndIndex + streamSize + 1 - M);
+            targetStreamBuffer->setIssuedAt(tagAndIndex + 1, streamSize, uint32_t(*streamBufferClock));
         }
-
-        // mark it valid if it was invalid earlier as it has now prefetched memory blocks
-        if(!(targetStreamBuffer->isValid())) {
-            targetStreamBuffer->setValid(true);
+        // Increment prefetch counter
+        this->incrementPrefetches(streamSize);
+        // Increment memory traffic counter as well because prefetch will get the data from memory
+        memTraffic += streamSize;
+        if (memoryLog != nullptr) {
+            for (uint32_t i = 1; i <= streamSize; ++i) {
+                memoryLog->add(tagAndIndex + i, false);
+            }
         }
         // Update targetStreamBuffer lru rank
         updateSBLRURank(targetStreamBuffer);
@@ -725,309 +1235,605 @@ public:
         return mruStreamBuffer;
     }
 
-    // Transfer block from stream buffer to cache
-    void transferBlockfromStreamBuffer(uint32_t tagAndIndex) {
-        // Find all the stream buffers containing the specific sbMemBlock with matching tagAndIndex
-        std::vector<StreamBuffer*> matchingStreamBuffers;
-        for (auto& streamBuffer : this->streamBuffers) {
-            bool found = false;
-            for (auto& block : streamBuffer.getSBMemoryBlocks()) {
-                if (block.tagAndIndex == tagAndIndex) {
-                    found = true;
-                    break;
+    // Check if any stream buffer holds a memory block
+    bool streamBuffersHold(uint32_t tagAndIndex) {
+        for (auto& streamBuffer : streamBuffers) {
+            if (streamBuffer.isValid()) {
+                if (streamBuffer.hasSBMemoryBlock(tagAndIndex)) {
+                    return true;
                 }
             }
-            if (found) {
-                matchingStreamBuffers.push_back(&streamBuffer);
-            }
         }
-        // Choose the MRU stream buffer
-        StreamBuffer* mruStreamBuffer = this->getMRUStreamBuffer();
-        // Find the element in MRU buffer with matching tagAndIndex and calculate its index
-        size_t elementIndex = 0;
-        bool found = false;
-        for (auto& sbmemblock : mruStreamBuffer->getSBMemoryBlocks()) {
-            if (sbmemblock.tagAndIndex == tagAndIndex) {
-                found = true;
-                break;
+        return false;
+    }
+
+    // Transfer block from stream buffer to cache; useful if it serves a miss
+    // of the sets rather than a block they already hold
+    void transferBlockfromStreamBuffer(uint32_t tagAndIndex, bool useful) {
+        // Choose the MRU stream buffer among the ones holding the block
+        StreamBuffer* mruStreamBuffer = nullptr;
+        for (auto& streamBuffer : this->streamBuffers) {
+            if (streamBuffer.hasSBMemoryBlock(tagAndIndex) && (mruStreamBuffer == nullptr || streamBuffer.lruRank < mruStreamBuffer->lruRank)) {
+                mruStreamBuffer = &streamBuffer;
             }
-            elementIndex++;
         }
-        // Shift the elements after the found element up and prefetch for the freed up blocks
-        if (found) {
-            std::vector<sbMemBlock>& mruMemBlocks = mruStreamBuffer->getSBMemoryBlocks();
-            for (uint32_t i = elementIndex+1; i < M; ++i) {
-                mruMemBlocks[i-elementIndex-1].tagAndIndex = mruMemBlocks[i].tagAndIndex;
+        if (mruStreamBuffer == nullptr) {
+            return;
+        }
+        // The block and the ones in front of it are consumed; prefetch as many
+        // blocks past the end of the buffer to keep it M blocks long
+        uint32_t elementIndex = mruStreamBuffer->getSBMemoryBlockPosition(tagAndIndex);
+        if (useful) {
+            streamBufferHits++;
+            if (uint32_t(*streamBufferClock) - mruStreamBuffer->getIssuedAt(tagAndIndex) < streamBufferLatency) {
+                streamBufferLate++;
             }
-            prefetchBlocksIntoStreamBuffer(tagAndIndex+M-elementIndex-1, elementIndex+1, mruStreamBuffer);
         }
+        // The blocks in front of it are dropped unused, and so is the block itself unless it serves a miss
+        streamBufferUnused += useful ? elementIndex : elementIndex + 1;
+        prefetchBlocksIntoStreamBuffer(tagAndIndex+M-elementIndex-1, elementIndex+1, mruStreamBuffer);
     }
     
     // Function to stay in sync with the demand stream of the cache when there is a hit in both the cache and the stream buffers
     void stayInSyncWithDemandStream(uint32_t tagAndIndex) {
-        transferBlockfromStreamBuffer(tagAndIndex);
+        transferBlockfromStreamBuffer(tagAndIndex, false);
     }
 
     // ------------------------------------- Methods for handling cache operation -------------------------------------
     // Handle cache hit
-    void processCacheHit(char instr, uint32_t addr, uint32_t tag, uint32_t index, memBlock* targetMemBlock, CacheSet* targetSet, bool streamBufferHit=false) {
-        // Fetch the hit block
-        targetMemBlock = targetSet->getMemoryBlock(tag);
+    void processCacheHit(char instr, uint32_t addr, uint32_t tag, uint32_t index, uint32_t hitWay, Set* targetSet, bool streamBufferHit=false) {
         // ***** Debug statements begin
-        debugPrint("%sL%d: %6s: set %6d: %s\n",this->generateTabs().c_str(), this->getCacheLevel(), std::string("before").c_str(), index, targetSet->getSetContent().c_str());
+        debugTrace(this->getCacheLevel(), index, addr, "%sL%d: %6s: set %6d: %s\n",this->generateTabs().c_str(), this->getCacheLevel(), "before", index, targetSet->getSetContent().c_str());
         // ***** Debug statements end
         if (instr == 'r') { // Read hit
             // Increment read counter
             this->incrementReads();
         }
-        else if (instr == 'w') { // Write hit
+        else if (instr == 'w' && !writeThrough) { // Write hit
             // Set dirty bit because write was requested
-            targetMemBlock->dirtyBit = true;
+            targetSet->setDirty(hitWay);
+            // Increment write counter
+            this->incrementWrites();
+        }
+        else if (instr == 'w') { // Write hit of a write-through level; the block stays clean
             // Increment write counter
             this->incrementWrites();
         }
+        else { // Prefetch read from the level above
+            this->incrementReadPrefetches();
+        }
         if (streamBufferHit) {
             // Scenario 4: Hits in the cache and hits in the prefetch unit as well
             stayInSyncWithDemandStream(this->getTagAndIndex(addr));
         }
-        // Update LRU rank of the hit block and other valid blocks in the set
-        targetSet->updateLRURank(targetMemBlock);
+        // Update the replacement state of the set for the hit block
+        targetSet->touchMemoryBlock(hitWay);
         // ***** Debug statements begin
-        debugPrint("%sL%d: %6s: set %6d: %s\n",this->generateTabs().c_str(), this->getCacheLevel(), std::string("after").c_str(), index, targetSet->getSetContent().c_str());
+        debugTrace(this->getCacheLevel(), index, addr, "%sL%d: %6s: set %6d: %s\n",this->generateTabs().c_str(), this->getCacheLevel(), "after", index, targetSet->getSetContent().c_str());
+        #if DEBUG
         if (streamBufferHit) {
             for (auto& streamBuffer : this->streamBuffers) {
                 if (streamBuffer.isValid()){
-                    debugPrint("\t\t\tSB: %s\n", streamBuffer.getContent().c_str());
+                    debugTrace(this->getCacheLevel(), index, addr, "\t\t\tSB: %s\n", streamBuffer.getContent().c_str());
                 }
+            }
         }
-        }
+        #endif
         // ***** Debug statements end
+        // A write-through level passes the write on once the hit is complete
+        if (instr == 'w' && writeThrough) {
+            this->writeThroughBlock(tag, index);
+        }
+    }
+
+    // Count a block read from or written to main memory, and log it for the DRAM model
+    void toMemory(uint32_t blockAddr, bool write) {
+        memTraffic++;
+        if (memoryLog != nullptr) {
+            memoryLog->add(this->getTagAndIndex(blockAddr), write);
+        }
+    }
+
+    // Write a block evicted from this level back to the next level, or to main memory
+    void writeBackBlock(uint32_t blockAddr) {
+        Cache* nextCache = this->getNextCacheLevel();
+        if (nextCache != nullptr) {
+            // Issue a write instruction to the next level
+            nextCache->executeInstruction('w', blockAddr);
+        }
+        else { // this is the last level of cache. next is main memory
+            this->toMemory(blockAddr, true);
+        }
+        this->incrementWriteBacks();
+    }
+
+    // Write a block to the next level, or to main memory, now
+    void issueWrite(uint32_t blockAddr) {
+        Cache* nextCache = this->getNextCacheLevel();
+        if (nextCache != nullptr) {
+            nextCache->executeInstruction('w', blockAddr);
+        }
+        else {
+            this->toMemory(blockAddr, true);
+        }
+    }
+
+    // Pass a write on to the next level, or to main memory, through the write buffer if this level has one
+    void passWriteOn(uint32_t blockAddr) {
+        if (writeBuffer == nullptr) {
+            this->issueWrite(blockAddr);
+            return;
+        }
+        uint32_t block = this->getTagAndIndex(blockAddr);
+        uint32_t drained;
+        this->drainWriteBuffer();
+        while (writeBuffer->drainForRoom(block, &drained)) {
+            this->issueWrite(drained << blockOffsetBitCount);
+        }
+        writeBuffer->write(block);
+    }
+
+    // Pass a write to a block this level holds on, as a write-through level does
+    void writeThroughBlock(uint32_t tag, uint32_t index) {
+        writeStats.writeThroughs++;
+        this->passWriteOn(this->getTagllIndex(tag, index));
+    }
+
+    // Pass a write miss on without allocating the block, as a no-write-allocate level does
+    void writeAround(uint32_t tag, uint32_t index) {
+        this->incrementWrites();
+        writeStats.writeArounds++;
+        this->passWriteOn(this->getTagllIndex(tag, index));
+    }
+
+    // Write the entries of the write buffer whose time has come to the next level
+    void drainWriteBuffer() {
+        uint32_t drained;
+        while (writeBuffer->drainDue(&drained)) {
+            this->issueWrite(drained << blockOffsetBitCount);
+        }
+    }
+
+    // Write every entry left in the write buffer to the next level, as at the end of the trace
+    void flushWriteBuffer() {
+        uint32_t drained;
+        while (writeBuffer != nullptr && writeBuffer->drainAtEnd(&drained)) {
+            this->issueWrite(drained << blockOffsetBitCount);
+        }
+    }
+
+    // Drain the write buffer up to a write to blockAddr, which this level is about to fetch
+    void drainWriteBufferFor(uint32_t blockAddr) {
+        uint32_t drained;
+        this->drainWriteBuffer();
+        while (writeBuffer->drainFor(this->getTagAndIndex(blockAddr), &drained)) {
+            this->issueWrite(drained << blockOffsetBitCount);
+        }
+    }
+
+    // Evict the victim block of a full set, writing it back if it is dirty
+    void evictMemoryBlock(uint32_t index, Set* targetSet, uint32_t victimWay) {
+        // construct a similar address like value from tag and index
+        // of LRU memblock ignoring the block offset bits
+        // it is safe to ignore block offset bits because 
+        // block size is same at all levels
+        uint32_t lrutagllIndex = this->getTagllIndex(targetSet->getTag(victimWay), index);
+        bool dirty = targetSet->isDirty(victimWay);
+        targetSet->invalidateMemoryBlock(victimWay);
+        if (dirty) { // LRU block has the dirty bit set
+            this->writeBackBlock(lrutagllIndex);
+        }
+    }
+
+    // Bring a missed block into this level from the next level, from main memory or from the stream buffers
+    void fetchMemoryBlock(uint32_t tag, uint32_t index, uint32_t addr, bool streamBufferHit) {
+        Cache* nextCache = this->getNextCacheLevel();
+        if (nextCache != nullptr) { // Next cache level exists
+            // Send read instruction to next level
+            // Stream buffers only exist at the last level; the prefetchers of
+            // prefetch.cpp send their reads from prefetchBlock()
+            nextCache->executeInstruction('r', this->getTagllIndex(tag, index));
+        }
+        else if (!streamBufferHit) { // Accessing main memory
+            this->toMemory(addr, false);
+            // Scenario #1:
+            // prefetch the next M consecutive memory blocks into Cache
+            prefetchBlocksIntoStreamBuffer(this->getTagAndIndex(addr), M);
+        }
+        else {
+            // Scenario #2:
+            // instead of making request to the next level of cache,
+            // copy the request block X from the Stream buffer into Cache
+            transferBlockfromStreamBuffer(this->getTagAndIndex(addr), true);
+        }
+    }
+
+    // ------------------------------------- Misses with victim and miss caches and inclusion -------------------------------------
+    // Only levels for which plainMissPath is false take these paths
+
+    // Evict the victim block of a full set
+    // With a victim cache the block moves there instead, and it is the block
+    // the victim cache evicts in turn, if any, that leaves this level
+    void evictMemoryBlockExtended(uint32_t index, Set* targetSet, uint32_t victimWay) {
+        uint32_t lrutagllIndex = this->getTagllIndex(targetSet->getTag(victimWay), index);
+        bool dirty = targetSet->isDirty(victimWay);
+        targetSet->invalidateMemoryBlock(victimWay);
+        if (assistCache != nullptr && assistCache->getKind() == ASSIST_VICTIM) {
+            uint32_t evictedBlock;
+            bool evictedDirty;
+            if (!assistCache->insert(this->getTagAndIndex(lrutagllIndex), dirty, &evictedBlock, &evictedDirty)) {
+                return;
+            }
+            lrutagllIndex = evictedBlock << blockOffsetBitCount;
+            dirty = evictedDirty;
+            if (dirty) {
+                assistCache->counters.writebacks++;
+            }
+        }
+        this->releaseMemoryBlock(lrutagllIndex, dirty);
+    }
+
+    // A block leaves this level
+    // An inclusive level invalidates the block above first; a dirty copy there
+    // makes the block dirty. A dirty block is written back, unless the next
+    // level is exclusive: that one takes every block evicted from here.
+    void releaseMemoryBlock(uint32_t blockAddr, bool dirty) {
+        bool upperDirty = false;
+        if (inclusion == INCLUSION_INCLUSIVE && previousCacheLevel->backInvalidate(blockAddr, &upperDirty)) {
+            inclusionStats.backInvalidations++;
+            if (upperDirty) {
+                inclusionStats.dirtyBackInvalidations++;
+                dirty = true;
+            }
+        }
+        Cache* nextCache = this->getNextCacheLevel();
+        if (nextCache != nullptr && nextCache->getInclusionPolicy() == INCLUSION_EXCLUSIVE) {
+            nextCache->insertVictim(blockAddr, dirty);
+            if (dirty) {
+                this->incrementWriteBacks();
+            }
+        }
+        else if (dirty) {
+            this->passWriteOn(blockAddr);
+            this->incrementWriteBacks();
+        }
+    }
+
+    // Bring a missed block into this level; an exclusive next level hands it up
+    // Returns true if the block arrives dirty, which only a block moving up from an exclusive level can
+    bool fetchMemoryBlockExtended(uint32_t tag, uint32_t index, uint32_t addr, bool streamBufferHit) {
+        Cache* nextCache = this->getNextCacheLevel();
+        bool dirty = false;
+        if (nextCache != nullptr && nextCache->getInclusionPolicy() == INCLUSION_EXCLUSIVE) {
+            dirty = nextCache->readExclusive(this->getTagllIndex(tag, index));
+        }
+        else {
+            this->fetchMemoryBlock(tag, index, addr, streamBufferHit);
+        }
+        // A miss cache keeps a copy of every block fetched
+        if (assistCache != nullptr && assistCache->getKind() == ASSIST_MISS) {
+            uint32_t evictedBlock;
+            bool evictedDirty;
+            assistCache->insert(this->getTagAndIndex(addr), false, &evictedBlock, &evictedDirty);
+        }
+        return dirty;
+    }
+
+    // Read of the level above from this exclusive level; returns true if the block is dirty
+    // The block moves up: a hit here, or in the victim cache, gives it up, and
+    // a miss fetches it from main memory without allocating it here
+    bool readExclusive(uint32_t addr) {
+        uint32_t tag = this->getTag(addr);
+        uint32_t index = this->getIndex(addr);
+        uint32_t tagAndIndex = this->getTagAndIndex(addr);
+        bool streamBufferHit = this->streamBuffersHold(tagAndIndex);
+        Set* targetSet = this->getSet(index);
+        uint32_t hitWay = targetSet->findWay(tag);
+        uint32_t assistEntry = AssistCache::NO_ENTRY;
+        if (hitWay == NO_WAY && assistCache != nullptr) {
+            assistEntry = assistCache->find(tagAndIndex);
+        }
+        if (classifier != nullptr) {
+            classifier->access(index, tagAndIndex, hitWay != NO_WAY, hitWay == NO_WAY && !streamBufferHit && assistEntry == AssistCache::NO_ENTRY);
+        }
+        this->incrementReads();
+        bool dirty = false;
+        if (hitWay != NO_WAY || assistEntry != AssistCache::NO_ENTRY) {
+            if (hitWay != NO_WAY) {
+                dirty = targetSet->isDirty(hitWay);
+                targetSet->invalidateMemoryBlock(hitWay);
+            }
+            else {
+                assistCache->counters.hits++;
+                dirty = assistCache->take(assistEntry);
+            }
+            if (streamBufferHit) {
+                stayInSyncWithDemandStream(tagAndIndex);
+            }
+        }
+        else {
+            if (!streamBufferHit) {
+                this->incrementReadMisses();
+            }
+            this->fetchMemoryBlock(tag, index, addr, streamBufferHit);
+        }
+        return dirty;
+    }
+
+    // Take a block the level above evicted into this exclusive level
+    // Only dirty blocks count as writes, so writes match the writebacks of the level above
+    void insertVictim(uint32_t addr, bool dirty) {
+        uint32_t tag = this->getTag(addr);
+        uint32_t index = this->getIndex(addr);
+        Set* targetSet = this->getSet(index);
+        inclusionStats.victimFills++;
+        // The block enters this level, so it takes part in the fully associative shadow of the classification
+        if (classifier != nullptr) {
+            classifier->access(index, this->getTagAndIndex(addr), false, false);
+        }
+        if (dirty) {
+            this->incrementWrites();
+        }
+        if (!targetSet->hasInvalidMemoryBlock()) {
+            uint32_t victimWay = targetSet->getVictimMemoryBlock();
+            if (victimWay != NO_WAY) {
+                this->evictMemoryBlockExtended(index, targetSet, victimWay);
+            }
+        }
+        uint32_t allocatedWay = targetSet->allocateMemoryBlock(tag);
+        if (dirty) {
+            targetSet->setDirty(allocatedWay);
+        }
+    }
+
+    // Make room for a missed block and bring it in, for a level that is not on the plain miss path
+    // Returns true if the block arrives dirty. A write-through level passes a write on right after
+    // the fetch, so the next level sees the read first. Kept out of line, so processCacheMiss() stays
+    // small enough to be inlined on the plain path.
+    __attribute__((noinline)) bool makeRoomAndFetchExtended(char instr, uint32_t addr, uint32_t tag, uint32_t index, Set* targetSet, bool streamBufferHit, uint32_t assistEntry) {
+        // The next level must see a buffered write to the block before it is fetched
+        if (writeBuffer != nullptr && assistEntry == AssistCache::NO_ENTRY && !streamBufferHit) {
+            this->drainWriteBufferFor(this->getTagllIndex(tag, index));
+        }
+        // A victim cache hands its block back before the set makes room, so the
+        // block evicted for it takes the entry it leaves
+        bool allocateDirty = false;
+        bool assistHit = (assistEntry != AssistCache::NO_ENTRY);
+        if (assistHit) {
+            assistCache->counters.hits++;
+            if (assistCache->getKind() == ASSIST_VICTIM) {
+                allocateDirty = assistCache->take(assistEntry);
+            }
+            else {
+                assistCache->touch(assistEntry);
+            }
+        }
+        // First evict then allocate
+        // The victim of an exclusive next level is only evicted once the requested
+        // block has left that level, so it cannot push the requested block out
+        uint32_t victimWay = NO_WAY;
+        if (!targetSet->hasInvalidMemoryBlock()) { // The set is full; the replacement policy picks the block to evict
+            victimWay = targetSet->getVictimMemoryBlock();
+        }
+        if (victimWay != NO_WAY && assistHit && assistCache->getKind() == ASSIST_VICTIM) {
+            assistCache->counters.swaps++;
+        }
+        Cache* nextCache = this->getNextCacheLevel();
+        bool evictAfterFetch = (nextCache != nullptr && nextCache->getInclusionPolicy() == INCLUSION_EXCLUSIVE);
+        if (victimWay != NO_WAY && !evictAfterFetch) {
+            this->evictMemoryBlockExtended(index, targetSet, victimWay);
+        }
+        if (!assistHit) {
+            allocateDirty = this->fetchMemoryBlockExtended(tag, index, addr, streamBufferHit);
+        }
+        else if (streamBufferHit) {
+            // Like a hit in the cache and the prefetch unit (Scenario #4)
+            stayInSyncWithDemandStream(this->getTagAndIndex(addr));
+        }
+        if (victimWay != NO_WAY && evictAfterFetch) {
+            this->evictMemoryBlockExtended(index, targetSet, victimWay);
+        }
+        if (instr == 'w' && writeThrough) {
+            this->writeThroughBlock(tag, index);
+        }
+        return allocateDirty;
+    }
+
+    // ------------------------------------- Prefetching into the sets -------------------------------------
+    // Prefetch block (tag and index) into its set unless this level holds it already
+    // The block evicted for it is remembered by the pollution filter unless it was an unused prefetch itself
+    void prefetchBlock(uint32_t block) {
+        uint32_t blockAddr = block << blockOffsetBitCount;
+        uint32_t tag = this->getTag(blockAddr);
+        uint32_t index = this->getIndex(blockAddr);
+        Set* targetSet = this->getSet(index);
+        if (targetSet->findWay(tag) != NO_WAY || (assistCache != nullptr && assistCache->find(block) != AssistCache::NO_ENTRY)) {
+            return;
+        }
+        if (writeBuffer != nullptr) {
+            this->drainWriteBufferFor(blockAddr);
+        }
+        if (!targetSet->hasInvalidMemoryBlock()) {
+            uint32_t victimWay = targetSet->getVictimMemoryBlock();
+            if (victimWay != NO_WAY) {
+                if (!prefetcher->isPrefetched(index * assoc + victimWay)) {
+                    prefetcher->evictedByPrefetch(this->getTagAndIndex(this->getTagllIndex(targetSet->getTag(victimWay), index)));
+                }
+                this->evictMemoryBlockExtended(index, targetSet, victimWay);
+            }
+        }
+        Cache* nextCache = this->getNextCacheLevel();
+        if (nextCache != nullptr) {
+            nextCache->executeInstruction('p', blockAddr);
+        }
+        else {
+            this->toMemory(blockAddr, false);
+        }
+        this->incrementPrefetches();
+        uint32_t allocatedWay = targetSet->allocateMemoryBlock(tag);
+        prefetcher->fill(index * assoc + allocatedWay, true);
+    }
+
+    // Keep track of the prefetched blocks a request hit or replaced, then train the prefetcher on
+    // a demand request and prefetch the blocks it asks for; miss is true if no part of the level held the block
+    void prefetchAfter(char instr, uint32_t addr, uint32_t hitWay, bool miss) {
+        uint32_t index = this->getIndex(addr);
+        Set* targetSet = this->getSet(index);
+        bool prefetchHit = false;
+        if (hitWay != NO_WAY) {
+            prefetchHit = prefetcher->hit(index * assoc + hitWay);
+        }
+        else {
+            uint32_t allocatedWay = targetSet->findWay(this->getTag(addr));
+            if (allocatedWay != NO_WAY) {
+                prefetcher->fill(index * assoc + allocatedWay, false);
+            }
+        }
+        // Below L1 the writes are writebacks and the prefetch reads come from the prefetcher above
+        bool demand = (instr == 'r' || (instr == 'w' && this->getCacheLevel() == 1));
+        if (!demand) {
+            return;
+        }
+        uint32_t block = this->getTagAndIndex(addr);
+        if (miss) {
+            prefetcher->demandMiss(block);
+        }
+        prefetcher->train(block, miss, prefetchHit);
+        for (uint32_t i = 0; i < prefetcher->candidates.count; ++i) {
+            this->prefetchBlock(prefetcher->candidates.blocks[i]);
+        }
     }
 
     // Handle cache miss
-    void processCacheMiss(char instr, uint32_t addr, uint32_t tag, uint32_t index, memBlock* targetMemBlock, CacheSet* targetSet, bool streamBufferHit=false) {
+    // assistEntry is the entry of the victim or miss cache holding the block, or AssistCache::NO_ENTRY
+    void processCacheMiss(char instr, uint32_t addr, uint32_t tag, uint32_t index, Set* targetSet, bool streamBufferHit=false,
+                          uint32_t assistEntry=AssistCache::NO_ENTRY) {
         // Handle cache miss logic here
         //  There is no memory block in this set with the requested tag
         // ***** Debug statements begin
-        debugPrint("%sL%d: %6s: set %6d: %s\n",this->generateTabs().c_str(), this->getCacheLevel(), std::string("before").c_str(), index, targetSet->getSetContent().c_str());
+        debugTrace(this->getCacheLevel(), index, addr, "%sL%d: %6s: set %6d: %s\n",this->generateTabs().c_str(), this->getCacheLevel(), "before", index, targetSet->getSetContent().c_str());
         // ***** Debug statements end
-        if (!streamBufferHit && instr == 'r') { // Read miss excluding those that hit in stream buffers if prefetch unit is present
+        bool assistHit = (assistEntry != AssistCache::NO_ENTRY);
+        if (!streamBufferHit && !assistHit && instr == 'r') { // Read miss excluding those that hit in stream buffers or the victim/miss cache
             this->incrementReadMisses();
             }
-        else if (!streamBufferHit && instr == 'w') { // Write miss excluding those that hit in stream buffers if prefetch unit is present
+        else if (!streamBufferHit && !assistHit && instr == 'w') { // Write miss excluding those that hit in stream buffers or the victim/miss cache
             this->incrementWriteMisses();
         }
-        // First evict then allocate
-        if (targetSet->hasInvalidMemoryBlock()) { // At least one invalid memory block in the set
-            // Issue request to the next level
-            Cache* nextCache = this->getNextCacheLevel();
-                if (nextCache != nullptr) { // Next cache level exists
-                    // Send read instruction to next level
-                    uint32_t tagllIndex = this->getTagllIndex(tag, index);
-                    nextCache->executeInstruction('r', tagllIndex);
-                    // Following scenario (prefetching at a level higher than the lowermost level) is out of scope; leaving the code for improvising later
-                    // if (!streamBufferHit) {
-                    //     // Scenario #1:
-                    //     // prefetch the next M consecutive memory blocks into Cache
-                    //     // debugPrint("\t\t\tScenario #1 invalid memory block next cache level exists\n");
-                    //     uint32_t tagAndIndex = this->getTagAndIndex(addr);
-                    //     prefetchBlocksIntoStreamBuffer(tagAndIndex, M);
-                    // }
-                    // else {
-                    //         // Scenario #2:
-                    //         // instead of making request to the next level of cache,
-                    //         // copy the request block X from the Stream buffer into Cache
-                    //         // debugPrint("\t\t\tScenario #2 dirty lru memory block next cache level exists\n");
-                    //         uint32_t tagAndIndex = this->getTagAndIndex(addr);
-                    //         transferBlockfromStreamBuffer(tagAndIndex);
-                    //     }
-                }
-                else { // Accessing main memory
-                    if (!streamBufferHit) {
-                        memTraffic++;
-                        // Scenario #1:
-                        // prefetch the next M consecutive memory blocks into Cache
-                        // debugPrint("\t\t\tScenario #1 invalid memory block next cache level not exists\n");
-                        uint32_t tagAndIndex = this->getTagAndIndex(addr);
-                        prefetchBlocksIntoStreamBuffer(tagAndIndex, M);
-                    }
-                    else {
-                            // Scenario #2:
-                            // instead of making request to the next level of cache,
-                            // copy the request block X from the Stream buffer into Cache
-                            // debugPrint("\t\t\tScenario #2 dirty lru memory block next cache level exists\n");
-                            uint32_t tagAndIndex = this->getTagAndIndex(addr);
-                            transferBlockfromStreamBuffer(tagAndIndex);
-                        }
-                }
+        else if (!streamBufferHit && !assistHit && instr == 'p') { // Prefetch read miss, likewise
+            this->incrementReadMissPrefetches();
         }
-        else { // Check if LRUMemBlock is valid. You get invalid block in case there are existing invalid blocks in the set
-            memBlock* lruMemBlock = targetSet->getLRUMemoryBlock();
-            // Check if dirty bit is set
-            if (lruMemBlock != nullptr) {
-                if (lruMemBlock->dirtyBit) { // LRU block has the dirty bit set
-                    // construct a similar address like value from tag and index
-                    // of LRU memblock ignoring the block offset bits
-                    // it is safe to ignore block offset bits because 
-                    // block size is same at all levels
-                    uint32_t lruTag = lruMemBlock->tag;
-                    uint32_t lrutagllIndex = this->getTagllIndex(lruTag, index);
-                    // Fetch next level in cache hierarchy
-                    Cache* nextCache = this->getNextCacheLevel();
-                    if (nextCache != nullptr) {
-                        // Issue a write instruction to the next level
-                        nextCache->executeInstruction('w', lrutagllIndex);
-                        this->incrementWriteBacks();
-                        targetSet->invalidateMemoryBlock(lruMemBlock);
-                        // Following scenario (prefetching at a level higher than the lowermost level) is out of scope; leaving the code for improvising later
-                        // if (!streamBufferHit) {
-                        //     // Send request to the next level of cache
-                        //     uint32_t tagllIndex = this->getTagllIndex(tag, index);
-                        //     nextCache->executeInstruction('r', tagllIndex);
-                        //     // Scenario #1: 
-                        //     // prefetch the next M consecutive memory blocks into Cache
-                        //     // debugPrint("\t\t\tScenario #1 dirty lru memory block next cache level exists\n");
-                        //     uint32_t tagAndIndex = this->getTagAndIndex(addr);
-                        //     prefetchBlocksIntoStreamBuffer(tagAndIndex, M);
-                        // }
-                        // else {
-                        //     // Scenario #2:
-                        //     // instead of making request to the next level of cache,
-                        //     // copy the request block X from the Stream buffer into Cache
-                        //     // debugPrint("\t\t\tScenario #2 dirty lru memory block next cache level exists\n");
-                        //     uint32_t tagAndIndex = this->getTagAndIndex(addr);
-                        //     transferBlockfromStreamBuffer(tagAndIndex);
-                        // }
-                    }
-                    else { // this is the last level of cache. next is main memory
-                        this->incrementWriteBacks();
-                        // Update memory traffic counter
-                        memTraffic++;
-                        targetSet->invalidateMemoryBlock(lruMemBlock);
-                        if (!streamBufferHit) {
-                            // Again update memory traffic because now the actual request needs to be serviced after the write back
-                            // But since this is a case of miss, the block needs to be allocated from main memory
-                            memTraffic++;
-                            // Scenario #1: 
-                            // prefetch the next M consecutive memory blocks into Cache
-                            // debugPrint("\t\t\tScenario #1 dirty lru memory block next cache level not exists\n");
-                            uint32_t tagAndIndex = this->getTagAndIndex(addr);
-                            prefetchBlocksIntoStreamBuffer(tagAndIndex, M); 
-                        }
-                        else {
-                            // Scenario #2:
-                            // instead of making request to the next level of cache,
-                            // copy the request block X from the Stream buffer into Cache
-                            uint32_t tagAndIndex = this->getTagAndIndex(addr);
-                            // debugPrint("\t\t\tScenario #2 dirty lru memory block next cache level not exists\n");
-                            transferBlockfromStreamBuffer(tagAndIndex);
-                        }
-                    }
-                }
-                else { // LRU memblock does not have the dirty bit
-                    targetSet->invalidateMemoryBlock(lruMemBlock);
-                    Cache* nextCache = this->getNextCacheLevel();
-                    if (nextCache != nullptr) {
-                        // Send read instruction to next level
-                        uint32_t tagllIndex = this->getTagllIndex(tag, index);
-                        nextCache->executeInstruction('r', tagllIndex);
-                        // Following scenario (prefetching at a level higher than the lowermost level) is out of scope; leaving the code for improvising later
-                        // if (!streamBufferHit) {
-                        //     // Scenario #1: 
-                        //     // prefetch the next M consecutive memory blocks into Cache
-                        //     // debugPrint("\t\t\tScenario #1 not dirty lru memory block next cache level exists\n");
-                        //     uint32_t tagAndIndex = this->getTagAndIndex(addr);
-                        //     prefetchBlocksIntoStreamBuffer(tagAndIndex, M);
-                        // }
-                        // else {
-                        //     // Scenario #2:
-                        //     // instead of making request to the next level of cache,
-                        //     // copy the request block X from the Stream buffer into Cache
-                        //     uint32_t tagAndIndex = this->getTagAndIndex(addr);
-                        //     // debugPrint("\t\t\tScenario #2 not dirty lru memory block next cache level exists\n");
-                        //     transferBlockfromStreamBuffer(tagAndIndex);
-                        // }
-                    }
-                    else {
-                        // Scenario #1: 
-                        // prefetch the next M consecutive memory blocks into Cache
-                        if (!streamBufferHit) {
-                            // Accessing from main memory the original request after invalidating LRU block
-                            memTraffic++;
-                            // debugPrint("\t\t\tScenario #1 not dirty lru memory block next cache level not exists\n");
-                            uint32_t tagAndIndex = this->getTagAndIndex(addr);
-                            prefetchBlocksIntoStreamBuffer(tagAndIndex, M);
-                        }
-                        else {
-                            // Scenario #2:
-                            // instead of making request to the next level of cache,
-                            // copy the request block X from the Stream buffer into Cache
-                            uint32_t tagAndIndex = this->getTagAndIndex(addr);
-                            // debugPrint("\t\t\tScenario #2 not dirty lru memory block next cache level not exists\n");
-                            transferBlockfromStreamBuffer(tagAndIndex);
-                        }
-                    }
+        bool allocateDirty = false;
+        if (plainMissPath) {
+            // First evict then allocate
+            if (!targetSet->hasInvalidMemoryBlock()) { // The set is full; the replacement policy picks the block to evict
+                uint32_t victimWay = targetSet->getVictimMemoryBlock();
+                if (victimWay != NO_WAY) {
+                    this->evictMemoryBlock(index, targetSet, victimWay);
                 }
             }
+            this->fetchMemoryBlock(tag, index, addr, streamBufferHit);
+        }
+        else if (!writeAllocate && instr == 'w' && !streamBufferHit && !assistHit) {
+            // A level that does not allocate on writes passes a write miss on and leaves its set as it was
+            this->writeAround(tag, index);
+            return;
+        }
+        else {
+            allocateDirty = this->makeRoomAndFetchExtended(instr, addr, tag, index, targetSet, streamBufferHit, assistEntry);
         }
         // Allocate missed memory block at set
-        memBlock* allocatedBlock = targetSet->allocateMemoryBlock(tag, addr);
-        targetSet->updateLRURank(allocatedBlock);
+        uint32_t allocatedWay = targetSet->allocateMemoryBlock(tag);
+        if (allocateDirty) {
+            targetSet->setDirty(allocatedWay);
+        }
         if (instr == 'r') { 
             // Increment read counter
             this->incrementReads();
             // Read request fulfilled
         }
         else if (instr == 'w') {
-            // Set dirty bits
-            allocatedBlock->dirtyBit = true;
+            // Set dirty bits, unless the write is passed on below
+            if (plainMissPath || !writeThrough) {
+                targetSet->setDirty(allocatedWay);
+            }
             // Increment write counter
             this->incrementWrites();
             // Write request fulfilled
         }
+        else { // Prefetch read from the level above
+            this->incrementReadPrefetches();
+        }
         // ***** Debug statements begin
-        debugPrint("%sL%d: %6s: set %6d: %s\n",this->generateTabs().c_str(), this->getCacheLevel(), std::string("after").c_str(), index, targetSet->getSetContent().c_str());
+        debugTrace(this->getCacheLevel(), index, addr, "%sL%d: %6s: set %6d: %s\n",this->generateTabs().c_str(), this->getCacheLevel(), "after", index, targetSet->getSetContent().c_str());
+        #if DEBUG
         for (auto& streamBuffer : this->streamBuffers) {
             if (streamBuffer.isValid()) {
-                debugPrint("\t\t\tSB: %s\n", streamBuffer.getContent().c_str());
+                debugTrace(this->getCacheLevel(), index, addr, "\t\t\tSB: %s\n", streamBuffer.getContent().c_str());
             }
         }
+        #endif
         // ***** Debug statements end
     }
 
-    // Handles execution of instrction and address received from the cpu trace
+    // Handles execution of instrction and address received from the cpu trace,
+    // or from the level above: its misses, writebacks and prefetch reads ('p')
     void executeInstruction(char instr, uint32_t addr) {
+        if (prefetcher != nullptr) {
+            this->executeAndPrefetch(instr, addr);
+            return;
+        }
+        this->serviceRequest(instr, addr);
+    }
+
+    // executeInstruction() of a level with a prefetcher; out of line, so the levels without one do not pay for it
+    // The block is looked up once more before the request is served, which leaves the hit way where it was
+    __attribute__((noinline)) void executeAndPrefetch(char instr, uint32_t addr) {
+        uint32_t block = this->getTagAndIndex(addr);
+        uint32_t hitWay = this->getSet(this->getIndex(addr))->findWay(this->getTag(addr));
+        bool miss = hitWay == NO_WAY && !this->streamBuffersHold(block)
+            && (assistCache == nullptr || assistCache->find(block) == AssistCache::NO_ENTRY);
+        this->serviceRequest(instr, addr);
+        this->prefetchAfter(instr, addr, hitWay, miss);
+    }
+
+    // Serve a request from the sets, the stream buffers and the victim or miss cache
+    void serviceRequest(char instr, uint32_t addr) {
         this->addr = addr;
         uint32_t tag = this->getTag(addr);
         uint32_t index = this->getIndex(addr);
+        // In sampling mode, requests to sets that are not sampled are not simulated at all
+        if (sampler != nullptr && !sampler->isSampled(index)) {
+            return;
+        }
         uint32_t tagAndIndex = this->getTagAndIndex(addr);
         // ***** Debug statements begin
-        debugPrint("%sL%d: %c %x (tag=%x index=%d)\n",this->generateTabs().c_str(), this->getCacheLevel(), instr, addr, tag, index);
+        debugTrace(this->getCacheLevel(), index, addr, "%sL%d: %c %x (tag=%x index=%d)\n",this->generateTabs().c_str(), this->getCacheLevel(), instr, addr, tag, index);
         // ***** Debug statements end
 
         bool cacheHit = false;
-        bool streamBufferHit = false;
-        for (auto& streamBuffer : streamBuffers) {
-            if (streamBuffer.isValid()) {
-                if (streamBuffer.hasSBMemoryBlock(tagAndIndex)) {
-                    streamBufferHit = true;
-                    break;
-                }
-            }
-        }
+        bool streamBufferHit = this->streamBuffersHold(tagAndIndex);
         // Fetch the set matching the index of the address
-        CacheSet* targetSet = this->getSet(index);
-        // We have to fetch the target memory block where the cache would hit/miss
-        memBlock* targetMemBlock = nullptr;
+        Set* targetSet = this->getSet(index);
         if (targetSet != nullptr) { // If we find a set == index
-            cacheHit = targetSet->hasMemoryBlock(tag);
+            // We have to fetch the target way where the cache would hit/miss
+            uint32_t hitWay = targetSet->findWay(tag);
+            cacheHit = (hitWay != NO_WAY);
+            // The victim or miss cache is probed along with the set
+            uint32_t assistEntry = AssistCache::NO_ENTRY;
+            if (!cacheHit && assistCache != nullptr) {
+                assistEntry = assistCache->find(tagAndIndex);
+            }
+            if (classifier != nullptr) {
+                classifier->access(index, tagAndIndex, cacheHit, !cacheHit && !streamBufferHit && assistEntry == AssistCache::NO_ENTRY && instr != 'p');
+            }
             if (!cacheHit) { // Cache Miss
-                // debugPrint("\t$$$ Cache Hit False stream buffer hit %d\n", static_cast<int>(streamBufferHit));
-                processCacheMiss(instr, addr, tag, index, targetMemBlock, targetSet, streamBufferHit);
+                debugTrace(this->getCacheLevel(), index, addr, "%sL%d: miss%s\n", this->generateTabs().c_str(), this->getCacheLevel(), streamBufferHit ? ", stream buffer hit" : "");
+                processCacheMiss(instr, addr, tag, index, targetSet, streamBufferHit, assistEntry);
             }
             else { // Cache Hit
-                // debugPrint("\t$$$ Cache Hit True stream buffer hit %d\n", streamBufferHit);
-                processCacheHit(instr, addr, tag, index, targetMemBlock, targetSet, static_cast<int>(streamBufferHit));
+                debugTrace(this->getCacheLevel(), index, addr, "%sL%d: hit%s\n", this->generateTabs().c_str(), this->getCacheLevel(), streamBufferHit ? ", stream buffer hit" : "");
+                processCacheHit(instr, addr, tag, index, hitWay, targetSet, static_cast<int>(streamBufferHit));
                 if (!streamBufferHit) {
                     // Scenarion #3:
                     // do nothing wrt the stream buffer
@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <vector>
+
+// Miss classification (the three Cs)
+//
+// Every demand miss of a level is put in one of three classes:
+//    compulsory  the block was never referenced at this level before
+//    capacity    a fully associative LRU cache of the same capacity misses too
+//    conflict    the fully associative cache would have hit; only the mapping
+//                of blocks to sets made this a miss
+// The first touch of a block is tracked in a bitmap of block numbers and
+// the fully associative cache is a shadow LRU list with a hash index, so
+// both are O(1) per request. The shadow sees every request that reaches the
+// level, hit or miss; blocks a stream buffer supplies count as touched.
+
+// Hashes a block number into the top `bits` bits (Fibonacci hashing)
+static inline uint32_t hashBlock(uint32_t block, uint32_t bits) {
+    return uint32_t((uint64_t(block) * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+}
+
+// Set of the block numbers referenced so far
+// A bitmap over every possible block number. It is allocated with calloc,
+// whose large blocks come straight from the kernel as zero pages, so only the
+// pages of blocks actually referenced ever become resident.
+class FirstTouchSet {
+private:
+    uint64_t* bits;
+
+public:
+    // blockBits: width of a block number (address bits above the block offset)
+    FirstTouchSet(uint32_t blockBits) {
+        size_t words = (size_t(1) << blockBits) / 64 + 1;
+        bits = static_cast<uint64_t*>(calloc(words, sizeof(uint64_t)));
+        if (bits == nullptr) {
+            printf("Error: Unable to allocate the miss classification.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    ~FirstTouchSet() {
+        free(bits);
+    }
+
+    FirstTouchSet(const FirstTouchSet&) = delete;
+    FirstTouchSet& operator=(const FirstTouchSet&) = delete;
+
+    // Adds block; returns true if it was not in the set yet
+    bool insert(uint32_t block) {
+        uint64_t mask = uint64_t(1) << (block % 64);
+        uint64_t& word = bits[block / 64];
+        bool added = (word & mask) == 0;
+        word |= mask;
+        return added;
+    }
+};
+
+// Fully associative LRU cache of a fixed number of blocks that only tracks block numbers
+// The blocks live in a doubly linked list from most to least recently used;
+// a hash table of list positions finds a block in O(1). Everything is
+// allocated up front.
+class ShadowLRU {
+private:
+    enum : uint32_t { NONE = 0xFFFFFFFFu };
+    uint32_t capacity;
+    uint32_t count; // blocks held
+    std::vector<uint32_t> blocks; // per entry: block number
+    std::vector<uint32_t> prev; // per entry: next more recently used entry
+    std::vector<uint32_t> next; // per entry: next less recently used entry
+    uint32_t head; // MRU entry
+    uint32_t tail; // LRU entry
+    std::vector<uint32_t> index; // hash table of entries, open addressing with linear probing
+    uint32_t bits; // index.size() == 1 << bits
+
+    uint32_t findSlot(uint32_t block) const {
+        uint32_t mask = uint32_t(index.size() - 1);
+        uint32_t slot = hashBlock(block, bits);
+        while (index[slot] != NONE && blocks[index[slot]] != block) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    // Removes the entry at slot and moves later entries of its probe run back into the gap
+    void eraseSlot(uint32_t slot) {
+        uint32_t mask = uint32_t(index.size() - 1);
+        uint32_t gap = slot;
+        for (uint32_t probe = (slot + 1) & mask; index[probe] != NONE; probe = (probe + 1) & mask) {
+            uint32_t home = hashBlock(blocks[index[probe]], bits);
+            // The entry may fill the gap if its home does not lie between the gap and its slot
+            if (((probe - home) & mask) >= ((probe - gap) & mask)) {
+                index[gap] = index[probe];
+                gap = probe;
+            }
+        }
+        index[gap] = NONE;
+    }
+
+    void unlink(uint32_t entry) {
+        if (prev[entry] != NONE) {
+            next[prev[entry]] = next[entry];
+        }
+        else {
+            head = next[entry];
+        }
+        if (next[entry] != NONE) {
+            prev[next[entry]] = prev[entry];
+        }
+        else {
+            tail = prev[entry];
+        }
+    }
+
+    void pushFront(uint32_t entry) {
+        prev[entry] = NONE;
+        next[entry] = head;
+        if (head != NONE) {
+            prev[head] = entry;
+        }
+        head = entry;
+        if (tail == NONE) {
+            tail = entry;
+        }
+    }
+
+public:
+    ShadowLRU(uint32_t capacity) : capacity(capacity), count(0), head(NONE), tail(NONE), bits(1) {
+        blocks.assign(capacity, 0);
+        prev.assign(capacity, NONE);
+        next.assign(capacity, NONE);
+        // At most half full
+        while ((size_t(1) << bits) < size_t(capacity) * 2) {
+            bits++;
+        }
+        index.assign(size_t(1) << bits, NONE);
+    }
+
+    // References block; returns true if it was held, i.e. the fully associative cache hits
+    bool access(uint32_t block) {
+        uint32_t slot = this->findSlot(block);
+        if (index[slot] != NONE) {
+            uint32_t entry = index[slot];
+            if (entry != head) {
+                this->unlink(entry);
+                this->pushFront(entry);
+            }
+            return true;
+        }
+        uint32_t entry;
+        if (count < capacity) {
+            entry = count++;
+        }
+        else {
+            // Evict the LRU block; its slot may be reused by the probe below
+            entry = tail;
+            this->unlink(entry);
+            this->eraseSlot(this->findSlot(blocks[entry]));
+            slot = this->findSlot(block);
+        }
+        blocks[entry] = block;
+        index[slot] = entry;
+        this->pushFront(entry);
+        return false;
+    }
+};
+
+// Compulsory, capacity and conflict miss counts
+typedef
+struct {
+   uint64_t compulsory;
+   uint64_t capacity;
+   uint64_t conflict;
+} miss_classes_t;
+
+// Classifies the misses of one cache level, in total and per set
+class MissClassifier {
+private:
+    FirstTouchSet touched;
+    ShadowLRU shadow;
+    miss_classes_t total;
+    std::vector<miss_classes_t> perSet;
+
+public:
+    MissClassifier(uint32_t blockBits, uint32_t setCount, uint32_t assoc) : touched(blockBits), shadow(setCount * assoc), perSet(setCount) {
+        total.compulsory = 0;
+        total.capacity = 0;
+        total.conflict = 0;
+        for (auto& set : perSet) {
+            set = total;
+        }
+    }
+
+    // Records a request for block (tag and index) in set; hit says whether
+    // the level held the block and demandMiss whether the request counts as a miss
+    void access(uint32_t set, uint32_t block, bool hit, bool demandMiss) {
+        bool shadowHit = shadow.access(block);
+        if (hit) {
+            return;
+        }
+        bool firstTouch = touched.insert(block);
+        if (!demandMiss) {
+            return;
+        }
+        uint64_t miss_classes_t::*missClass = &miss_classes_t::conflict;
+        if (firstTouch) {
+            missClass = &miss_classes_t::compulsory;
+        }
+        else if (!shadowHit) {
+            missClass = &miss_classes_t::capacity;
+        }
+        total.*missClass += 1;
+        perSet[set].*missClass += 1;
+    }
+
+    const miss_classes_t& getTotal() const {
+        return total;
+    }
+
+    const miss_classes_t& getSet(uint32_t set) const {
+        return perSet[set];
+    }
+
+    uint32_t getSetCount() const {
+        return uint32_t(perSet.size());
+    }
+};
@@ -0,0 +1,531 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Multi-core simulation with MESI coherence
+//
+// Every core has a private L1 and all of them share one L2 over a snooping
+// bus; without an L2 the L1s share main memory. The request trace names the
+// core that issued each request (see trace.cpp). A block in an L1 is in one
+// of the four MESI states, kept as its valid and dirty bits plus a "shared"
+// bit per block:
+//    M  modified, the only copy and dirty       valid, dirty
+//    E  exclusive, the only copy and clean      valid, clean, not shared
+//    S  shared, other L1s may hold copies       valid, clean, shared
+//    I  invalid                                 not valid
+//
+// Requests that need the bus:
+//    read miss         BusRd: an M or E copy in another L1 intervenes and
+//                      drops to S, an M copy after flushing its data to the
+//                      L2; the block is filled in S if any other L1 holds
+//                      it and in E if none does
+//    write miss        BusRdX: every other copy is invalidated, an M copy
+//                      after flushing its data; the block is filled in M
+//    write hit in S    BusUpgr: every other copy is invalidated; S becomes M
+// Every other request is a local hit: a read in M, E or S, or a write in M
+// or E (E silently becomes M). Fills always read the L2, which a flush has
+// brought up to date, and clean blocks are evicted silently. The L2 is not
+// inclusive, as in the single-core hierarchy.
+//
+// Parallel simulation
+// A local hit only changes its own core's L1: counters, replacement state and
+// at most the dirty bit of a block that stays cached. Whether a request is a
+// local hit depends only on the tags and the shared bits, and only bus
+// transactions change those. So with worker threads the requests of a batch
+// are dispatched in trace order: local hits are queued on their core, and
+// before a bus transaction touches an L1 (the requester's, or another one
+// that holds the block) that core's queue is run first. At the end of the
+// batch the queues of all cores run in parallel. Each L1 sees exactly the
+// operations of a sequential run, in the same order, so the results do not
+// depend on the number of threads. Between batches the workers sleep on a
+// condition variable, and so does the caller while the last cores finish.
+
+// Coherence events of one core
+typedef
+struct {
+   uint64_t busReads;		// BusRd issued: read misses
+   uint64_t busReadExclusives;	// BusRdX issued: write misses
+   uint64_t upgrades;		// BusUpgr issued: writes to blocks in S
+   uint64_t invalidations;	// copies invalidated by other cores' requests
+   uint64_t interventions;	// M or E copies that answered another core's BusRd or BusRdX
+   uint64_t flushes;		// M copies written back to the L2 for another core
+} coherence_counters_t;
+
+template <class Policy>
+class MultiCoreHierarchy : public CacheHierarchy {
+private:
+    cache_params_t params;
+    uint32_t coreCount;
+    std::vector<Cache<Policy>*> l1Caches; // l1Caches[core]
+    Cache<Policy>* l2Cache; // shared by every core, or nullptr
+    std::vector<std::vector<uint8_t>> shared; // shared[core][block position]: the clean block is in S rather than E
+    std::vector<coherence_counters_t> counters; // counters[core]
+    uint64_t requestCount; // requests issued so far; numbers the request trace lines
+
+    // Parallel simulation
+    std::vector<std::vector<TraceRecord>> pending; // pending[core]: local hits not run yet, in trace order
+    std::vector<std::thread> workers;
+    std::atomic<uint64_t> round; // bumped to start running every core's pending hits
+    std::atomic<uint32_t> nextCore; // next core whose pending hits are taken in this round
+    std::atomic<uint32_t> coresDone; // cores whose pending hits have run in this round
+    std::atomic<bool> stopping;
+    std::mutex mutex; // guards sleeping on roundStarted and roundDone only
+    std::condition_variable roundStarted; // `round` or `stopping` changed
+    std::condition_variable roundDone; // every core of the round has run
+
+    // Runs the local hits queued on core
+    void runPending(uint32_t core) {
+        Cache<Policy>* l1 = l1Caches[core];
+        for (auto& record : pending[core]) {
+            l1->executeInstruction(record.rw, record.addr);
+        }
+        pending[core].clear();
+    }
+
+    // Takes cores of the current round until there are none left
+    void runPendingShare() {
+        uint32_t core;
+        while ((core = nextCore.fetch_add(1)) < coreCount) {
+            this->runPending(core);
+            if (coresDone.fetch_add(1, std::memory_order_acq_rel) + 1 == coreCount) {
+                std::lock_guard<std::mutex> lock(mutex);
+                roundDone.notify_one();
+            }
+        }
+    }
+
+    // Runs the local hits queued on every core, on the workers and this thread
+    void runAllPending() {
+        if (workers.empty()) {
+            return;
+        }
+        coresDone.store(0);
+        nextCore.store(0);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            round.fetch_add(1, std::memory_order_release);
+        }
+        roundStarted.notify_all();
+        this->runPendingShare();
+        if (coresDone.load(std::memory_order_acquire) != coreCount) {
+            std::unique_lock<std::mutex> lock(mutex);
+            roundDone.wait(lock, [&]() {
+                return coresDone.load(std::memory_order_acquire) == coreCount;
+            });
+        }
+    }
+
+    void work() {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                roundStarted.wait(lock, [&]() {
+                    return round.load(std::memory_order_acquire) != seen || stopping.load(std::memory_order_relaxed);
+                });
+                if (round.load(std::memory_order_acquire) == seen) {
+                    return;
+                }
+                seen = round.load(std::memory_order_acquire);
+            }
+            this->runPendingShare();
+        }
+    }
+
+    // Lets the copy of addr in core's L1, if there is one, answer a bus
+    // request: an M copy is flushed, an E copy intervenes without data.
+    // Returns the position of the copy, or NO_WAY if the L1 does not hold the block
+    uint32_t snoop(uint32_t core, uint32_t addr) {
+        Cache<Policy>* l1 = l1Caches[core];
+        uint32_t position = l1->findBlock(addr);
+        if (position == NO_WAY) {
+            return NO_WAY;
+        }
+        // Hits of this core that come earlier in the trace may still make the copy dirty
+        this->runPending(core);
+        if (l1->isBlockDirty(position)) {
+            l1->flushBlock(position);
+            counters[core].flushes++;
+            counters[core].interventions++;
+        }
+        else if (!shared[core][position]) {
+            counters[core].interventions++;
+        }
+        return position;
+    }
+
+    // BusRd: every other copy of addr drops to S; returns true if there was any
+    bool downgradeOthers(uint32_t requester, uint32_t addr) {
+        bool copies = false;
+        for (uint32_t core = 0; core < coreCount; ++core) {
+            if (core != requester) {
+                uint32_t position = this->snoop(core, addr);
+                if (position != NO_WAY) {
+                    shared[core][position] = 1;
+                    copies = true;
+                }
+            }
+        }
+        return copies;
+    }
+
+    // BusRdX and BusUpgr: every other copy of addr is invalidated
+    void invalidateOthers(uint32_t requester, uint32_t addr) {
+        for (uint32_t core = 0; core < coreCount; ++core) {
+            if (core != requester) {
+                uint32_t position = this->snoop(core, addr);
+                if (position != NO_WAY) {
+                    l1Caches[core]->invalidateBlock(position);
+                    counters[core].invalidations++;
+                }
+            }
+        }
+    }
+
+    // Issue one request of core
+    void issue(char rw, uint32_t addr, uint32_t core) {
+        Cache<Policy>* l1 = l1Caches[core];
+        uint32_t position = l1->findBlock(addr);
+        if (position != NO_WAY && (rw == 'r' || !shared[core][position])) {
+            // Local hit
+            if (workers.empty()) {
+                l1->executeInstruction(rw, addr);
+            }
+            else {
+                if (pending[core].size() == pending[core].capacity()) {
+                    this->runPending(core);
+                }
+                TraceRecord record;
+                record.addr = addr;
+                record.rw = rw;
+                record.core = uint8_t(core);
+                pending[core].push_back(record);
+            }
+            return;
+        }
+        // A bus transaction; this core's earlier hits go first
+        this->runPending(core);
+        if (position != NO_WAY) {
+            counters[core].upgrades++;
+            this->invalidateOthers(core, addr);
+            l1->executeInstruction(rw, addr);
+            shared[core][position] = 0;
+            return;
+        }
+        bool copies = false;
+        if (rw == 'w') {
+            counters[core].busReadExclusives++;
+            this->invalidateOthers(core, addr);
+        }
+        else {
+            counters[core].busReads++;
+            copies = this->downgradeOthers(core, addr);
+        }
+        l1->executeInstruction(rw, addr);
+        shared[core][l1->findBlock(addr)] = copies ? 1 : 0;
+    }
+
+public:
+    // Builds coreCount private L1s and a shared L2 from params; with more than
+    // one thread, local hits are simulated on threads - 1 workers and the caller
+    MultiCoreHierarchy(const cache_params_t& params, uint32_t coreCount, uint32_t threads)
+        : params(params), coreCount(coreCount), l2Cache(nullptr), requestCount(0), round(0), nextCore(0), coresDone(0), stopping(false) {
+        if (params.L1_SIZE == 0) {
+            printf("Error: A multi-core simulation needs an L1 cache.\n");
+            exit(EXIT_FAILURE);
+        }
+        // A stream buffer at an L1 would hold copies of blocks the bus does not snoop
+        if (params.L2_SIZE == 0 && params.PREF_N > 0) {
+            printf("Error: A multi-core simulation prefetches into the shared L2 only; PREF_N must be 0 without an L2.\n");
+            exit(EXIT_FAILURE);
+        }
+        if (params.L2_SIZE != 0) {
+            l2Cache = new Cache<Policy>(2, params.L2_SIZE, params.BLOCKSIZE, params.L2_ASSOC);
+            if (params.PREF_N > 0) {
+                l2Cache->addStreamBuffers(params.PREF_N, params.PREF_M, &requestCount);
+            }
+        }
+        for (uint32_t core = 0; core < coreCount; ++core) {
+            l1Caches.push_back(new Cache<Policy>(1, params.L1_SIZE, params.BLOCKSIZE, params.L1_ASSOC));
+            l1Caches[core]->setNextCacheLevel(l2Cache);
+            shared.emplace_back(l1Caches[core]->getBlockCount(), 0);
+        }
+        counters.assign(coreCount, coherence_counters_t());
+        // Tracing writes from whichever thread runs a request, so it keeps the simulation on one thread
+        if (DEBUG || threads > coreCount) {
+            threads = DEBUG ? 1 : coreCount;
+        }
+        pending.resize(coreCount);
+        if (threads > 1) {
+            for (auto& queue : pending) {
+                queue.reserve(PIPELINE_BATCH_RECORDS);
+            }
+            for (uint32_t t = 1; t < threads; ++t) {
+                workers.emplace_back(&MultiCoreHierarchy::work, this);
+            }
+        }
+    }
+
+    ~MultiCoreHierarchy() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping.store(true);
+        }
+        roundStarted.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        for (auto l1 : l1Caches) {
+            delete l1;
+        }
+        delete l2Cache;
+    }
+
+    MultiCoreHierarchy(const MultiCoreHierarchy&) = delete;
+    MultiCoreHierarchy& operator=(const MultiCoreHierarchy&) = delete;
+
+    const cache_params_t& getParams() const {
+        return params;
+    }
+
+    bool hasCache() const {
+        return true;
+    }
+
+    // Issue one request to the L1 of core 0
+    void access(char rw, uint32_t addr) {
+        requestCount++;
+        debugTraceRequest(addr, "%" PRIu64 "=%c %x\n", requestCount, rw, addr);
+        this->issue(rw, addr, 0);
+        this->runAllPending();
+    }
+
+    void run(const TraceRecord* records, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            requestCount++;
+            if (records[i].core >= coreCount) {
+                printf("Error: Request %" PRIu64 " comes from core %u but only %u cores are simulated.\n", requestCount, records[i].core, coreCount);
+                exit(EXIT_FAILURE);
+            }
+            debugTraceRequest(records[i].addr, "%" PRIu64 "=%u %c %x\n", requestCount, records[i].core, records[i].rw, records[i].addr);
+            this->issue(records[i].rw, records[i].addr, records[i].core);
+        }
+        this->runAllPending();
+    }
+
+    uint64_t getMemTraffic() {
+        uint64_t value = (l2Cache != nullptr) ? l2Cache->getMemTraffic() : 0;
+        for (auto l1 : l1Caches) {
+            value += l1->getMemTraffic();
+        }
+        return value;
+    }
+
+    // The L1 results add up the L1s of all cores
+    sim_results_t getResults() {
+        sim_results_t results;
+        memset(&results, 0, sizeof(results));
+        results.params = params;
+        level_results_t& L1 = results.L1;
+        for (auto l1 : l1Caches) {
+            L1.reads += l1->getReads();
+            L1.readMisses += l1->getReadMisses();
+            L1.writes += l1->getWrites();
+            L1.writeMisses += l1->getWriteMisses();
+            L1.writebacks += l1->getWritebacks();
+        }
+        if (L1.reads + L1.writes != 0) {
+            L1.missRate = double(L1.readMisses + L1.writeMisses) / double(L1.reads + L1.writes);
+        }
+        if (l2Cache != nullptr) {
+            level_results_t& L2 = results.L2;
+            L2.reads = l2Cache->getReads();
+            L2.readMisses = l2Cache->getReadMisses();
+            L2.writes = l2Cache->getWrites();
+            L2.writeMisses = l2Cache->getWriteMisses();
+            L2.missRate = l2Cache->getMissRate();
+            L2.writebacks = l2Cache->getWritebacks();
+            L2.prefetches = l2Cache->getPrefetches();
+            L2.readsPrefetch = l2Cache->getReadPrefetches();
+            L2.readMissesPrefetch = l2Cache->getReadMissPrefetches();
+        }
+        results.memTraffic = this->getMemTraffic();
+        return results;
+    }
+
+    void printContents() {
+        for (uint32_t core = 0; core < coreCount; ++core) {
+            char name[32];
+            snprintf(name, sizeof(name), "L1 (core %u)", core);
+            l1Caches[core]->printContents(name);
+            printf("\n");
+        }
+        if (l2Cache != nullptr) {
+            l2Cache->printContents();
+            printf("\n");
+            if (params.PREF_N > 0) {
+                l2Cache->printStreamBufferContents();
+                printf("\n");
+            }
+        }
+    }
+
+    void printCoherence() {
+        coherence_counters_t total;
+        memset(&total, 0, sizeof(total));
+        for (auto& core : counters) {
+            total.busReads += core.busReads;
+            total.busReadExclusives += core.busReadExclusives;
+            total.upgrades += core.upgrades;
+            total.invalidations += core.invalidations;
+            total.interventions += core.interventions;
+            total.flushes += core.flushes;
+        }
+        printf("===== Coherence =====\n");
+        printf("cores:                        %u\n", coreCount);
+        printf("bus reads (BusRd):            %" PRIu64 "\n", total.busReads);
+        printf("bus read-exclusives (BusRdX): %" PRIu64 "\n", total.busReadExclusives);
+        printf("bus upgrades (BusUpgr):       %" PRIu64 "\n", total.upgrades);
+        printf("invalidations:                %" PRIu64 "\n", total.invalidations);
+        printf("interventions:                %" PRIu64 "\n", total.interventions);
+        printf("flushes:                      %" PRIu64 "\n", total.flushes);
+        printf("\n");
+        printf("===== Per-core L1 measurements =====\n");
+        printf("core      reads  read misses     writes write misses  miss rate writebacks  invalidated intervened  flushed\n");
+        for (uint32_t core = 0; core < coreCount; ++core) {
+            Cache<Policy>* l1 = l1Caches[core];
+            printf("%4u %10" PRIu64 " %12" PRIu64 " %10" PRIu64 " %12" PRIu64 " %10.4f %10" PRIu64 " %12" PRIu64 " %10" PRIu64 " %8" PRIu64 "\n", core, l1->getReads(), l1->getReadMisses(),
+                   l1->getWrites(), l1->getWriteMisses(), l1->getMissRate(), l1->getWritebacks(),
+                   counters[core].invalidations, counters[core].interventions, counters[core].flushes);
+        }
+    }
+
+    void enableSampling(double ratio, uint32_t selection, uint32_t seed) {
+        printf("Error: Set sampling does not support multi-core simulation.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    void printSampledEstimates() {
+    }
+
+    void enableMissClassification() {
+        printf("Error: Miss classification does not support multi-core simulation.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    void printMissClassification(FILE* perSetOut) {
+    }
+
+    // Victim and miss caches are not snooped
+    void addAssistCache(uint32_t level, uint32_t kind, uint32_t entries) {
+        printf("Error: Victim and miss caches do not support multi-core simulation.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    void printAssistCaches() {
+    }
+
+    // The private L1s and the shared L2 are non-inclusive; back-invalidations would have to go through the protocol
+    void setInclusionPolicy(uint32_t inclusion) {
+        printf("Error: Inclusive and exclusive L2s do not support multi-core simulation.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    void printInclusion() {
+    }
+
+    // MESI assumes write-back L1s; a write-through or write-around, buffered or not, would bypass the protocol
+    void setWritePolicy(uint32_t level, uint32_t policy) {
+        printf("Error: Write policies other than wbwa do not support multi-core simulation.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    void addWriteBuffer(uint32_t level, uint32_t entries, uint32_t interval) {
+        printf("Error: Write buffers do not support multi-core simulation.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    void drainWriteBuffers() {
+    }
+
+    void printWritePolicies() {
+    }
+
+    // Prefetches into a private L1 would need the protocol as much as a demand read does
+    void addPrefetcher(uint32_t level, uint32_t kind, uint32_t degree, uint32_t latency) {
+        printf("Error: Prefetchers do not support multi-core simulation; only the stream buffers of PREF_N and PREF_M do.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    void setStreamBufferLatency(uint32_t latency) {
+        if (l2Cache != nullptr) {
+            l2Cache->setStreamBufferLatency(latency);
+        }
+    }
+
+    void printPrefetchers() {
+    }
+
+    void enableTiming(const uint32_t hitLatency[2], uint32_t memoryLatency, const uint32_t mshrs[2], const dram_params_t* dram) {
+        printf("Error: The timing model does not support multi-core simulation.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    void printTiming() {
+    }
+
+    void printDram() {
+    }
+
+    // The counters go first, so a snapshot of a different number of cores is rejected
+    void save(SnapshotWriter& out) const {
+        out.put(requestCount);
+        out.putVector(counters);
+        for (uint32_t core = 0; core < coreCount; ++core) {
+            l1Caches[core]->save(out);
+            out.putVector(shared[core]);
+        }
+        if (l2Cache != nullptr) {
+            l2Cache->save(out);
+        }
+    }
+
+    void restore(SnapshotReader& in) {
+        in.get(&requestCount);
+        in.getVector(&counters);
+        for (uint32_t core = 0; core < coreCount; ++core) {
+            l1Caches[core]->restore(in);
+            in.getVector(&shared[core]);
+        }
+        if (l2Cache != nullptr) {
+            l2Cache->restore(in);
+        }
+    }
+};
+
+CacheHierarchy* CacheHierarchy::createMultiCore(const cache_params_t& params, uint32_t cores, uint32_t threads) {
+    switch (params.REPL_POLICY) {
+        case REPL_LRU:
+            return new MultiCoreHierarchy<LRUPolicy>(params, cores, threads);
+        case REPL_PLRU:
+            return new MultiCoreHierarchy<PLRUPolicy>(params, cores, threads);
+        case REPL_NRU:
+            return new MultiCoreHierarchy<NRUPolicy>(params, cores, threads);
+        case REPL_SRRIP:
+            return new MultiCoreHierarchy<SRRIPPolicy>(params, cores, threads);
+        case REPL_BRRIP:
+            return new MultiCoreHierarchy<BRRIPPolicy>(params, cores, threads);
+        case REPL_RANDOM:
+            return new MultiCoreHierarchy<RandomPolicy>(params, cores, threads);
+        case REPL_FIFO:
+            return new MultiCoreHierarchy<FIFOPolicy>(params, cores, threads);
+    }
+    printf("Error: Unknown replacement policy %u.\n", params.REPL_POLICY);
+    exit(EXIT_FAILURE);
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <cstdarg> // Include the cstdarg header for variable argument handling
+
+// Enable/disable debug prints using DEBUG macro
+// Build with "make DEBUG=1" to compile the trace points in
+#ifndef DEBUG
+# define DEBUG 0
+#endif
+
+// Highest level that has trace points: 0 is the requests of the trace, 1 and 2 the cache levels
+#define DEBUG_MAX_LEVEL 2
+
+// Selects which trace points print when tracing is compiled in
+// By default everything matches; each range is inclusive
+class DebugFilter {
+private:
+    uint32_t levelMask; // bit l set => trace points of cache level l print; bit 0 is the trace file requests
+    uint32_t setLo, setHi; // range of set indices to trace
+    uint32_t addrLo, addrHi; // range of addresses to trace
+
+public:
+    DebugFilter() : levelMask(0xFFFFFFFFu), setLo(0), setHi(0xFFFFFFFFu), addrLo(0), addrHi(0xFFFFFFFFu) {
+    }
+
+    // Restrict tracing to the given level, at most DEBUG_MAX_LEVEL; can be
+    // called once per level to trace several. Returns false for any other level.
+    bool addLevel(uint32_t level) {
+        if (level > DEBUG_MAX_LEVEL) {
+            return false;
+        }
+        if (levelMask == 0xFFFFFFFFu) {
+            levelMask = 0;
+        }
+        levelMask |= (1u << level);
+        return true;
+    }
+
+    void setSetRange(uint32_t lo, uint32_t hi) {
+        setLo = lo;
+        setHi = hi;
+    }
+
+    void setAddrRange(uint32_t lo, uint32_t hi) {
+        addrLo = lo;
+        addrHi = hi;
+    }
+
+    // Check an address against the address range only
+    bool matchesAddr(uint32_t addr) const {
+        return addr >= addrLo && addr <= addrHi;
+    }
+
+    // Check a request read from the trace file; these belong to no set
+    bool matchesRequest(uint32_t addr) const {
+        return (levelMask & 1u) && this->matchesAddr(addr);
+    }
+
+    // Check a trace point of a cache level touching the given set and address
+    bool matches(uint32_t level, uint32_t set, uint32_t addr) const {
+        return ((levelMask >> level) & 1u) && set >= setLo && set <= setHi && this->matchesAddr(addr);
+    }
+};
+
+// Buffered destination for trace output
+// Lines are formatted straight into a fixed buffer which is written out when full
+class DebugSink {
+private:
+    static const size_t BUFFER_SIZE = 1 << 16;
+    char buffer[BUFFER_SIZE];
+    size_t used;
+    FILE* out;
+
+public:
+    DebugSink() : used(0), out(stdout) {
+    }
+
+    ~DebugSink() {
+        this->close();
+    }
+
+    // Redirect trace output to a file instead of stdout
+    bool open(const char* path) {
+        FILE* fp = fopen(path, "w");
+        if (fp == (FILE *) NULL) {
+            return false;
+        }
+        this->close();
+        out = fp;
+        return true;
+    }
+
+    void print(const char* format, ...) {
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer + used, BUFFER_SIZE - used, format, args);
+        va_end(args);
+        if (length < 0) {
+            return;
+        }
+        if (used + length >= BUFFER_SIZE) {
+            // Did not fit; drain the buffer and format again into the empty buffer
+            this->flush();
+            va_start(args, format);
+            length = vsnprintf(buffer, BUFFER_SIZE, format, args);
+            va_end(args);
+            if (size_t(length) >= BUFFER_SIZE) {
+                // Longer than the whole buffer; keep what fitted
+                length = BUFFER_SIZE - 1;
+            }
+        }
+        used += length;
+    }
+
+    void flush() {
+        if (used != 0) {
+            fwrite(buffer, 1, used, out);
+            used = 0;
+        }
+        fflush(out);
+    }
+
+    void close() {
+        this->flush();
+        if (out != stdout) {
+            fclose(out);
+            out = stdout;
+        }
+    }
+};
+
+DebugFilter debugFilter;
+DebugSink debugSink;
+
+// Trace points
+// With DEBUG off these expand to nothing, so their arguments (set dumps,
+// tab strings etc.) are never evaluated
+#if DEBUG
+// Trace point inside a cache level
+# define debugTrace(level, set, addr, ...) \
+    do { if (debugFilter.matches((level), (set), (addr))) { debugSink.print(__VA_ARGS__); } } while (0)
+// Trace point for a request read from the trace file
+# define debugTraceRequest(addr, ...) \
+    do { if (debugFilter.matchesRequest(addr)) { debugSink.print(__VA_ARGS__); } } while (0)
+#else
+# define debugTrace(level, set, addr, ...) do { } while (0)
+# define debugTraceRequest(addr, ...) do { } while (0)
+#endif
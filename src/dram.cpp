@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+
+// DRAM back end: a memory controller with channels, banks and row buffers
+//
+// With --dram the timing model (timing.cpp) takes the latency of a last-level
+// miss from this model instead of a fixed memory latency. Every block the last
+// level reads or writes is logged while the levels serve a request (see
+// MemoryLog) and handed to the controller as a request stamped with its cycle:
+// the demand read of a miss when the miss reaches memory, writebacks, writes
+// passed through or around and prefetches when the core issues the request
+// that caused them. Only demand reads hold up a request; the others queue.
+//
+// Block numbers map to the controller low bits first: the column within a
+// row, then the channel, then the bank, then the row, so a stream of blocks
+// fills a row before it moves on. Each channel has a request queue of
+// `queueEntries` and a data bus; each bank keeps its last row open:
+//    row hit       the row is open                   tCAS
+//    row miss      the bank has no row open          tRCD + tCAS
+//    row conflict  another row is open               tRP + tRCD + tCAS
+// after which the block takes `burst` cycles on the channel's data bus, so a
+// channel moves at most BLOCKSIZE / burst bytes per cycle. The controller
+// picks the next request of a channel when its bus is about to free:
+//    fcfs    the oldest request that has arrived
+//    frfcfs  the oldest that hits an open row, else the oldest (first-ready,
+//            first-come first-served)
+// A request is only reordered against those that arrived before it was
+// served: a demand read is served as soon as the timing model needs its
+// completion cycle. A request that finds the queue full waits until the
+// controller has served one. The queueing delay of a request is its time in
+// the controller beyond its own row and bus time.
+
+enum DramScheduler {DRAM_FCFS=0, DRAM_FRFCFS, DRAM_SCHEDULER_COUNT};
+
+static const char* const dramSchedulerNames[DRAM_SCHEDULER_COUNT] = {"fcfs", "frfcfs"};
+
+// Kinds of DRAM requests
+enum DramRequestKind {DRAM_READ=0, DRAM_PREFETCH, DRAM_WRITE, DRAM_REQUEST_KIND_COUNT};
+
+#define DRAM_MAX_CHANNELS 16
+#define DRAM_MAX_BANKS 64
+#define DRAM_MAX_QUEUE 1024
+#define DRAM_MAX_CYCLES 10000
+// Defaults: a DDR4-2400 channel with 17-17-17 timings behind a 3 GHz core
+#define DRAM_CHANNELS 1
+#define DRAM_BANKS 16
+#define DRAM_ROW_BYTES 8192
+#define DRAM_TCAS 42
+#define DRAM_TRCD 42
+#define DRAM_TRP 42
+#define DRAM_BANDWIDTH 6.4 // bytes per cycle per channel
+#define DRAM_QUEUE_ENTRIES 32
+
+#define DRAM_NO_ROW 0xFFFFFFFFu
+
+// Blocks the last level read from or wrote to main memory while serving one request
+class MemoryLog {
+public:
+    std::vector<uint32_t> blocks; // block numbers (tag and index)
+    std::vector<uint8_t> writes; // 1 if the block was written
+
+    // capacity: the most blocks one request can log, so that logging never allocates
+    MemoryLog(size_t capacity) {
+        blocks.reserve(capacity);
+        writes.reserve(capacity);
+    }
+
+    // Kept out of line so the miss paths of the levels stay small when nothing is logged
+    __attribute__((noinline)) void add(uint32_t block, bool write) {
+        blocks.push_back(block);
+        writes.push_back(write ? 1 : 0);
+    }
+
+    void clear() {
+        blocks.clear();
+        writes.clear();
+    }
+};
+
+// Counters of one kind of DRAM request
+typedef
+struct {
+   uint64_t requests;
+   uint64_t rowHits;
+   uint64_t rowMisses;
+   uint64_t rowConflicts;
+   uint64_t latency;	// cycles from arrival to the last byte on the bus, added up
+   uint64_t queueing;	// ...of which the cycles spent waiting behind other requests
+} dram_counters_t;
+
+// One request waiting in a channel queue
+typedef
+struct {
+   uint64_t arrival;	// cycle it reached the controller
+   uint64_t id;		// order of arrival, to break ties
+   uint32_t bank;
+   uint32_t row;
+   uint32_t kind;	// a DramRequestKind
+   uint32_t padding;
+} dram_request_t;
+
+class DramController {
+private:
+    dram_params_t params;
+    uint32_t burst; // cycles a block takes on a data bus
+    uint32_t blocksPerRow;
+    std::vector<dram_request_t> queues; // queueEntries per channel
+    std::vector<uint32_t> queued; // requests waiting in each channel's queue
+    std::vector<uint64_t> busFree; // cycle each channel's data bus frees
+    std::vector<uint32_t> openRows; // row open in each bank of each channel, or DRAM_NO_ROW
+    std::vector<uint64_t> bankReady; // cycle each bank can take its next command
+    uint64_t nextId;
+    uint64_t lastCompletion; // cycle the last block left a data bus
+
+    // Serves the next request of channel; returns the cycle its block has
+    // crossed the bus, and sets *id to the request served and *decision to
+    // the cycle it was picked
+    uint64_t serve(uint32_t channel, uint64_t* id, uint64_t* decision) {
+        dram_request_t* queue = &queues[size_t(channel) * params.queueEntries];
+        uint32_t count = queued[channel];
+        uint64_t earliest = queue[0].arrival;
+        for (uint32_t i = 1; i < count; ++i) {
+            earliest = (queue[i].arrival < earliest) ? queue[i].arrival : earliest;
+        }
+        // The next request is picked when the bus is about to free, in time for a row hit
+        uint64_t now = (busFree[channel] > params.tCAS) ? busFree[channel] - params.tCAS : 0;
+        now = (earliest > now) ? earliest : now;
+        uint32_t* rows = &openRows[size_t(channel) * params.banks];
+        uint32_t pick = count;
+        bool pickHits = false;
+        for (uint32_t i = 0; i < count; ++i) {
+            if (queue[i].arrival > now) {
+                continue;
+            }
+            bool hits = params.scheduler == DRAM_FRFCFS && rows[queue[i].bank] == queue[i].row;
+            if (pick == count || (hits && !pickHits) || (hits == pickHits && queue[i].id < queue[pick].id)) {
+                pick = i;
+                pickHits = hits;
+            }
+        }
+        dram_request_t request = queue[pick];
+        queue[pick] = queue[count - 1];
+        queued[channel] = count - 1;
+
+        uint64_t& ready = bankReady[size_t(channel) * params.banks + request.bank];
+        uint64_t start = (ready > now) ? ready : now;
+        uint32_t prepare;
+        dram_counters_t& c = counters[request.kind];
+        if (rows[request.bank] == request.row) {
+            prepare = 0;
+            c.rowHits++;
+        }
+        else if (rows[request.bank] == DRAM_NO_ROW) {
+            prepare = params.tRCD;
+            c.rowMisses++;
+        }
+        else {
+            prepare = params.tRP + params.tRCD;
+            c.rowConflicts++;
+        }
+        rows[request.bank] = request.row;
+        uint64_t dataStart = start + prepare + params.tCAS;
+        dataStart = (busFree[channel] > dataStart) ? busFree[channel] : dataStart;
+        uint64_t completion = dataStart + burst;
+        busFree[channel] = completion;
+        // Column commands to the open row follow one another a burst apart
+        ready = start + prepare + burst;
+        c.requests++;
+        c.latency += completion - request.arrival;
+        c.queueing += completion - request.arrival - (prepare + params.tCAS + burst);
+        lastCompletion = (completion > lastCompletion) ? completion : lastCompletion;
+        *id = request.id;
+        *decision = now;
+        return completion;
+    }
+
+    // Queues a request for block arriving at cycle at; returns its id and sets *channel
+    uint64_t enqueue(uint32_t block, uint32_t kind, uint64_t at, uint32_t* channel) {
+        uint32_t rest = block / blocksPerRow;
+        *channel = rest % params.channels;
+        rest /= params.channels;
+        if (queued[*channel] == params.queueEntries) {
+            uint64_t id, decision;
+            this->serve(*channel, &id, &decision);
+            fullStalls++;
+            at = (decision > at) ? decision : at;
+        }
+        dram_request_t& request = queues[size_t(*channel) * params.queueEntries + queued[*channel]++];
+        request.arrival = at;
+        request.id = nextId++;
+        request.bank = rest % params.banks;
+        request.row = rest / params.banks;
+        request.kind = kind;
+        request.padding = 0;
+        return request.id;
+    }
+
+public:
+    dram_counters_t counters[DRAM_REQUEST_KIND_COUNT];
+    uint64_t fullStalls; // requests that found their channel's queue full
+
+    DramController(const dram_params_t& dram, uint32_t blockSize)
+        : params(dram), queues(size_t(dram.channels) * dram.queueEntries), queued(dram.channels, 0), busFree(dram.channels, 0),
+          openRows(size_t(dram.channels) * dram.banks, DRAM_NO_ROW), bankReady(size_t(dram.channels) * dram.banks, 0),
+          nextId(0), lastCompletion(0), fullStalls(0) {
+        burst = uint32_t(ceil(double(blockSize) / dram.bandwidth));
+        burst = (burst == 0) ? 1 : burst;
+        blocksPerRow = (dram.rowBytes > blockSize) ? dram.rowBytes / blockSize : 1;
+        memset(&queues[0], 0, queues.size() * sizeof(dram_request_t));
+        memset(counters, 0, sizeof(counters));
+    }
+
+    const dram_params_t& getParams() const {
+        return params;
+    }
+
+    uint32_t getBurst() const {
+        return burst;
+    }
+
+    // Reads block for a miss reaching memory at cycle at; returns the cycle the block has arrived
+    uint64_t read(uint32_t block, uint64_t at) {
+        uint32_t channel;
+        uint64_t wanted = this->enqueue(block, DRAM_READ, at, &channel);
+        while (true) {
+            uint64_t id, decision;
+            uint64_t completion = this->serve(channel, &id, &decision);
+            if (id == wanted) {
+                return completion;
+            }
+        }
+    }
+
+    // Queues a request the core does not wait for: a write or a prefetch, or a read it merged elsewhere
+    void submit(uint32_t block, uint32_t kind, uint64_t at) {
+        uint32_t channel;
+        this->enqueue(block, kind, at, &channel);
+    }
+
+    // Serves every request still queued
+    void drain() {
+        for (uint32_t channel = 0; channel < params.channels; ++channel) {
+            while (queued[channel] != 0) {
+                uint64_t id, decision;
+                this->serve(channel, &id, &decision);
+            }
+        }
+    }
+
+    // Cycle the last block served left a data bus
+    uint64_t getLastCompletion() const {
+        return lastCompletion;
+    }
+
+    // Bytes per cycle all channels can move at most
+    double getPeakBandwidth(uint32_t blockSize) const {
+        return double(params.channels) * blockSize / burst;
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.put(params);
+        out.putVector(queues);
+        out.putVector(queued);
+        out.putVector(busFree);
+        out.putVector(openRows);
+        out.putVector(bankReady);
+        out.put(nextId);
+        out.put(lastCompletion);
+        out.put(counters);
+        out.put(fullStalls);
+    }
+
+    void restore(SnapshotReader& in) {
+        dram_params_t saved;
+        in.get(&saved);
+        if (memcmp(&saved, &params, sizeof(params)) != 0) {
+            printf("Error: Snapshot was taken with a different DRAM configuration.\n");
+            exit(EXIT_FAILURE);
+        }
+        in.getVector(&queues);
+        in.getVector(&queued);
+        in.getVector(&busFree);
+        in.getVector(&openRows);
+        in.getVector(&bankReady);
+        in.get(&nextId);
+        in.get(&lastCompletion);
+        in.get(&counters);
+        in.get(&fullStalls);
+        for (uint32_t channel = 0; channel < params.channels; ++channel) {
+            if (queued[channel] > params.queueEntries) {
+                SnapshotReader::corrupt();
+            }
+        }
+    }
+};
+
+// Looks up a DRAM scheduler by name; returns false if there is no such scheduler
+static bool parseDramScheduler(const char* name, uint32_t* scheduler) {
+    for (uint32_t i = 0; i < DRAM_SCHEDULER_COUNT; ++i) {
+        if (strcmp(name, dramSchedulerNames[i]) == 0) {
+            *scheduler = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses count values separated by ':' into values, each from 1 to max; returns false on anything else
+static bool parseColonValues(const char* text, uint32_t count, uint32_t max, uint32_t* values) {
+    for (uint32_t i = 0; i < count; ++i) {
+        char* end;
+        unsigned long value = strtoul(text, &end, 10);
+        if (end == text || value == 0 || value > max || *end != ((i + 1 == count) ? '\0' : ':')) {
+            return false;
+        }
+        values[i] = uint32_t(value);
+        text = end + 1;
+    }
+    return true;
+}
@@ -0,0 +1,1032 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+// Requests packed and digested at a time by TraceDigest
+#define TRACE_DIGEST_RECORDS 512
+
+// Digest of the requests of a trace, kept in snapshots: XXH64 of every
+// request's address, type and core, so a trace digests the same in every
+// trace format
+class TraceDigest {
+private:
+    Xxh64 hash;
+
+public:
+    void add(const TraceRecord* records, size_t count) {
+        uint8_t bytes[TRACE_DIGEST_RECORDS * 8];
+        while (count != 0) {
+            size_t chunk = (count < TRACE_DIGEST_RECORDS) ? count : TRACE_DIGEST_RECORDS;
+            memset(bytes, 0, chunk * 8);
+            for (size_t i = 0; i < chunk; ++i) {
+                memcpy(&bytes[i * 8], &records[i].addr, sizeof(records[i].addr));
+                bytes[i * 8 + 4] = uint8_t(records[i].rw);
+                bytes[i * 8 + 5] = records[i].core;
+            }
+            hash.update(bytes, chunk * 8);
+            records += chunk;
+            count -= chunk;
+        }
+    }
+
+    uint64_t get() const {
+        return hash.digest();
+    }
+};
+
+// One complete cache hierarchy built from a set of simulator parameters:
+// an optional L1, an optional L2 behind it and the stream buffers attached
+// to the last level. Every hierarchy owns all of its state, so several can
+// be simulated side by side.
+//
+// The caches are instantiated for the replacement policy in the parameters.
+// CacheHierarchy::create() picks that instantiation once; callers then hand
+// it requests a batch at a time through run(), so the only virtual call is
+// per batch and the access path itself is fully specialised.
+class CacheHierarchy {
+public:
+    // Builds the hierarchy described by params; exits if the replacement policy is unknown
+    static CacheHierarchy* create(const cache_params_t& params);
+
+    // Builds cores private L1s sharing one L2, kept coherent with MESI (see
+    // coherence.cpp); the core-local work is spread over threads threads
+    static CacheHierarchy* createMultiCore(const cache_params_t& params, uint32_t cores, uint32_t threads);
+
+    virtual ~CacheHierarchy() {
+    }
+
+    virtual const cache_params_t& getParams() const = 0;
+
+    // Returns true if there is a cache to issue requests to
+    virtual bool hasCache() const = 0;
+
+    // Issue one request from the trace to the L1 cache
+    virtual void access(char rw, uint32_t addr) = 0;
+
+    // Issue a batch of requests from the trace to the L1 cache, in order
+    virtual void run(const TraceRecord* records, size_t count) = 0;
+
+    // Blocks transferred to and from main memory by all levels
+    virtual uint64_t getMemTraffic() = 0;
+
+    virtual sim_results_t getResults() = 0;
+
+    // Print the contents of every level and of the stream buffers
+    virtual void printContents() = 0;
+
+    // Print the coherence counters of a multi-core hierarchy; nothing for a single core
+    virtual void printCoherence() = 0;
+
+    // Simulate only a fraction ratio of the sets (see sampling.cpp); must be
+    // called before any request is issued. Exits if the hierarchy cannot be sampled.
+    virtual void enableSampling(double ratio, uint32_t selection, uint32_t seed) = 0;
+
+    // Print the estimates of a sampled simulation
+    virtual void printSampledEstimates() = 0;
+
+    // Classify the misses of every level as compulsory, capacity or conflict;
+    // must be called before any request is issued
+    virtual void enableMissClassification() = 0;
+
+    // Print the miss classification of every level, and its breakdown per
+    // set as CSV to perSetOut unless that is nullptr
+    virtual void printMissClassification(FILE* perSetOut) = 0;
+
+    // Add a victim or miss cache (an AssistCacheKind, see assist.cpp) of
+    // entries entries to level 1 or 2; must be called before any request is
+    // issued. Exits if the level does not exist.
+    virtual void addAssistCache(uint32_t level, uint32_t kind, uint32_t entries) = 0;
+
+    // Print the counters of the victim and miss caches
+    virtual void printAssistCaches() = 0;
+
+    // Make L2 inclusive or exclusive of L1 (an InclusionPolicy, see cache.cpp);
+    // must be called before any request is issued. Without an L2 there is nothing to do.
+    virtual void setInclusionPolicy(uint32_t inclusion) = 0;
+
+    // Print the back-invalidations and the blocks held by both levels
+    virtual void printInclusion() = 0;
+
+    // Set the write policy (a WritePolicy, see writebuf.cpp) of level 1 or 2;
+    // must be called before any request is issued. Without the level there is nothing to do.
+    virtual void setWritePolicy(uint32_t level, uint32_t policy) = 0;
+
+    // Buffer the writes level 1 or 2 passes on in a write buffer of entries
+    // entries that drains one every interval requests; must be called before
+    // any request is issued. Exits if the level does not exist.
+    virtual void addWriteBuffer(uint32_t level, uint32_t entries, uint32_t interval) = 0;
+
+    // Drain every write the write buffers still hold, at the end of the trace
+    virtual void drainWriteBuffers() = 0;
+
+    // Print the write policies, the writes passed on and the write buffer counters
+    virtual void printWritePolicies() = 0;
+
+    // Add a prefetcher of kind (a PrefetcherKind, see prefetch.cpp) asking for up
+    // to degree blocks at a time to level 1 or 2; its prefetches arrive latency
+    // requests after they are issued. Must be called before any request is issued.
+    // Exits if the level does not exist or already prefetches into stream buffers.
+    virtual void addPrefetcher(uint32_t level, uint32_t kind, uint32_t degree, uint32_t latency) = 0;
+
+    // Make the prefetches of the stream buffers (PREF_N and PREF_M) arrive
+    // latency requests after they are issued, for the late prefetches they count
+    virtual void setStreamBufferLatency(uint32_t latency) = 0;
+
+    // Print the counters of the prefetchers and stream buffers, with their accuracy and coverage
+    virtual void printPrefetchers() = 0;
+
+    // Time every request with the hit latencies of L1 and L2, MSHRs at both
+    // levels and the memory latency (see timing.cpp); a hit latency of 0 is
+    // derived from the level's size and associativity. With dram, memory is
+    // timed by a DRAM controller (see dram.cpp) instead of the memory latency.
+    // Must be called before any request is issued. Exits if the hierarchy cannot be timed.
+    virtual void enableTiming(const uint32_t hitLatency[2], uint32_t memoryLatency, const uint32_t mshrs[2], const dram_params_t* dram) = 0;
+
+    // Print the latencies, the MSHR counters and occupancy and the average memory access time
+    virtual void printTiming() = 0;
+
+    // Print the requests, row-buffer hits, latencies and bandwidth of the DRAM controller
+    virtual void printDram() = 0;
+
+    // Add the victim and miss caches, the inclusion and write policies, the write buffers, the prefetchers and the timing model the command line asks for
+    void configure(const sim_options_t& options) {
+        for (uint32_t level = 1; level <= 2; ++level) {
+            if (options.assistKind[level - 1] != ASSIST_NONE) {
+                this->addAssistCache(level, options.assistKind[level - 1], options.assistEntries[level - 1]);
+            }
+            if (options.writePolicy[level - 1] != WRITE_WBWA) {
+                this->setWritePolicy(level, options.writePolicy[level - 1]);
+            }
+            if (options.writeBufferEntries[level - 1] != 0) {
+                this->addWriteBuffer(level, options.writeBufferEntries[level - 1], options.writeBufferDrain);
+            }
+            if (options.prefetcherKind[level - 1] != PREFETCH_NONE) {
+                this->addPrefetcher(level, options.prefetcherKind[level - 1], options.prefetcherDegree[level - 1], options.prefetchLatency);
+            }
+        }
+        this->setStreamBufferLatency(options.prefetchLatency);
+        if (options.inclusion != INCLUSION_NINE) {
+            this->setInclusionPolicy(options.inclusion);
+        }
+        if (options.timing) {
+            this->enableTiming(options.hitLatency, options.memoryLatency, options.mshrs, options.dram ? &options.dramParams : nullptr);
+        }
+    }
+
+    // Write the state of every level to a snapshot section
+    virtual void save(SnapshotWriter& out) const = 0;
+
+    // Read back a state written by save() of a hierarchy with the same parameters
+    virtual void restore(SnapshotReader& in) = 0;
+
+    // Writes the state of hierarchies after the first records requests of the
+    // trace, whose digest is traceDigest, to a snapshot file (see snapshot.cpp);
+    // exits if it cannot be written
+    static void saveSnapshot(const char* path, const std::vector<CacheHierarchy*>& hierarchies, uint64_t records, uint64_t traceDigest);
+
+    // Restores the hierarchy at index of a snapshot into hierarchy, which
+    // must have been built with the same parameters; exits if it was not
+    static void restoreSnapshot(const Snapshot& snapshot, uint32_t index, CacheHierarchy* hierarchy);
+
+    // Restores hierarchies from a snapshot taken of the same configurations in
+    // the same order and moves the trace past the requests it covers (see
+    // skipRestoredRequests); returns the number of those requests
+    static uint64_t restoreSnapshot(const char* path, const std::vector<CacheHierarchy*>& hierarchies, TraceReader& trace, TraceDigest* digest);
+
+    // Maps a snapshot that should hold hierarchyCount hierarchies; exits if it cannot or does not
+    static void openSnapshot(const char* path, size_t hierarchyCount, Snapshot* snapshot);
+
+    // Moves the trace past the requests a restored snapshot already covers and
+    // adds them to digest; exits if the trace is too short or does not start
+    // with the requests the snapshot was taken after
+    static void skipRestoredRequests(TraceReader& trace, const Snapshot& snapshot, TraceDigest* digest);
+
+    // Print the measurements block of a simulation
+    static void printMeasurements(const sim_results_t& results) {
+        const level_results_t& L1 = results.L1;
+        const level_results_t& L2 = results.L2;
+        printf("===== Measurements =====\n");
+        printf("a. L1 reads:                   %" PRIu64 "\n", L1.reads);
+        printf("b. L1 read misses:             %" PRIu64 "\n", L1.readMisses);
+        printf("c. L1 writes:                  %" PRIu64 "\n", L1.writes);
+        printf("d. L1 write misses:            %" PRIu64 "\n", L1.writeMisses);
+        printf("e. L1 miss rate:               %.4f\n", L1.missRate);
+        printf("f. L1 writebacks:              %" PRIu64 "\n", L1.writebacks);
+        printf("g. L1 prefetches:              %" PRIu64 "\n", L1.prefetches);
+        printf("h. L2 reads (demand):          %" PRIu64 "\n", L2.reads);
+        printf("i. L2 read misses (demand):    %" PRIu64 "\n", L2.readMisses);
+        printf("j. L2 reads (prefetch):        %" PRIu64 "\n", L2.readsPrefetch);
+        printf("k. L2 read misses (prefetch):  %" PRIu64 "\n", L2.readMissesPrefetch);
+        printf("l. L2 writes:                  %" PRIu64 "\n", L2.writes);
+        printf("m. L2 write misses:            %" PRIu64 "\n", L2.writeMisses);
+        printf("n. L2 miss rate:               %.4f\n", L2.missRate);
+        printf("o. L2 writebacks:              %" PRIu64 "\n", L2.writebacks);
+        printf("p. L2 prefetches:              %" PRIu64 "\n", L2.prefetches);
+        printf("q. memory traffic:             %" PRIu64 "\n", results.memTraffic);
+    }
+
+    // Structured output: one CSV row per simulated configuration, with the timing columns if timed
+    static void printResultHeader(FILE* out, bool timed) {
+        fprintf(out, "BLOCKSIZE,L1_SIZE,L1_ASSOC,L2_SIZE,L2_ASSOC,PREF_N,PREF_M,REPL_POLICY,"
+                     "L1_reads,L1_read_misses,L1_writes,L1_write_misses,L1_miss_rate,L1_writebacks,L1_prefetches,"
+                     "L2_reads,L2_read_misses,L2_reads_prefetch,L2_read_misses_prefetch,L2_writes,L2_write_misses,L2_miss_rate,L2_writebacks,L2_prefetches,"
+                     "memory_traffic%s\n", timed ? ",L1_hit_latency,L2_hit_latency,cycles,stall_cycles,amat" : "");
+    }
+
+    static void printResultRow(FILE* out, const sim_results_t& results, bool timed) {
+        const cache_params_t& p = results.params;
+        const level_results_t& L1 = results.L1;
+        const level_results_t& L2 = results.L2;
+        fprintf(out, "%u,%u,%u,%u,%u,%u,%u,%s,", p.BLOCKSIZE, p.L1_SIZE, p.L1_ASSOC, p.L2_SIZE, p.L2_ASSOC, p.PREF_N, p.PREF_M,
+                getReplacementPolicyName(p.REPL_POLICY));
+        fprintf(out, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.4f,%" PRIu64 ",%" PRIu64 ",", L1.reads, L1.readMisses, L1.writes, L1.writeMisses, L1.missRate, L1.writebacks, L1.prefetches);
+        fprintf(out, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.4f,%" PRIu64 ",%" PRIu64 ",", L2.reads, L2.readMisses, L2.readsPrefetch, L2.readMissesPrefetch, L2.writes, L2.writeMisses, L2.missRate, L2.writebacks, L2.prefetches);
+        fprintf(out, "%" PRIu64, results.memTraffic);
+        if (timed) {
+            const timing_results_t& t = results.timing;
+            fprintf(out, ",%u,%u,%" PRIu64 ",%" PRIu64 ",%.4f", t.L1HitLatency, t.L2HitLatency, t.cycles, t.stallCycles, t.amat);
+        }
+        fprintf(out, "\n");
+    }
+};
+
+// CacheHierarchy whose caches all use the replacement policy Policy
+template <class Policy>
+class PolicyCacheHierarchy : public CacheHierarchy {
+private:
+    cache_params_t params;
+    Cache<Policy>* l1Cache;
+    Cache<Policy>* l2Cache;
+    Cache<Policy>* cacheWithPrefetch; // last level of cache holding the stream buffers, if any
+    uint64_t requestCount; // requests issued so far; numbers the request trace lines
+    SetSampler* sampler; // sets simulated in sampling mode, or nullptr
+    TimingModel* timing; // times the requests, or nullptr
+    MemoryLog* memoryLog; // blocks the last level sends to and fetches from memory during a request, for the DRAM model; or nullptr
+
+    // Counters of the whole hierarchy that sampling attributes to the unit of each request
+    sample_counters_t getSampleCounters() {
+        sample_counters_t counters;
+        counters.l1Accesses = l1Cache->getReads() + l1Cache->getWrites();
+        counters.l1Misses = l1Cache->getReadMisses() + l1Cache->getWriteMisses();
+        counters.l2Reads = (l2Cache != nullptr) ? l2Cache->getReads() : 0;
+        counters.l2ReadMisses = (l2Cache != nullptr) ? l2Cache->getReadMisses() : 0;
+        counters.memTraffic = this->getMemTraffic();
+        return counters;
+    }
+
+    // Issue a batch of requests in sampling mode
+    // L1 drops the requests to sets that are not sampled; what the others
+    // change is credited to their unit for the confidence intervals
+    void runSampled(const TraceRecord* records, size_t count) {
+        sample_counters_t before = this->getSampleCounters();
+        for (size_t i = 0; i < count; ++i) {
+            requestCount++;
+            l1Cache->executeInstruction(records[i].rw, records[i].addr);
+            sample_counters_t after = this->getSampleCounters();
+            if (after.l1Accesses != before.l1Accesses) {
+                sample_counters_t& unit = sampler->getCounters(sampler->getSlot(l1Cache->getIndex(records[i].addr)));
+                unit.l1Accesses += after.l1Accesses - before.l1Accesses;
+                unit.l1Misses += after.l1Misses - before.l1Misses;
+                unit.l2Reads += after.l2Reads - before.l2Reads;
+                unit.l2ReadMisses += after.l2ReadMisses - before.l2ReadMisses;
+                unit.memTraffic += after.memTraffic - before.memTraffic;
+                before = after;
+            }
+        }
+    }
+
+    // Issue a batch of requests and time them
+    // What a request adds to the miss counters tells the timing model which
+    // levels it missed in, and the memory log what it sent to memory
+    void runTimed(const TraceRecord* records, size_t count) {
+        bool writeAllocate = isWriteAllocate(l1Cache->getWritePolicy());
+        for (size_t i = 0; i < count; ++i) {
+            requestCount++;
+            debugTraceRequest(records[i].addr, "%" PRIu64 "=%c %x\n", requestCount, records[i].rw, records[i].addr);
+            uint64_t l1Misses = l1Cache->getReadMisses() + l1Cache->getWriteMisses();
+            uint64_t l2Misses = (l2Cache != nullptr) ? l2Cache->getReadMisses() : 0;
+            if (memoryLog != nullptr) {
+                memoryLog->clear();
+            }
+            l1Cache->executeInstruction(records[i].rw, records[i].addr);
+            bool l1Miss = l1Cache->getReadMisses() + l1Cache->getWriteMisses() != l1Misses;
+            bool l2Miss = l2Cache != nullptr && l2Cache->getReadMisses() != l2Misses;
+            timing->request(records[i].addr, l1Miss, records[i].rw == 'r' || writeAllocate, l2Miss, memoryLog);
+        }
+    }
+
+    // Copy the counters of one level into its results
+    static void collectLevelResults(Cache<Policy>* cache, level_results_t* results) {
+        memset(results, 0, sizeof(*results));
+        if (cache != nullptr) {
+            results->reads = cache->getReads();
+            results->readMisses = cache->getReadMisses();
+            results->writes = cache->getWrites();
+            results->writeMisses = cache->getWriteMisses();
+            results->missRate = cache->getMissRate();
+            results->writebacks = cache->getWritebacks();
+            results->prefetches = cache->getPrefetches();
+            results->readsPrefetch = cache->getReadPrefetches();
+            results->readMissesPrefetch = cache->getReadMissPrefetches();
+        }
+    }
+
+public:
+    PolicyCacheHierarchy(const cache_params_t& params) : params(params), l1Cache(nullptr), l2Cache(nullptr), cacheWithPrefetch(nullptr), requestCount(0), sampler(nullptr), timing(nullptr), memoryLog(nullptr) {
+        // Instantiate L1 cache
+        if (params.L1_SIZE != 0) {
+            l1Cache = new Cache<Policy>(1, params.L1_SIZE, params.BLOCKSIZE, params.L1_ASSOC);
+
+            // Instantiate L2 cache
+            if (params.L2_SIZE !=0) {
+                l2Cache = new Cache<Policy>(2, params.L2_SIZE, params.BLOCKSIZE, params.L2_ASSOC);
+                // Linking the caches such that L1 can access L2
+                l1Cache->setNextCacheLevel(l2Cache);
+
+                if (params.PREF_N > 0) { // Stream buffers have to be added
+                    // Stream Buffers has to be added to the last level of cache
+                    // If L2 exists, add the stream buffers to L2
+                    l2Cache->addStreamBuffers(params.PREF_N, params.PREF_M, &requestCount);
+                    cacheWithPrefetch = l2Cache;
+                }
+            }
+            else if (params.PREF_N > 0) { // Stream buffers have to be added
+                // Stream Buffers has to be added to the last level of cache
+                // Since L2 does not exist, add the stream buffers to L1
+                l1Cache->addStreamBuffers(params.PREF_N, params.PREF_M, &requestCount);
+                cacheWithPrefetch = l1Cache;
+            }
+        }
+    }
+
+    // Deallocate dynamic memory allocation for creating the instances of the caches
+    ~PolicyCacheHierarchy() {
+        delete l1Cache;
+        delete l2Cache;
+        delete sampler;
+        delete timing;
+        delete memoryLog;
+    }
+
+    // A hierarchy owns its caches; copying it would free them twice
+    PolicyCacheHierarchy(const PolicyCacheHierarchy&) = delete;
+    PolicyCacheHierarchy& operator=(const PolicyCacheHierarchy&) = delete;
+
+    const cache_params_t& getParams() const {
+        return params;
+    }
+
+    bool hasCache() const {
+        return l1Cache != nullptr;
+    }
+
+    void access(char rw, uint32_t addr) {
+        if (l1Cache != nullptr && timing != nullptr) {
+            TraceRecord record = {addr, rw, 0};
+            this->runTimed(&record, 1);
+        }
+        else if (l1Cache != nullptr) {
+            requestCount++;
+            debugTraceRequest(addr, "%" PRIu64 "=%c %x\n", requestCount, rw, addr);
+            l1Cache->executeInstruction(rw, addr);
+        }
+    }
+
+    void run(const TraceRecord* records, size_t count) {
+        if (l1Cache == nullptr) {
+            return;
+        }
+        if (sampler != nullptr) {
+            this->runSampled(records, count);
+            return;
+        }
+        if (timing != nullptr) {
+            this->runTimed(records, count);
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            requestCount++;
+            debugTraceRequest(records[i].addr, "%" PRIu64 "=%c %x\n", requestCount, records[i].rw, records[i].addr);
+            l1Cache->executeInstruction(records[i].rw, records[i].addr);
+        }
+    }
+
+    uint64_t getMemTraffic() {
+        uint64_t value = 0;
+        if (l1Cache != nullptr) {
+            value += l1Cache->getMemTraffic();
+        }
+        if (l2Cache != nullptr) {
+            value += l2Cache->getMemTraffic();
+        }
+        return value;
+    }
+
+    sim_results_t getResults() {
+        sim_results_t results;
+        results.params = params;
+        collectLevelResults(l1Cache, &results.L1);
+        collectLevelResults(l2Cache, &results.L2);
+        results.memTraffic = this->getMemTraffic();
+        memset(&results.timing, 0, sizeof(results.timing));
+        if (timing != nullptr) {
+            results.timing.L1HitLatency = timing->getHitLatency(1);
+            results.timing.L2HitLatency = timing->getHitLatency(2);
+            results.timing.cycles = timing->getCycles();
+            results.timing.stallCycles = timing->getStallCycles();
+            results.timing.amat = timing->getAverageAccessTime();
+        }
+        return results;
+    }
+
+    void printContents() {
+        // Print L1 cache contents
+        if (l1Cache != nullptr) {
+            l1Cache->printContents();
+            printf("\n");
+        }
+        // Print L2 cache contents
+        if (l2Cache != nullptr) {
+            l2Cache->printContents();
+            printf("\n");
+        }
+        // Print Stream buffer contents if it exists
+        if (cacheWithPrefetch != nullptr) {
+            cacheWithPrefetch->printStreamBufferContents();
+            printf("\n");
+        }
+        // Print victim and miss cache contents if they exist; the write
+        // buffers have drained by the time the contents are printed
+        Cache<Policy>* levels[2] = {l1Cache, l2Cache};
+        for (auto cache : levels) {
+            if (cache != nullptr && cache->getAssistCache() != nullptr) {
+                cache->printAssistCacheContents();
+                printf("\n");
+            }
+        }
+    }
+
+    void printCoherence() {
+    }
+
+    void enableSampling(double ratio, uint32_t selection, uint32_t seed) {
+        if (l1Cache == nullptr) {
+            printf("Error: Set sampling needs an L1 cache.\n");
+            exit(EXIT_FAILURE);
+        }
+        // Prefetched streams cross sets, so the sampled sets would not see the traffic of a full run
+        if (params.PREF_N > 0) {
+            printf("Error: Set sampling does not support prefetching; PREF_N must be 0.\n");
+            exit(EXIT_FAILURE);
+        }
+        // Sample on the index bits of the level with the fewest sets
+        uint32_t setCount = l1Cache->getSetCount();
+        if (l2Cache != nullptr && l2Cache->getSetCount() < setCount) {
+            setCount = l2Cache->getSetCount();
+        }
+        sampler = new SetSampler(static_cast<uint32_t>(log2(setCount)), ratio, selection, seed);
+        l1Cache->setSampler(sampler);
+    }
+
+    void enableMissClassification() {
+        if (l1Cache != nullptr) {
+            l1Cache->enableMissClassification();
+        }
+        if (l2Cache != nullptr) {
+            l2Cache->enableMissClassification();
+        }
+    }
+
+    void printMissClassification(FILE* perSetOut) {
+        Cache<Policy>* levels[2] = {l1Cache, l2Cache};
+        printf("===== Miss classification =====\n");
+        for (auto cache : levels) {
+            if (cache != nullptr && cache->getMissClassifier() != nullptr) {
+                const miss_classes_t& total = cache->getMissClassifier()->getTotal();
+                printf("L%u compulsory misses:        %" PRIu64 "\n", cache->getCacheLevel(), total.compulsory);
+                printf("L%u capacity misses:          %" PRIu64 "\n", cache->getCacheLevel(), total.capacity);
+                printf("L%u conflict misses:          %" PRIu64 "\n", cache->getCacheLevel(), total.conflict);
+            }
+        }
+        if (perSetOut == nullptr) {
+            return;
+        }
+        fprintf(perSetOut, "level,set,compulsory,capacity,conflict\n");
+        for (auto cache : levels) {
+            if (cache != nullptr && cache->getMissClassifier() != nullptr) {
+                const MissClassifier* classifier = cache->getMissClassifier();
+                for (uint32_t set = 0; set < classifier->getSetCount(); ++set) {
+                    const miss_classes_t& classes = classifier->getSet(set);
+                    fprintf(perSetOut, "%u,%u,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", cache->getCacheLevel(), set, classes.compulsory, classes.capacity, classes.conflict);
+                }
+            }
+        }
+    }
+
+    void addAssistCache(uint32_t level, uint32_t kind, uint32_t entries) {
+        Cache<Policy>* cache = (level == 1) ? l1Cache : l2Cache;
+        if (cache == nullptr) {
+            printf("Error: A victim or miss cache at L%u needs an L%u cache.\n", level, level);
+            exit(EXIT_FAILURE);
+        }
+        cache->addAssistCache(kind, entries);
+    }
+
+    void printAssistCaches() {
+        Cache<Policy>* levels[2] = {l1Cache, l2Cache};
+        printf("===== Victim and miss caches =====\n");
+        for (auto cache : levels) {
+            if (cache == nullptr || cache->getAssistCache() == nullptr) {
+                continue;
+            }
+            const AssistCache* assist = cache->getAssistCache();
+            if (assist->getKind() == ASSIST_VICTIM) {
+                printf("L%u victim cache entries:      %u\n", cache->getCacheLevel(), assist->getEntryCount());
+                printf("L%u victim cache hits:         %" PRIu64 "\n", cache->getCacheLevel(), assist->counters.hits);
+                printf("L%u victim cache swaps:        %" PRIu64 "\n", cache->getCacheLevel(), assist->counters.swaps);
+                printf("L%u victim cache writebacks:   %" PRIu64 "\n", cache->getCacheLevel(), assist->counters.writebacks);
+            }
+            else {
+                printf("L%u miss cache entries:        %u\n", cache->getCacheLevel(), assist->getEntryCount());
+                printf("L%u miss cache hits:           %" PRIu64 "\n", cache->getCacheLevel(), assist->counters.hits);
+            }
+        }
+    }
+
+    void setInclusionPolicy(uint32_t inclusion) {
+        if (l2Cache == nullptr) {
+            return;
+        }
+        // A miss cache keeps copies of blocks that an exclusive L2 hands up or takes down
+        bool missCache = (l1Cache->getAssistCache() != nullptr && l1Cache->getAssistCache()->getKind() == ASSIST_MISS)
+                      || (l2Cache->getAssistCache() != nullptr && l2Cache->getAssistCache()->getKind() == ASSIST_MISS);
+        if (inclusion == INCLUSION_EXCLUSIVE && missCache) {
+            printf("Error: An exclusive L2 cannot be combined with a miss cache.\n");
+            exit(EXIT_FAILURE);
+        }
+        l2Cache->setInclusionPolicy(l1Cache, inclusion);
+    }
+
+    void printInclusion() {
+        printf("===== Inclusion =====\n");
+        if (l2Cache == nullptr) {
+            printf("inclusion policy:             none (no L2)\n");
+            return;
+        }
+        uint32_t l1Blocks = l1Cache->getValidBlockCount();
+        uint32_t l2Blocks = l2Cache->getValidBlockCount();
+        uint32_t duplicated = l1Cache->getBlocksAlsoIn(l2Cache);
+        printf("inclusion policy:             %s\n", inclusionPolicyNames[l2Cache->getInclusionPolicy()]);
+        printf("L1 back-invalidations:        %" PRIu64 "\n", l2Cache->getBackInvalidations());
+        printf("L1 dirty back-invalidations:  %" PRIu64 "\n", l2Cache->getDirtyBackInvalidations());
+        printf("L2 victim fills:              %" PRIu64 "\n", l2Cache->getVictimFills());
+        printf("blocks in both L1 and L2:     %u (%.2f%% of L2)\n", duplicated, 100.0 * duplicated / l2Cache->getBlockCount());
+        printf("distinct blocks cached:       %u of %u\n", l1Blocks + l2Blocks - duplicated, l1Cache->getBlockCount() + l2Cache->getBlockCount());
+    }
+
+    void setWritePolicy(uint32_t level, uint32_t policy) {
+        Cache<Policy>* cache = (level == 1) ? l1Cache : l2Cache;
+        if (cache != nullptr) {
+            cache->setWritePolicy(policy);
+        }
+    }
+
+    void addWriteBuffer(uint32_t level, uint32_t entries, uint32_t interval) {
+        Cache<Policy>* cache = (level == 1) ? l1Cache : l2Cache;
+        if (cache == nullptr) {
+            printf("Error: A write buffer below L%u needs an L%u cache.\n", level, level);
+            exit(EXIT_FAILURE);
+        }
+        // Every buffer drains on the clock of the requests issued to the hierarchy
+        cache->addWriteBuffer(entries, interval, &requestCount);
+    }
+
+    // L1 first, since what it drains may enter the L2 buffer
+    void drainWriteBuffers() {
+        if (l1Cache != nullptr) {
+            l1Cache->flushWriteBuffer();
+        }
+        if (l2Cache != nullptr) {
+            l2Cache->flushWriteBuffer();
+        }
+    }
+
+    void printWritePolicies() {
+        Cache<Policy>* levels[2] = {l1Cache, l2Cache};
+        printf("===== Write policies =====\n");
+        for (auto cache : levels) {
+            if (cache == nullptr) {
+                continue;
+            }
+            uint32_t level = cache->getCacheLevel();
+            printf("L%u write policy:              %s\n", level, writePolicyNames[cache->getWritePolicy()]);
+            printf("L%u write-throughs:            %" PRIu64 "\n", level, cache->getWriteThroughs());
+            printf("L%u write-arounds:             %" PRIu64 "\n", level, cache->getWriteArounds());
+            const WriteBuffer* buffer = cache->getWriteBuffer();
+            if (buffer == nullptr) {
+                continue;
+            }
+            printf("L%u write buffer entries:      %u (one drains every %u requests)\n", level, buffer->getEntryCount(), buffer->getInterval());
+            printf("L%u write buffer writes:       %" PRIu64 "\n", level, buffer->counters.writes);
+            printf("L%u write buffer merges:       %" PRIu64 "\n", level, buffer->counters.merges);
+            printf("L%u write buffer drains:       %" PRIu64 "\n", level, buffer->counters.drains);
+            printf("L%u write buffer full stalls:  %" PRIu64 "\n", level, buffer->counters.fullStalls);
+            printf("L%u write buffer read stalls:  %" PRIu64 "\n", level, buffer->counters.readStalls);
+            printf("L%u write buffer peak:         %u\n", level, buffer->counters.peak);
+            printf("L%u write buffer end drains:   %" PRIu64 "\n", level, buffer->getEndDrains());
+        }
+    }
+
+    void addPrefetcher(uint32_t level, uint32_t kind, uint32_t degree, uint32_t latency) {
+        Cache<Policy>* cache = (level == 1) ? l1Cache : l2Cache;
+        if (cache == nullptr) {
+            printf("Error: A prefetcher at L%u needs an L%u cache.\n", level, level);
+            exit(EXIT_FAILURE);
+        }
+        if (cache == cacheWithPrefetch) {
+            printf("Error: L%u prefetches into its stream buffers (PREF_N > 0); it cannot have another prefetcher.\n", level);
+            exit(EXIT_FAILURE);
+        }
+        // Prefetches arrive on the clock of the requests issued to the hierarchy, like the write buffers drain
+        cache->addPrefetcher(kind, degree, latency, &requestCount);
+    }
+
+    void setStreamBufferLatency(uint32_t latency) {
+        if (cacheWithPrefetch != nullptr) {
+            cacheWithPrefetch->setStreamBufferLatency(latency);
+        }
+    }
+
+    void printPrefetchers() {
+        Cache<Policy>* levels[2] = {l1Cache, l2Cache};
+        printf("===== Prefetchers =====\n");
+        for (auto cache : levels) {
+            if (cache == nullptr) {
+                continue;
+            }
+            uint32_t level = cache->getCacheLevel();
+            // Demand misses left, as in the miss rate: L2's writes are L1's writebacks
+            uint64_t misses = cache->getReadMisses() + ((level == 1) ? cache->getWriteMisses() : 0);
+            const PrefetchUnit* prefetcher = cache->getPrefetcher();
+            uint64_t issued = cache->getPrefetches();
+            uint64_t useful;
+            if (prefetcher != nullptr) {
+                useful = prefetcher->counters.useful;
+                printf("L%u prefetcher:                %s (degree %u)\n", level, prefetcherNames[prefetcher->getKind()], prefetcher->getDegree());
+            }
+            else if (cache == cacheWithPrefetch) {
+                useful = cache->getStreamBufferHits();
+                printf("L%u prefetcher:                stream buffers (%u of %u blocks)\n", level, cache->getStreamBufferCount(), cache->getStreamBufferSize());
+            }
+            else {
+                printf("L%u prefetcher:                none\n", level);
+                continue;
+            }
+            printf("L%u prefetches issued:         %" PRIu64 "\n", level, issued);
+            printf("L%u prefetches useful:         %" PRIu64 "\n", level, useful);
+            if (prefetcher != nullptr) {
+                printf("L%u prefetches late:           %" PRIu64 " (arriving %u requests after they are issued)\n", level, prefetcher->counters.late, prefetcher->getLatency());
+                printf("L%u prefetches unused:         %" PRIu64 "\n", level, prefetcher->counters.unused);
+                printf("L%u polluting prefetches:      %" PRIu64 "\n", level, prefetcher->counters.polluting);
+            }
+            else {
+                printf("L%u prefetches late:           %" PRIu64 " (arriving %u requests after they are issued)\n", level, cache->getStreamBufferLate(), cache->getStreamBufferLatency());
+                printf("L%u prefetches unused:         %" PRIu64 "\n", level, cache->getStreamBufferUnused());
+                printf("L%u polluting prefetches:      0 (stream buffers never evict a block of the level)\n", level);
+            }
+            printf("L%u prefetch accuracy:         %.4f\n", level, (issued != 0) ? double(useful) / issued : 0.0);
+            printf("L%u prefetch coverage:         %.4f\n", level, (useful + misses != 0) ? double(useful) / (useful + misses) : 0.0);
+        }
+        printf("memory traffic:               %" PRIu64 "\n", this->getMemTraffic());
+    }
+
+    // The most blocks lastCache can read from and write to memory while serving
+    // one request of the trace: it is reached by the request, the writeback of
+    // L1, the prefetches of both levels and every entry of a write buffer of L1
+    // draining at once, and each of those can fetch a block, start a stream of
+    // PREF_M prefetches and write back, write through and back-invalidate a
+    // block. Entries of its own write buffer can all drain to memory at once.
+    size_t getMemoryLogCapacity(Cache<Policy>* lastCache) const {
+        size_t accesses = 2 + 2 * PREFETCH_MAX_DEGREE;
+        if (lastCache != l1Cache && l1Cache->getWriteBuffer() != nullptr) {
+            accesses += l1Cache->getWriteBuffer()->getEntryCount();
+        }
+        size_t capacity = accesses * (size_t(params.PREF_M) + 4);
+        if (lastCache->getWriteBuffer() != nullptr) {
+            capacity += lastCache->getWriteBuffer()->getEntryCount();
+        }
+        return capacity;
+    }
+
+    void enableTiming(const uint32_t hitLatency[2], uint32_t memoryLatency, const uint32_t mshrs[2], const dram_params_t* dram) {
+        if (l1Cache == nullptr) {
+            printf("Error: The timing model needs an L1 cache.\n");
+            exit(EXIT_FAILURE);
+        }
+        delete timing;
+        timing = new TimingModel(params, hitLatency, memoryLatency, mshrs, dram);
+        if (dram != nullptr && memoryLog == nullptr) {
+            // Only the last level reaches memory
+            Cache<Policy>* lastCache = (l2Cache != nullptr) ? l2Cache : l1Cache;
+            memoryLog = new MemoryLog(this->getMemoryLogCapacity(lastCache));
+            lastCache->setMemoryLog(memoryLog);
+        }
+    }
+
+    void printTiming() {
+        Cache<Policy>* levels[2] = {l1Cache, l2Cache};
+        printf("===== Timing =====\n");
+        if (timing == nullptr) {
+            printf("timing:                       none\n");
+            return;
+        }
+        timing->settle();
+        for (auto cache : levels) {
+            if (cache == nullptr) {
+                continue;
+            }
+            uint32_t level = cache->getCacheLevel();
+            const MshrFile& mshrs = timing->getMshrs(level);
+            printf("L%u hit latency:               %u cycles%s\n", level, timing->getHitLatency(level), timing->isDerived(level) ? " (from the size and associativity)" : "");
+            printf("L%u MSHRs:                     %u\n", level, mshrs.getCount());
+            printf("L%u primary misses:            %" PRIu64 "\n", level, mshrs.counters.primary);
+            printf("L%u secondary misses:          %" PRIu64 " (merged into an MSHR)\n", level, mshrs.counters.secondary);
+            printf("L%u MSHR full stalls:          %" PRIu64 " (%" PRIu64 " cycles)\n", level, mshrs.counters.fullStalls, mshrs.counters.stallCycles);
+            // Occupancy histogram over the cycles up to the last completion; empty rows are left out
+            uint64_t cycles = timing->getCycles();
+            for (uint32_t busy = 0; busy < mshrs.occupancy.size(); ++busy) {
+                if (mshrs.occupancy[busy] != 0) {
+                    char label[32];
+                    snprintf(label, sizeof(label), "L%u MSHRs busy %u:", level, busy);
+                    printf("%-30s%" PRIu64 " cycles (%.2f%%)\n", label, mshrs.occupancy[busy], 100.0 * mshrs.occupancy[busy] / cycles);
+                }
+            }
+        }
+        if (timing->getDram() != nullptr) {
+            printf("memory latency:               DRAM model\n");
+        }
+        else {
+            printf("memory latency:               %u cycles\n", timing->getMemoryLatency());
+        }
+        printf("requests:                     %" PRIu64 "\n", timing->getRequests());
+        printf("cycles:                       %" PRIu64 "\n", timing->getCycles());
+        printf("core stall cycles:            %" PRIu64 " (waiting for an L1 MSHR)\n", timing->getStallCycles());
+        printf("average memory access time:   %.4f cycles\n", timing->getAverageAccessTime());
+        double l2MissRate = (l2Cache != nullptr) ? l2Cache->getMissRate() : 0.0;
+        printf("AMAT from the miss rates:     %.4f cycles (no MSHR limits or merging)\n", timing->getMissRateAccessTime(l1Cache->getMissRate(), l2MissRate));
+    }
+
+    void printDram() {
+        printf("===== DRAM =====\n");
+        const DramController* dram = (timing != nullptr) ? timing->getDram() : nullptr;
+        if (dram == nullptr) {
+            printf("DRAM:                         none (fixed memory latency)\n");
+            return;
+        }
+        timing->settle();
+        const dram_params_t& p = dram->getParams();
+        static const char* const kindNames[DRAM_REQUEST_KIND_COUNT] = {"demand reads", "prefetch reads", "writes"};
+        printf("DRAM channels:                %u (%u banks of %u byte rows each)\n", p.channels, p.banks, p.rowBytes);
+        printf("DRAM timing:                  tCAS %u, tRCD %u, tRP %u, %u cycles a block on the bus\n", p.tCAS, p.tRCD, p.tRP, dram->getBurst());
+        printf("DRAM scheduler:               %s (%u queue entries per channel)\n", dramSchedulerNames[p.scheduler], p.queueEntries);
+        dram_counters_t total;
+        memset(&total, 0, sizeof(total));
+        for (uint32_t kind = 0; kind < DRAM_REQUEST_KIND_COUNT; ++kind) {
+            const dram_counters_t& c = dram->counters[kind];
+            char label[32];
+            snprintf(label, sizeof(label), "DRAM %s:", kindNames[kind]);
+            printf("%-30s%" PRIu64 " (latency %.2f, queueing %.2f cycles)\n", label, c.requests,
+                   (c.requests != 0) ? double(c.latency) / c.requests : 0.0, (c.requests != 0) ? double(c.queueing) / c.requests : 0.0);
+            total.requests += c.requests;
+            total.rowHits += c.rowHits;
+            total.rowMisses += c.rowMisses;
+            total.rowConflicts += c.rowConflicts;
+            total.queueing += c.queueing;
+        }
+        double requests = (total.requests != 0) ? double(total.requests) : 1.0;
+        printf("DRAM row-buffer hits:         %" PRIu64 " (%.2f%%)\n", total.rowHits, 100.0 * total.rowHits / requests);
+        printf("DRAM row-buffer misses:       %" PRIu64 " (%.2f%%, bank closed)\n", total.rowMisses, 100.0 * total.rowMisses / requests);
+        printf("DRAM row-buffer conflicts:    %" PRIu64 " (%.2f%%)\n", total.rowConflicts, 100.0 * total.rowConflicts / requests);
+        printf("DRAM average queueing delay:  %.2f cycles\n", total.queueing / requests);
+        printf("DRAM queue full stalls:       %" PRIu64 "\n", dram->fullStalls);
+        // Bandwidth over the whole run, up to the last block on a bus
+        uint64_t cycles = (dram->getLastCompletion() > timing->getCycles()) ? dram->getLastCompletion() : timing->getCycles();
+        double achieved = (cycles != 0) ? double(total.requests) * params.BLOCKSIZE / cycles : 0.0;
+        double peak = dram->getPeakBandwidth(params.BLOCKSIZE);
+        printf("DRAM bandwidth:               %.4f bytes per cycle (%.2f%% of the peak %.2f)\n", achieved, 100.0 * achieved / peak, peak);
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.put(requestCount);
+        if (l1Cache != nullptr) {
+            l1Cache->save(out);
+        }
+        if (l2Cache != nullptr) {
+            l2Cache->save(out);
+        }
+        uint32_t timed = (timing != nullptr) ? 1 : 0;
+        out.put(timed);
+        if (timing != nullptr) {
+            timing->save(out);
+        }
+    }
+
+    void restore(SnapshotReader& in) {
+        in.get(&requestCount);
+        if (l1Cache != nullptr) {
+            l1Cache->restore(in);
+        }
+        if (l2Cache != nullptr) {
+            l2Cache->restore(in);
+        }
+        uint32_t timed;
+        in.get(&timed);
+        if (timed != ((timing != nullptr) ? 1u : 0u)) {
+            printf("Error: Snapshot was taken with a different timing configuration.\n");
+            exit(EXIT_FAILURE);
+        }
+        if (timing != nullptr) {
+            timing->restore(in);
+        }
+    }
+
+    void printSampledEstimates() {
+        if (sampler != nullptr) {
+            sampler->printEstimates(l2Cache != nullptr, requestCount);
+        }
+    }
+};
+
+CacheHierarchy* CacheHierarchy::create(const cache_params_t& params) {
+    switch (params.REPL_POLICY) {
+        case REPL_LRU:
+            return new PolicyCacheHierarchy<LRUPolicy>(params);
+        case REPL_PLRU:
+            return new PolicyCacheHierarchy<PLRUPolicy>(params);
+        case REPL_NRU:
+            return new PolicyCacheHierarchy<NRUPolicy>(params);
+        case REPL_SRRIP:
+            return new PolicyCacheHierarchy<SRRIPPolicy>(params);
+        case REPL_BRRIP:
+            return new PolicyCacheHierarchy<BRRIPPolicy>(params);
+        case REPL_RANDOM:
+            return new PolicyCacheHierarchy<RandomPolicy>(params);
+        case REPL_FIFO:
+            return new PolicyCacheHierarchy<FIFOPolicy>(params);
+    }
+    printf("Error: Unknown replacement policy %u.\n", params.REPL_POLICY);
+    exit(EXIT_FAILURE);
+}
+
+// Checkpoint request that stands for the end of the trace
+#define CHECKPOINT_AT_END 0xFFFFFFFFFFFFFFFFull
+
+// Feeds batches of requests to a group of hierarchies and writes a snapshot
+// of all of them once checkpointAt requests of the trace have been simulated,
+// splitting the batch that reaches it. Without a checkpoint path it only
+// passes the batches on.
+// Until the snapshot is written the requests are added to the digest of the
+// trace; after a restore that starts as the digest of the restored requests.
+class CheckpointRunner {
+private:
+    const std::vector<CacheHierarchy*>& hierarchies;
+    const char* path; // snapshot to write, or nullptr
+    uint64_t checkpointAt; // requests simulated when it is written; CHECKPOINT_AT_END for the end of the trace
+    uint64_t position; // requests of the trace simulated so far, restored ones included
+    TraceDigest digest; // of those requests, while the snapshot is still due
+    bool written;
+
+    void runAll(const TraceRecord* records, size_t count) {
+        for (auto& hierarchy : hierarchies) {
+            hierarchy->run(records, count);
+        }
+        if (path != nullptr && !written) {
+            digest.add(records, count);
+        }
+        position += count;
+    }
+
+public:
+    CheckpointRunner(const std::vector<CacheHierarchy*>& hierarchies, const char* path, uint64_t checkpointAt, uint64_t position,
+                     const TraceDigest& digest)
+        : hierarchies(hierarchies), path(path), checkpointAt(checkpointAt), position(position), digest(digest), written(false) {
+        if (path != nullptr && checkpointAt != CHECKPOINT_AT_END && checkpointAt < position) {
+            printf("Error: The checkpoint at request %" PRIu64 " comes before the %" PRIu64 " requests already restored.\n", checkpointAt, position);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    void run(const TraceRecord* records, size_t count) {
+        if (path != nullptr && !written && checkpointAt - position <= count && checkpointAt != CHECKPOINT_AT_END) {
+            size_t before = size_t(checkpointAt - position);
+            this->runAll(records, before);
+            CacheHierarchy::saveSnapshot(path, hierarchies, position, digest.get());
+            written = true;
+            records += before;
+            count -= before;
+        }
+        this->runAll(records, count);
+    }
+
+    // Called at the end of the trace; writes a snapshot still due and then
+    // drains the write buffers, which a later restore must find as they were
+    void finish() {
+        if (path != nullptr && !written) {
+            if (checkpointAt != CHECKPOINT_AT_END && checkpointAt != position) {
+                printf("Error: The trace ended after %" PRIu64 " requests, before the checkpoint at request %" PRIu64 ".\n", position, checkpointAt);
+                exit(EXIT_FAILURE);
+            }
+            CacheHierarchy::saveSnapshot(path, hierarchies, position, digest.get());
+            written = true;
+        }
+        for (auto& hierarchy : hierarchies) {
+            hierarchy->drainWriteBuffers();
+        }
+    }
+};
+
+void CacheHierarchy::saveSnapshot(const char* path, const std::vector<CacheHierarchy*>& hierarchies, uint64_t records, uint64_t traceDigest) {
+    SnapshotWriter out;
+    if (!out.open(path)) {
+        printf("Error: Unable to open file %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    uint8_t header[SNAPSHOT_HEADER_SIZE];
+    uint16_t version = SNAPSHOT_VERSION;
+    uint32_t hierarchyCount = uint32_t(hierarchies.size());
+    memset(header, 0, sizeof(header));
+    memcpy(header, SNAPSHOT_MAGIC, 4);
+    memcpy(header + 4, &version, sizeof(version));
+    memcpy(header + 8, &records, sizeof(records));
+    memcpy(header + 16, &hierarchyCount, sizeof(hierarchyCount));
+    memcpy(header + 24, &traceDigest, sizeof(traceDigest));
+    out.write(header, sizeof(header));
+    // The table is written once every section's place is known
+    std::vector<uint8_t> table(hierarchies.size() * SNAPSHOT_ENTRY_SIZE, 0);
+    out.write(table.data(), table.size());
+    for (size_t i = 0; i < hierarchies.size(); ++i) {
+        out.align();
+        uint64_t offset = out.getOffset();
+        hierarchies[i]->save(out);
+        Snapshot::encodeEntry(hierarchies[i]->getParams(), offset, out.getOffset() - offset, &table[i * SNAPSHOT_ENTRY_SIZE]);
+    }
+    out.patch(SNAPSHOT_HEADER_SIZE, table.data(), table.size());
+    if (!out.close()) {
+        printf("Error: Unable to write file %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void CacheHierarchy::restoreSnapshot(const Snapshot& snapshot, uint32_t index, CacheHierarchy* hierarchy) {
+    if (!Snapshot::sameParams(snapshot.getParams(index), hierarchy->getParams())) {
+        printf("Error: Snapshot configuration %u does not match the configuration being simulated.\n", index + 1);
+        exit(EXIT_FAILURE);
+    }
+    SnapshotReader in = snapshot.getSection(index);
+    hierarchy->restore(in);
+    if (!in.atEnd()) {
+        SnapshotReader::corrupt();
+    }
+}
+
+void CacheHierarchy::openSnapshot(const char* path, size_t hierarchyCount, Snapshot* snapshot) {
+    if (!snapshot->open(path)) {
+        printf("Error: Unable to open file %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    if (snapshot->getHierarchyCount() != hierarchyCount) {
+        printf("Error: Snapshot %s holds %u configurations but %zu are simulated.\n", path, snapshot->getHierarchyCount(), hierarchyCount);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void CacheHierarchy::skipRestoredRequests(TraceReader& trace, const Snapshot& snapshot, TraceDigest* digest) {
+    std::vector<TraceRecord> batch(PIPELINE_BATCH_RECORDS);
+    uint64_t records = snapshot.getRecords();
+    uint64_t skipped = 0;
+    size_t count = batch.size();
+    while (skipped < records && count == batch.size()) {
+        uint64_t left = records - skipped;
+        count = trace.read(batch.data(), (left < batch.size()) ? size_t(left) : batch.size());
+        digest->add(batch.data(), count);
+        skipped += count;
+    }
+    if (skipped != records) {
+        printf("Error: The trace has only %" PRIu64 " requests; the snapshot was taken after %" PRIu64 ".\n", skipped, records);
+        exit(EXIT_FAILURE);
+    }
+    if (digest->get() != snapshot.getTraceDigest()) {
+        printf("Error: The snapshot was taken on a different trace; its first %" PRIu64 " requests differ from this one's.\n", records);
+        exit(EXIT_FAILURE);
+    }
+}
+
+uint64_t CacheHierarchy::restoreSnapshot(const char* path, const std::vector<CacheHierarchy*>& hierarchies, TraceReader& trace, TraceDigest* digest) {
+    Snapshot snapshot;
+    openSnapshot(path, hierarchies.size(), &snapshot);
+    for (size_t i = 0; i < hierarchies.size(); ++i) {
+        restoreSnapshot(snapshot, uint32_t(i), hierarchies[i]);
+    }
+    skipRestoredRequests(trace, snapshot, digest);
+    return snapshot.getRecords();
+}
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <vector>
+
+// Interval statistics
+//
+// Prints the counters of a hierarchy every `length` requests as a time
+// series: one row per interval with what each counter grew by during the
+// interval, and the miss rates of the interval alone. Intervals end at
+// multiples of `length` requests of the trace, so a run restored from a
+// snapshot carries on with the same boundaries; a last, shorter interval
+// covers the end of the trace. An interval is recorded only once more
+// requests follow it or the trace ends, so the last one also counts the
+// writes drained from the write buffers at the end.
+//
+// Rows are formatted into a buffer allocated up front and written out
+// whenever it fills, so the simulation loop never waits on output.
+
+enum IntervalFormat {INTERVAL_CSV=0, INTERVAL_JSON};
+
+#define INTERVAL_BUFFER_SIZE (1 << 16)
+#define INTERVAL_ROW_MAX 1024 // longest row the formats produce, with room to spare
+
+class IntervalSeries {
+private:
+    CacheHierarchy* hierarchy;
+    FILE* out; // nullptr if no series is printed
+    uint32_t format; // an IntervalFormat
+    uint64_t length; // requests per interval
+    uint64_t position; // requests of the trace simulated so far, restored ones included
+    bool pending; // true if an interval ended at position and is not recorded yet
+    sim_results_t last; // counters at the end of the previous interval
+    std::vector<char> buffer;
+    size_t used;
+
+    void flush() {
+        if (used != 0 && fwrite(buffer.data(), 1, used, out) != used) {
+            printf("Error: Unable to write the interval statistics.\n");
+            exit(EXIT_FAILURE);
+        }
+        used = 0;
+    }
+
+    // Appends formatted text to the buffer
+    void append(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(buffer.data() + used, buffer.size() - used, format, args);
+        va_end(args);
+        used += size_t(written);
+    }
+
+    // What the counters of a level grew by since before, and the miss rate of those requests; level is 1 or 2
+    static level_results_t difference(const level_results_t& now, const level_results_t& before, uint32_t level) {
+        level_results_t delta;
+        delta.reads = now.reads - before.reads;
+        delta.readMisses = now.readMisses - before.readMisses;
+        delta.writes = now.writes - before.writes;
+        delta.writeMisses = now.writeMisses - before.writeMisses;
+        delta.writebacks = now.writebacks - before.writebacks;
+        delta.prefetches = now.prefetches - before.prefetches;
+        delta.readsPrefetch = now.readsPrefetch - before.readsPrefetch;
+        delta.readMissesPrefetch = now.readMissesPrefetch - before.readMissesPrefetch;
+        // The same definitions as the miss rates of the measurements
+        delta.missRate = 0.0;
+        if (level == 1 && delta.reads + delta.writes != 0) {
+            delta.missRate = double(delta.readMisses + delta.writeMisses) / double(delta.reads + delta.writes);
+        }
+        if (level == 2 && delta.reads != 0) {
+            delta.missRate = double(delta.readMisses) / double(delta.reads);
+        }
+        return delta;
+    }
+
+    void appendLevelJSON(const char* name, const level_results_t& level) {
+        this->append("\"%s\":{\"reads\":%" PRIu64 ",\"read_misses\":%" PRIu64 ",\"writes\":%" PRIu64 ",\"write_misses\":%" PRIu64 ",\"miss_rate\":%.4f,"
+                     "\"writebacks\":%" PRIu64 ",\"prefetches\":%" PRIu64 ",\"reads_prefetch\":%" PRIu64 ",\"read_misses_prefetch\":%" PRIu64 "}",
+                     name, level.reads, level.readMisses, level.writes, level.writeMisses, level.missRate,
+                     level.writebacks, level.prefetches, level.readsPrefetch, level.readMissesPrefetch);
+    }
+
+    // Appends the row of the interval that ends now
+    void record() {
+        sim_results_t now = hierarchy->getResults();
+        level_results_t L1 = difference(now.L1, last.L1, 1);
+        level_results_t L2 = difference(now.L2, last.L2, 2);
+        uint64_t memTraffic = now.memTraffic - last.memTraffic;
+        last = now;
+        if (format == INTERVAL_JSON) {
+            this->append("{\"request\":%" PRIu64 ",", position);
+            this->appendLevelJSON("L1", L1);
+            this->append(",");
+            this->appendLevelJSON("L2", L2);
+            this->append(",\"memory_traffic\":%" PRIu64 "}\n", memTraffic);
+        }
+        else {
+            this->append("%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.4f,%" PRIu64 ",%" PRIu64 ",", position,
+                         L1.reads, L1.readMisses, L1.writes, L1.writeMisses, L1.missRate, L1.writebacks, L1.prefetches);
+            this->append("%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.4f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+                         L2.reads, L2.readMisses, L2.readsPrefetch, L2.readMissesPrefetch, L2.writes, L2.writeMisses,
+                         L2.missRate, L2.writebacks, L2.prefetches, memTraffic);
+        }
+        if (buffer.size() - used < INTERVAL_ROW_MAX) {
+            this->flush();
+        }
+    }
+
+public:
+    // Prints the series of hierarchy to out, or does nothing but pass the
+    // requests on if out is nullptr; position is the number of requests of
+    // the trace the hierarchy has already simulated
+    IntervalSeries(CacheHierarchy* hierarchy, FILE* out, uint32_t format, uint64_t length, uint64_t position)
+        : hierarchy(hierarchy), out(out), format(format), length(length), position(position), pending(false), used(0) {
+        if (out == nullptr) {
+            return;
+        }
+        last = hierarchy->getResults();
+        buffer.assign(INTERVAL_BUFFER_SIZE, '\0');
+        if (format == INTERVAL_CSV) {
+            this->append("request,L1_reads,L1_read_misses,L1_writes,L1_write_misses,L1_miss_rate,L1_writebacks,L1_prefetches,"
+                         "L2_reads,L2_read_misses,L2_reads_prefetch,L2_read_misses_prefetch,L2_writes,L2_write_misses,L2_miss_rate,L2_writebacks,L2_prefetches,"
+                         "memory_traffic\n");
+        }
+    }
+
+    IntervalSeries(const IntervalSeries&) = delete;
+    IntervalSeries& operator=(const IntervalSeries&) = delete;
+
+    // Passes a batch of requests on to runner, split at the interval boundaries
+    void run(CheckpointRunner& runner, const TraceRecord* records, size_t count) {
+        if (out == nullptr) {
+            runner.run(records, count);
+            return;
+        }
+        while (count != 0) {
+            if (pending) {
+                this->record();
+                pending = false;
+            }
+            uint64_t remaining = length - position % length;
+            size_t chunk = (remaining < count) ? size_t(remaining) : count;
+            runner.run(records, chunk);
+            position += chunk;
+            records += chunk;
+            count -= chunk;
+            pending = (position % length == 0);
+        }
+    }
+
+    // Called at the end of the trace, after the write buffers have drained;
+    // prints the last interval and writes out the buffer
+    void finish() {
+        if (out == nullptr) {
+            return;
+        }
+        if (pending || position % length != 0) {
+            this->record();
+        }
+        this->flush();
+        fflush(out);
+    }
+};
+
+// Parses "csv" or "json"; returns false on anything else
+static bool parseIntervalFormat(const char* text, uint32_t* format) {
+    if (strcmp(text, "csv") == 0) {
+        *format = INTERVAL_CSV;
+        return true;
+    }
+    if (strcmp(text, "json") == 0) {
+        *format = INTERVAL_JSON;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Requests decoded into one batch of the pipeline
+#define PIPELINE_BATCH_RECORDS (1 << 14)
+// Batches in the pipeline's ring; bounds how far decoding runs ahead of simulation
+#define PIPELINE_SLOTS 8
+
+// Decodes a trace on a thread of its own while the caller simulates it
+//
+// The decoder thread fills fixed-size batches of requests into a ring of
+// PIPELINE_SLOTS slots and the caller takes them out in order with next().
+// There is exactly one producer and one consumer, so the ring needs no lock:
+// the decoder only writes the slot at `produced` and then publishes it by
+// advancing `produced`, and the caller only reads the slot at `consumed` and
+// releases it by advancing `consumed`. Memory use is fixed by the ring,
+// however long the trace is. A side that has to wait for the other (the
+// decoder for a free slot, the caller for a full one) sleeps on a condition
+// variable rather than spinning, so the waiting thread leaves its core to
+// sweep workers and simulated cores; each side wakes the other once per batch.
+//
+// Errors found while decoding (an unknown request type, a corrupt or
+// truncated trace) are reported by next() on the caller's thread, after
+// every request before them has been handed out, like TraceReader::read().
+class TracePipeline {
+private:
+    struct Batch {
+        std::vector<TraceRecord> records;
+        size_t count;
+        char badType; // request type that stopped decoding, 0 if none
+        bool last; // no batches follow this one
+    };
+
+    TraceReader& reader;
+    std::vector<Batch> slots;
+    std::atomic<uint64_t> produced; // batches published by the decoder
+    std::atomic<uint64_t> consumed; // batches released by the caller
+    std::atomic<bool> stopping; // set when the caller stops early
+    std::mutex mutex; // guards sleeping on `changed` only
+    std::condition_variable changed; // `produced`, `consumed` or `stopping` changed
+    bool holding; // the caller holds the batch at `consumed`
+    bool finished; // the last batch has been handed out
+    char pendingBadType; // unknown request type to report on the next call
+    std::thread decoder;
+
+    void decode() {
+        uint64_t index = 0;
+        while (true) {
+            // Wait for a free slot
+            if (index - consumed.load(std::memory_order_acquire) == slots.size()) {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() {
+                    return index - consumed.load(std::memory_order_acquire) != slots.size() || stopping.load(std::memory_order_relaxed);
+                });
+                if (stopping.load(std::memory_order_relaxed)) {
+                    return;
+                }
+            }
+            Batch& batch = slots[index % slots.size()];
+            batch.count = reader.readValid(batch.records.data(), batch.records.size(), &batch.badType);
+            batch.last = (batch.count < batch.records.size()) || batch.badType != 0;
+            produced.store(++index, std::memory_order_release);
+            this->wake();
+            if (batch.last) {
+                return;
+            }
+        }
+    }
+
+    // Wakes the other side if it sleeps; the mutex orders this after its last
+    // check of the counters, so the wakeup cannot be lost
+    void wake() {
+        std::lock_guard<std::mutex> lock(mutex);
+        changed.notify_one();
+    }
+
+public:
+    TracePipeline(TraceReader& reader) : reader(reader), slots(PIPELINE_SLOTS), produced(0), consumed(0), stopping(false),
+                                         holding(false), finished(false), pendingBadType(0) {
+        for (auto& slot : slots) {
+            slot.records.resize(PIPELINE_BATCH_RECORDS);
+        }
+        decoder = std::thread(&TracePipeline::decode, this);
+    }
+
+    ~TracePipeline() {
+        stopping.store(true, std::memory_order_relaxed);
+        this->wake();
+        decoder.join();
+    }
+
+    TracePipeline(const TracePipeline&) = delete;
+    TracePipeline& operator=(const TracePipeline&) = delete;
+
+    // Hands out the next batch of requests and sets count to its size;
+    // returns nullptr at the end of the trace. A batch stays valid until the next call.
+    // Exits with an error where TraceReader::read() would.
+    const TraceRecord* next(size_t* count) {
+        uint64_t index = consumed.load(std::memory_order_relaxed);
+        if (holding) {
+            consumed.store(++index, std::memory_order_release);
+            holding = false;
+            this->wake();
+        }
+        if (pendingBadType != 0) {
+            printf("Error: Unknown request type %c.\n", pendingBadType);
+            exit(EXIT_FAILURE);
+        }
+        if (finished) {
+            if (reader.getError() != nullptr) {
+                printf("Error: %s\n", reader.getError());
+                exit(EXIT_FAILURE);
+            }
+            return nullptr;
+        }
+        if (produced.load(std::memory_order_acquire) == index) {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() {
+                return produced.load(std::memory_order_acquire) != index;
+            });
+        }
+        Batch& batch = slots[index % slots.size()];
+        finished = batch.last;
+        pendingBadType = batch.badType;
+        holding = true;
+        *count = batch.count;
+        return batch.records.data();
+    }
+};
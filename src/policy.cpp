@@ -0,0 +1,534 @@
+#include <inttypes.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+// Replacement policies
+//
+// A policy keeps the replacement state of every set of one cache level in
+// its own flat arrays, indexed like the TagStore (set * assoc + way). Cache
+// and CacheSet take the policy as a template parameter, so each policy gets
+// its own specialised copy of the access path. All of them provide:
+//    void init(uint32_t setCount, uint32_t assoc)
+//    void onFill(uint32_t set, uint32_t way)        a block was placed in an invalid way
+//    void onHit(uint32_t set, uint32_t way)         a valid block was referenced
+//    void onInvalidate(uint32_t set, uint32_t way)  a block was evicted
+//    uint32_t getVictim(uint32_t set)               the way to evict from a full set
+//    void getPrintOrder(uint32_t set, const uint8_t* valid, std::vector<uint32_t>* ways)
+//                                                   valid ways in the order they are printed,
+//                                                   most recently used first where the policy knows it
+//    void save(SnapshotWriter& out) const           write the replacement state to a snapshot
+//    void restore(SnapshotReader& in)               read it back into a policy built with the same geometry
+// Cache fills the first invalid way itself and only asks for a victim when
+// the set is full, as it always has.
+
+// Policies selectable for REPL_POLICY
+enum ReplacementPolicy {
+    REPL_LRU = 0,
+    REPL_PLRU,
+    REPL_NRU,
+    REPL_SRRIP,
+    REPL_BRRIP,
+    REPL_RANDOM,
+    REPL_FIFO,
+    REPL_POLICY_COUNT
+};
+
+static const char* const replacementPolicyNames[REPL_POLICY_COUNT] = {
+    "lru", "plru", "nru", "srrip", "brrip", "random", "fifo"
+};
+
+const char* getReplacementPolicyName(uint32_t policy) {
+    return (policy < REPL_POLICY_COUNT) ? replacementPolicyNames[policy] : "unknown";
+}
+
+// Looks up a policy by name; returns false if there is no such policy
+bool parseReplacementPolicy(const char* name, uint32_t* policy) {
+    for (uint32_t p = 0; p < REPL_POLICY_COUNT; ++p) {
+        if (strcmp(name, replacementPolicyNames[p]) == 0) {
+            *policy = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Small deterministic generator for the randomised policies, so runs are reproducible
+class XorShift32 {
+private:
+    uint32_t state;
+
+public:
+    XorShift32(uint32_t seed = 0x9E3779B9u) : state(seed != 0 ? seed : 0x9E3779B9u) {
+    }
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.put(state);
+    }
+
+    void restore(SnapshotReader& in) {
+        in.get(&state);
+    }
+};
+
+// True LRU
+// Each set keeps its valid ways in a doubly linked list from most to least
+// recently used, so a hit, a fill and finding the victim are all O(1).
+class LRUPolicy {
+private:
+    enum : uint32_t { NONE = 0xFFFFFFFFu };
+    uint32_t assoc;
+    std::vector<uint32_t> prev; // per way: next more recently used way of the set
+    std::vector<uint32_t> next; // per way: next less recently used way of the set
+    std::vector<uint32_t> head; // per set: MRU way
+    std::vector<uint32_t> tail; // per set: LRU way
+
+    void unlink(uint32_t set, uint32_t way) {
+        uint32_t base = set * assoc;
+        uint32_t p = prev[base + way];
+        uint32_t n = next[base + way];
+        if (p != NONE) {
+            next[base + p] = n;
+        }
+        else {
+            head[set] = n;
+        }
+        if (n != NONE) {
+            prev[base + n] = p;
+        }
+        else {
+            tail[set] = p;
+        }
+    }
+
+    void pushFront(uint32_t set, uint32_t way) {
+        uint32_t base = set * assoc;
+        prev[base + way] = NONE;
+        next[base + way] = head[set];
+        if (head[set] != NONE) {
+            prev[base + head[set]] = way;
+        }
+        else {
+            tail[set] = way;
+        }
+        head[set] = way;
+    }
+
+public:
+    void init(uint32_t setCount, uint32_t assoc) {
+        this->assoc = assoc;
+        prev.assign(size_t(setCount) * assoc, NONE);
+        next.assign(size_t(setCount) * assoc, NONE);
+        head.assign(setCount, NONE);
+        tail.assign(setCount, NONE);
+    }
+
+    void onFill(uint32_t set, uint32_t way) {
+        pushFront(set, way);
+    }
+
+    void onHit(uint32_t set, uint32_t way) {
+        if (head[set] != way) {
+            unlink(set, way);
+            pushFront(set, way);
+        }
+    }
+
+    void onInvalidate(uint32_t set, uint32_t way) {
+        unlink(set, way);
+    }
+
+    uint32_t getVictim(uint32_t set) {
+        return tail[set];
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.putVector(prev);
+        out.putVector(next);
+        out.putVector(head);
+        out.putVector(tail);
+    }
+
+    // Every link must name a way of the set or NONE, and every set's list
+    // must run from head to tail through at most assoc ways, with prev
+    // mirroring next; anything else would send a later walk out of the
+    // arrays or round in circles
+    void restore(SnapshotReader& in) {
+        in.getVector(&prev);
+        in.getVector(&next);
+        in.getVector(&head);
+        in.getVector(&tail);
+        for (size_t i = 0; i < prev.size(); ++i) {
+            if ((prev[i] != NONE && prev[i] >= assoc) || (next[i] != NONE && next[i] >= assoc)) {
+                SnapshotReader::corrupt();
+            }
+        }
+        for (uint32_t set = 0; set < head.size(); ++set) {
+            uint32_t base = set * assoc;
+            uint32_t last = NONE;
+            uint32_t length = 0;
+            for (uint32_t way = head[set]; way != NONE; way = next[base + way]) {
+                if (way >= assoc || ++length > assoc || prev[base + way] != last) {
+                    SnapshotReader::corrupt();
+                }
+                last = way;
+            }
+            if (tail[set] != last) {
+                SnapshotReader::corrupt();
+            }
+        }
+    }
+
+    void getPrintOrder(uint32_t set, const uint8_t* valid, std::vector<uint32_t>* ways) const {
+        ways->clear();
+        for (uint32_t way = head[set]; way != NONE; way = next[set * assoc + way]) {
+            ways->push_back(way);
+        }
+    }
+};
+
+// Tree pseudo-LRU
+// A binary tree of direction bits over the ways of a set; each bit points to
+// the half that was used less recently. Associativities that are not a power
+// of two use the tree of the next power of two and never walk into the
+// missing ways.
+class PLRUPolicy {
+private:
+    uint32_t assoc;
+    uint32_t leaves; // assoc rounded up to a power of two
+    std::vector<uint8_t> bits; // per set: leaves - 1 tree nodes, node i has children 2i+1 and 2i+2
+
+public:
+    void init(uint32_t setCount, uint32_t assoc) {
+        this->assoc = assoc;
+        leaves = 1;
+        while (leaves < assoc) {
+            leaves *= 2;
+        }
+        bits.assign(size_t(setCount) * (leaves - 1), 0);
+    }
+
+    // Point every node on the path to way away from it
+    void onHit(uint32_t set, uint32_t way) {
+        uint8_t* tree = &bits[size_t(set) * (leaves - 1)];
+        uint32_t node = 0, lo = 0, hi = leaves;
+        while (hi - lo > 1) {
+            uint32_t mid = (lo + hi) / 2;
+            if (way < mid) {
+                tree[node] = 1; // next victim search goes right
+                node = 2 * node + 1;
+                hi = mid;
+            }
+            else {
+                tree[node] = 0; // next victim search goes left
+                node = 2 * node + 2;
+                lo = mid;
+            }
+        }
+    }
+
+    void onFill(uint32_t set, uint32_t way) {
+        onHit(set, way);
+    }
+
+    void onInvalidate(uint32_t set, uint32_t way) {
+    }
+
+    uint32_t getVictim(uint32_t set) {
+        const uint8_t* tree = &bits[size_t(set) * (leaves - 1)];
+        uint32_t node = 0, lo = 0, hi = leaves;
+        while (hi - lo > 1) {
+            uint32_t mid = (lo + hi) / 2;
+            // The right half may hold no real ways at all
+            if (tree[node] && mid < assoc) {
+                node = 2 * node + 2;
+                lo = mid;
+            }
+            else {
+                node = 2 * node + 1;
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.putVector(bits);
+    }
+
+    void restore(SnapshotReader& in) {
+        in.getVector(&bits);
+    }
+
+    void getPrintOrder(uint32_t set, const uint8_t* valid, std::vector<uint32_t>* ways) const {
+        ways->clear();
+        for (uint32_t way = 0; way < assoc; ++way) {
+            if (valid[way]) {
+                ways->push_back(way);
+            }
+        }
+    }
+};
+
+// Not recently used
+// One reference bit per way. Referencing a block sets its bit; when that
+// would leave every bit of the set set, the others are cleared. The victim
+// is the first way whose bit is clear.
+class NRUPolicy {
+private:
+    uint32_t assoc;
+    std::vector<uint8_t> referenced; // per way
+    std::vector<uint32_t> referencedCount; // per set: number of referenced bits set
+
+public:
+    void init(uint32_t setCount, uint32_t assoc) {
+        this->assoc = assoc;
+        referenced.assign(size_t(setCount) * assoc, 0);
+        referencedCount.assign(setCount, 0);
+    }
+
+    void onHit(uint32_t set, uint32_t way) {
+        uint8_t* bits = &referenced[size_t(set) * assoc];
+        if (bits[way]) {
+            return;
+        }
+        bits[way] = 1;
+        if (++referencedCount[set] == assoc) {
+            memset(bits, 0, assoc);
+            bits[way] = 1;
+            referencedCount[set] = 1;
+        }
+    }
+
+    void onFill(uint32_t set, uint32_t way) {
+        onHit(set, way);
+    }
+
+    void onInvalidate(uint32_t set, uint32_t way) {
+        uint8_t* bits = &referenced[size_t(set) * assoc];
+        if (bits[way]) {
+            bits[way] = 0;
+            referencedCount[set]--;
+        }
+    }
+
+    uint32_t getVictim(uint32_t set) {
+        const uint8_t* bits = &referenced[size_t(set) * assoc];
+        for (uint32_t way = 0; way < assoc; ++way) {
+            if (!bits[way]) {
+                return way;
+            }
+        }
+        return 0;
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.putVector(referenced);
+        out.putVector(referencedCount);
+    }
+
+    void restore(SnapshotReader& in) {
+        in.getVector(&referenced);
+        in.getVector(&referencedCount);
+    }
+
+    void getPrintOrder(uint32_t set, const uint8_t* valid, std::vector<uint32_t>* ways) const {
+        const uint8_t* bits = &referenced[size_t(set) * assoc];
+        ways->clear();
+        for (int pass = 1; pass >= 0; --pass) {
+            for (uint32_t way = 0; way < assoc; ++way) {
+                if (valid[way] && bits[way] == pass) {
+                    ways->push_back(way);
+                }
+            }
+        }
+    }
+};
+
+// Re-reference interval prediction with 2-bit predictions (Jaleel et al.)
+// Hits predict a near re-reference (0). SRRIP fills with a long prediction
+// (2); BRRIP fills with a distant one (3) and only occasionally (1 in 32)
+// with a long one. The victim is the first way predicted distant, ageing
+// the whole set until there is one.
+template <bool Bimodal>
+class RRIPPolicy {
+private:
+    enum : uint8_t { LONG = 2, DISTANT = 3 };
+    enum : uint32_t { BIMODAL_LONG_ONE_IN = 32 };
+    uint32_t assoc;
+    std::vector<uint8_t> rrpv; // per way: re-reference prediction value
+    XorShift32 random;
+
+public:
+    void init(uint32_t setCount, uint32_t assoc) {
+        this->assoc = assoc;
+        rrpv.assign(size_t(setCount) * assoc, DISTANT);
+    }
+
+    void onFill(uint32_t set, uint32_t way) {
+        uint8_t value = LONG;
+        if (Bimodal && (random.next() % BIMODAL_LONG_ONE_IN) != 0) {
+            value = DISTANT;
+        }
+        rrpv[size_t(set) * assoc + way] = value;
+    }
+
+    void onHit(uint32_t set, uint32_t way) {
+        rrpv[size_t(set) * assoc + way] = 0;
+    }
+
+    void onInvalidate(uint32_t set, uint32_t way) {
+        rrpv[size_t(set) * assoc + way] = DISTANT;
+    }
+
+    uint32_t getVictim(uint32_t set) {
+        uint8_t* values = &rrpv[size_t(set) * assoc];
+        while (true) {
+            for (uint32_t way = 0; way < assoc; ++way) {
+                if (values[way] >= DISTANT) {
+                    return way;
+                }
+            }
+            for (uint32_t way = 0; way < assoc; ++way) {
+                values[way]++;
+            }
+        }
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.putVector(rrpv);
+        random.save(out);
+    }
+
+    void restore(SnapshotReader& in) {
+        in.getVector(&rrpv);
+        random.restore(in);
+        for (auto value : rrpv) {
+            if (value > DISTANT) {
+                SnapshotReader::corrupt();
+            }
+        }
+    }
+
+    void getPrintOrder(uint32_t set, const uint8_t* valid, std::vector<uint32_t>* ways) const {
+        const uint8_t* values = &rrpv[size_t(set) * assoc];
+        ways->clear();
+        for (uint8_t value = 0; value <= DISTANT; ++value) {
+            for (uint32_t way = 0; way < assoc; ++way) {
+                if (valid[way] && values[way] == value) {
+                    ways->push_back(way);
+                }
+            }
+        }
+    }
+};
+
+typedef RRIPPolicy<false> SRRIPPolicy;
+typedef RRIPPolicy<true> BRRIPPolicy;
+
+// Random replacement with a fixed seed
+class RandomPolicy {
+private:
+    uint32_t assoc;
+    XorShift32 random;
+
+public:
+    void init(uint32_t setCount, uint32_t assoc) {
+        this->assoc = assoc;
+    }
+
+    void onFill(uint32_t set, uint32_t way) {
+    }
+
+    void onHit(uint32_t set, uint32_t way) {
+    }
+
+    void onInvalidate(uint32_t set, uint32_t way) {
+    }
+
+    uint32_t getVictim(uint32_t set) {
+        return random.next() % assoc;
+    }
+
+    void save(SnapshotWriter& out) const {
+        random.save(out);
+    }
+
+    void restore(SnapshotReader& in) {
+        random.restore(in);
+    }
+
+    void getPrintOrder(uint32_t set, const uint8_t* valid, std::vector<uint32_t>* ways) const {
+        ways->clear();
+        for (uint32_t way = 0; way < assoc; ++way) {
+            if (valid[way]) {
+                ways->push_back(way);
+            }
+        }
+    }
+};
+
+// First in, first out: evict the block that was filled longest ago
+class FIFOPolicy {
+private:
+    uint32_t assoc;
+    uint64_t fills; // fills so far at this level
+    std::vector<uint64_t> filledAt; // per way
+
+public:
+    void init(uint32_t setCount, uint32_t assoc) {
+        this->assoc = assoc;
+        fills = 0;
+        filledAt.assign(size_t(setCount) * assoc, 0);
+    }
+
+    void onFill(uint32_t set, uint32_t way) {
+        filledAt[size_t(set) * assoc + way] = ++fills;
+    }
+
+    void onHit(uint32_t set, uint32_t way) {
+    }
+
+    void onInvalidate(uint32_t set, uint32_t way) {
+    }
+
+    uint32_t getVictim(uint32_t set) {
+        const uint64_t* stamps = &filledAt[size_t(set) * assoc];
+        uint32_t victim = 0;
+        for (uint32_t way = 1; way < assoc; ++way) {
+            if (stamps[way] < stamps[victim]) {
+                victim = way;
+            }
+        }
+        return victim;
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.put(fills);
+        out.putVector(filledAt);
+    }
+
+    void restore(SnapshotReader& in) {
+        in.get(&fills);
+        in.getVector(&filledAt);
+    }
+
+    void getPrintOrder(uint32_t set, const uint8_t* valid, std::vector<uint32_t>* ways) const {
+        const uint64_t* stamps = &filledAt[size_t(set) * assoc];
+        ways->clear();
+        for (uint32_t way = 0; way < assoc; ++way) {
+            if (valid[way]) {
+                ways->push_back(way);
+            }
+        }
+        // Newest first
+        std::sort(ways->begin(), ways->end(), [stamps](uint32_t a, uint32_t b) { return stamps[a] > stamps[b]; });
+    }
+};
@@ -0,0 +1,433 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+
+// Prefetchers
+//
+// A prefetcher at a level watches the demand requests that reach it and asks
+// for the blocks it expects to be requested next. The level fetches each of
+// them that it does not hold, from the next level as a prefetch read (which
+// L2 counts apart from its demand reads) or from main memory, and places it
+// in its set like a missed block. None of them sees a program counter:
+//    next-line  tagged next-line: a miss, or the first hit on a prefetched
+//               block, asks for the `degree` blocks after it
+//    stride     a stride detector per 64-block region: the last block and the
+//               stride between the last two; once a stride repeats, the next
+//               `degree` blocks along it are asked for
+//    region     a miss asks for up to `degree` other blocks of its aligned
+//               16-block region, nearest first, alternating after and before
+//    ampm       access map pattern matching (Ishii et al., ICS 2009): a map of
+//               the blocks accessed in each of the 64 most recently used
+//               64-block zones. For k from 1 up, block b+k is asked for if b-k
+//               and b-2k were accessed, and b-k if b+k and b+2k were, until
+//               `degree` blocks are found.
+// The stream buffers of the last level (PREF_N and PREF_M) are the existing
+// stream prefetcher; they keep their blocks apart from the sets (see cache.cpp).
+//
+// Every prefetcher is measured the same way:
+//    issued     blocks prefetched into the level
+//    useful     prefetched blocks a request hit before they left the level
+//    late       useful prefetches hit less than `latency` requests of the
+//               trace after they were issued, while they would still have
+//               been on their way
+//    unused     prefetched blocks replaced before any request hit them
+//    polluting  demand misses on blocks a prefetch had evicted; a table of
+//               the blocks evicted by prefetches finds them (the pollution
+//               filter of Srinath et al., HPCA 2007)
+// Accuracy is useful / issued and coverage is useful / (useful + demand misses).
+// The stream buffers are measured alike: their useful prefetches are the
+// misses they serve, and the blocks they drop or replace without serving one
+// are unused. As their blocks never enter the sets, they never pollute.
+// The level above a prefetcher only ever sees its demand misses, so a level
+// trains on every request at L1 and on reads at L2 (its writes are writebacks).
+
+enum PrefetcherKind {PREFETCH_NONE=0, PREFETCH_NEXT_LINE, PREFETCH_STRIDE, PREFETCH_REGION, PREFETCH_AMPM, PREFETCHER_KIND_COUNT};
+
+static const char* const prefetcherNames[PREFETCHER_KIND_COUNT] = {"none", "next-line", "stride", "region", "ampm"};
+
+// Degree of each kind unless given
+static const uint32_t prefetcherDegrees[PREFETCHER_KIND_COUNT] = {0, 1, 2, 4, 2};
+
+#define PREFETCH_MAX_DEGREE 16
+#define PREFETCH_LATENCY 8 // requests of the trace a prefetch takes to arrive unless given
+#define STRIDE_REGION_BITS 6 // 64 blocks per region of the stride detector
+#define STRIDE_TABLE_ENTRIES 64
+#define REGION_BLOCKS 16
+#define AMPM_ZONE_BITS 6 // 64 blocks per zone of the access map
+#define AMPM_ZONES 64
+#define POLLUTION_FILTER_ENTRIES 4096
+
+// Counters of one prefetcher
+typedef
+struct {
+   uint64_t issued;	// blocks prefetched into the level
+   uint64_t useful;	// ...of which a request hit before they left it
+   uint64_t late;	// ...of which the hit came less than the latency after the prefetch
+   uint64_t unused;	// prefetched blocks replaced before any request hit them
+   uint64_t polluting;	// demand misses on blocks a prefetch had evicted
+} prefetch_counters_t;
+
+// Blocks a prefetcher asks for after one request, at most PREFETCH_MAX_DEGREE
+struct PrefetchCandidates {
+    uint32_t count;
+    uint32_t blocks[PREFETCH_MAX_DEGREE];
+
+    void add(uint32_t block) {
+        blocks[count++] = block;
+    }
+};
+
+// Interface of the prefetchers; blocks are numbered by tag and index
+class Prefetcher {
+protected:
+    uint32_t degree; // most blocks asked for after one request
+
+public:
+    explicit Prefetcher(uint32_t degree) : degree(degree) {
+    }
+
+    virtual ~Prefetcher() {
+    }
+
+    // Sees a demand request for block, which missed if miss is true and hit a
+    // prefetched block for the first time if prefetchHit is; adds the blocks
+    // to prefetch to candidates
+    virtual void train(uint32_t block, bool miss, bool prefetchHit, PrefetchCandidates* candidates) = 0;
+
+    virtual void save(SnapshotWriter& out) const = 0;
+
+    virtual void restore(SnapshotReader& in) = 0;
+};
+
+class NextLinePrefetcher : public Prefetcher {
+public:
+    explicit NextLinePrefetcher(uint32_t degree) : Prefetcher(degree) {
+    }
+
+    void train(uint32_t block, bool miss, bool prefetchHit, PrefetchCandidates* candidates) {
+        if (!miss && !prefetchHit) {
+            return;
+        }
+        for (uint32_t i = 1; i <= degree; ++i) {
+            candidates->add(block + i);
+        }
+    }
+
+    void save(SnapshotWriter& out) const {
+    }
+
+    void restore(SnapshotReader& in) {
+    }
+};
+
+class StridePrefetcher : public Prefetcher {
+private:
+    std::vector<uint32_t> regions; // region of each entry, INVALID_REGION if none
+    std::vector<uint32_t> lastBlocks; // last block requested in the region
+    std::vector<int32_t> strides; // distance between the last two blocks requested
+
+    enum : uint32_t { INVALID_REGION = 0xFFFFFFFFu };
+
+public:
+    explicit StridePrefetcher(uint32_t degree)
+        : Prefetcher(degree), regions(STRIDE_TABLE_ENTRIES, INVALID_REGION), lastBlocks(STRIDE_TABLE_ENTRIES, 0),
+          strides(STRIDE_TABLE_ENTRIES, 0) {
+    }
+
+    void train(uint32_t block, bool miss, bool prefetchHit, PrefetchCandidates* candidates) {
+        uint32_t region = block >> STRIDE_REGION_BITS;
+        uint32_t entry = region % STRIDE_TABLE_ENTRIES;
+        if (regions[entry] != region) {
+            regions[entry] = region;
+            lastBlocks[entry] = block;
+            strides[entry] = 0;
+            return;
+        }
+        int32_t stride = int32_t(block - lastBlocks[entry]);
+        if (stride == 0) {
+            return;
+        }
+        lastBlocks[entry] = block;
+        if (stride != strides[entry]) {
+            strides[entry] = stride;
+            return;
+        }
+        for (uint32_t i = 1; i <= degree; ++i) {
+            candidates->add(block + uint32_t(stride) * i);
+        }
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.putVector(regions);
+        out.putVector(lastBlocks);
+        out.putVector(strides);
+    }
+
+    void restore(SnapshotReader& in) {
+        in.getVector(&regions);
+        in.getVector(&lastBlocks);
+        in.getVector(&strides);
+    }
+};
+
+class RegionPrefetcher : public Prefetcher {
+public:
+    explicit RegionPrefetcher(uint32_t degree) : Prefetcher(degree) {
+    }
+
+    void train(uint32_t block, bool miss, bool prefetchHit, PrefetchCandidates* candidates) {
+        if (!miss) {
+            return;
+        }
+        uint32_t offset = block % REGION_BLOCKS;
+        for (uint32_t distance = 1; distance < REGION_BLOCKS && candidates->count < degree; ++distance) {
+            if (offset + distance < REGION_BLOCKS) {
+                candidates->add(block + distance);
+            }
+            if (offset >= distance && candidates->count < degree) {
+                candidates->add(block - distance);
+            }
+        }
+    }
+
+    void save(SnapshotWriter& out) const {
+    }
+
+    void restore(SnapshotReader& in) {
+    }
+};
+
+class AMPMPrefetcher : public Prefetcher {
+private:
+    enum : uint8_t { BLOCK_INIT = 0, BLOCK_ACCESSED, BLOCK_PREFETCHED };
+    enum : uint32_t { ZONE_BLOCKS = 1u << AMPM_ZONE_BITS, INVALID_ZONE = 0xFFFFFFFFu };
+
+    uint64_t stamp; // advances on every request, for the recency of the zones
+    std::vector<uint32_t> zones; // zone of each map, INVALID_ZONE if none
+    std::vector<uint64_t> lastUse; // value of stamp when the map was last used
+    std::vector<uint8_t> maps; // ZONE_BLOCKS states per map, map after map
+
+    // Map of zone, replacing the least recently used one if there is none
+    uint8_t* getMap(uint32_t zone) {
+        uint32_t entry = findTag(zones.data(), AMPM_ZONES, zone);
+        if (entry == AMPM_ZONES) {
+            entry = 0;
+            for (uint32_t i = 1; i < AMPM_ZONES; ++i) {
+                if (lastUse[i] < lastUse[entry]) {
+                    entry = i;
+                }
+            }
+            zones[entry] = zone;
+            memset(&maps[size_t(entry) * ZONE_BLOCKS], BLOCK_INIT, ZONE_BLOCKS);
+        }
+        lastUse[entry] = ++stamp;
+        return &maps[size_t(entry) * ZONE_BLOCKS];
+    }
+
+public:
+    explicit AMPMPrefetcher(uint32_t degree)
+        : Prefetcher(degree), stamp(0), zones(AMPM_ZONES, INVALID_ZONE), lastUse(AMPM_ZONES, 0),
+          maps(size_t(AMPM_ZONES) * ZONE_BLOCKS, BLOCK_INIT) {
+    }
+
+    void train(uint32_t block, bool miss, bool prefetchHit, PrefetchCandidates* candidates) {
+        uint8_t* map = this->getMap(block >> AMPM_ZONE_BITS);
+        uint32_t offset = block % ZONE_BLOCKS;
+        map[offset] = BLOCK_ACCESSED;
+        for (uint32_t k = 1; k <= ZONE_BLOCKS / 2 && candidates->count < degree; ++k) {
+            if (offset + k < ZONE_BLOCKS && offset >= 2 * k && map[offset + k] == BLOCK_INIT
+                && map[offset - k] == BLOCK_ACCESSED && map[offset - 2 * k] == BLOCK_ACCESSED) {
+                map[offset + k] = BLOCK_PREFETCHED;
+                candidates->add(block + k);
+            }
+            if (candidates->count < degree && offset >= k && offset + 2 * k < ZONE_BLOCKS && map[offset - k] == BLOCK_INIT
+                && map[offset + k] == BLOCK_ACCESSED && map[offset + 2 * k] == BLOCK_ACCESSED) {
+                map[offset - k] = BLOCK_PREFETCHED;
+                candidates->add(block - k);
+            }
+        }
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.put(stamp);
+        out.putVector(zones);
+        out.putVector(lastUse);
+        out.putVector(maps);
+    }
+
+    void restore(SnapshotReader& in) {
+        in.get(&stamp);
+        in.getVector(&zones);
+        in.getVector(&lastUse);
+        in.getVector(&maps);
+    }
+};
+
+// The prefetcher of one level and what it needs to be measured: which blocks
+// of the level arrived by prefetch and have not been hit yet, when each was
+// prefetched, and the pollution filter. Blocks are identified by their
+// position in the tag store of the level, set * assoc + way.
+class PrefetchUnit {
+private:
+    uint32_t kind; // a PrefetcherKind
+    uint32_t degree;
+    uint32_t latency; // requests of the trace a prefetch takes to arrive
+    const uint64_t* clock; // requests of the trace issued so far
+    Prefetcher* prefetcher;
+    std::vector<uint8_t> prefetched; // 1 for positions holding a prefetched block no request has hit yet
+    std::vector<uint32_t> issuedAt; // low 32 bits of the clock when the block at the position was prefetched
+    std::vector<uint32_t> filter; // blocks evicted by prefetches, by hash; INVALID_BLOCK if none
+
+    enum : uint32_t { INVALID_BLOCK = 0xFFFFFFFFu };
+
+    static uint32_t hash(uint32_t block) {
+        return (block ^ (block >> 12)) % POLLUTION_FILTER_ENTRIES;
+    }
+
+public:
+    prefetch_counters_t counters;
+    PrefetchCandidates candidates; // blocks asked for after the last request
+
+    PrefetchUnit(uint32_t kind, uint32_t degree, uint32_t latency, const uint64_t* clock, uint32_t blockCount)
+        : kind(kind), degree(degree), latency(latency), clock(clock), prefetcher(nullptr),
+          prefetched(blockCount, 0), issuedAt(blockCount, 0), filter(POLLUTION_FILTER_ENTRIES, INVALID_BLOCK) {
+        switch (kind) {
+            case PREFETCH_NEXT_LINE:
+                prefetcher = new NextLinePrefetcher(degree);
+                break;
+            case PREFETCH_STRIDE:
+                prefetcher = new StridePrefetcher(degree);
+                break;
+            case PREFETCH_REGION:
+                prefetcher = new RegionPrefetcher(degree);
+                break;
+            case PREFETCH_AMPM:
+                prefetcher = new AMPMPrefetcher(degree);
+                break;
+            default:
+                printf("Error: Unknown prefetcher %u.\n", kind);
+                exit(EXIT_FAILURE);
+        }
+        memset(&counters, 0, sizeof(counters));
+        candidates.count = 0;
+    }
+
+    ~PrefetchUnit() {
+        delete prefetcher;
+    }
+
+    PrefetchUnit(const PrefetchUnit&) = delete;
+    PrefetchUnit& operator=(const PrefetchUnit&) = delete;
+
+    uint32_t getKind() const {
+        return kind;
+    }
+
+    uint32_t getDegree() const {
+        return degree;
+    }
+
+    uint32_t getLatency() const {
+        return latency;
+    }
+
+    bool isPrefetched(uint32_t position) const {
+        return prefetched[position] != 0;
+    }
+
+    // A request hit the block at position; returns true if that block was prefetched and not hit before
+    bool hit(uint32_t position) {
+        if (prefetched[position] == 0) {
+            return false;
+        }
+        prefetched[position] = 0;
+        counters.useful++;
+        if (uint32_t(*clock) - issuedAt[position] < latency) {
+            counters.late++;
+        }
+        return true;
+    }
+
+    // A block was placed at position, by a prefetch if byPrefetch; a prefetched
+    // block that was there before left the level unused
+    void fill(uint32_t position, bool byPrefetch) {
+        if (prefetched[position] != 0) {
+            counters.unused++;
+        }
+        prefetched[position] = byPrefetch ? 1 : 0;
+        if (byPrefetch) {
+            counters.issued++;
+            issuedAt[position] = uint32_t(*clock);
+        }
+    }
+
+    // A prefetch evicted block, which a demand request had brought in
+    void evictedByPrefetch(uint32_t block) {
+        filter[hash(block)] = block;
+    }
+
+    // A demand request missed block; counts a polluting prefetch if a prefetch evicted it
+    void demandMiss(uint32_t block) {
+        uint32_t& entry = filter[hash(block)];
+        if (entry == block) {
+            counters.polluting++;
+            entry = INVALID_BLOCK;
+        }
+    }
+
+    // Trains the prefetcher on a demand request; the blocks it asks for are left in candidates
+    void train(uint32_t block, bool miss, bool prefetchHit) {
+        candidates.count = 0;
+        prefetcher->train(block, miss, prefetchHit, &candidates);
+    }
+
+    void save(SnapshotWriter& out) const {
+        prefetcher->save(out);
+        out.putVector(prefetched);
+        out.putVector(issuedAt);
+        out.putVector(filter);
+        out.put(counters);
+    }
+
+    void restore(SnapshotReader& in) {
+        prefetcher->restore(in);
+        in.getVector(&prefetched);
+        in.getVector(&issuedAt);
+        in.getVector(&filter);
+        in.get(&counters);
+    }
+};
+
+// Looks up a prefetcher by name; returns false if there is no such prefetcher
+static bool parsePrefetcherKind(const char* name, size_t length, uint32_t* kind) {
+    for (uint32_t i = PREFETCH_NONE + 1; i < PREFETCHER_KIND_COUNT; ++i) {
+        if (strlen(prefetcherNames[i]) == length && strncmp(name, prefetcherNames[i], length) == 0) {
+            *kind = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses "L1:KIND", "L2:KIND", "L1:KIND:DEGREE" or "L2:KIND:DEGREE"; returns false on anything else
+static bool parsePrefetcher(const char* text, uint32_t* level, uint32_t* kind, uint32_t* degree) {
+    if (text[0] != 'L' || (text[1] != '1' && text[1] != '2') || text[2] != ':') {
+        return false;
+    }
+    *level = uint32_t(text[1] - '0');
+    const char* name = text + 3;
+    const char* colon = strchr(name, ':');
+    if (!parsePrefetcherKind(name, (colon != nullptr) ? size_t(colon - name) : strlen(name), kind)) {
+        return false;
+    }
+    *degree = prefetcherDegrees[*kind];
+    if (colon == nullptr) {
+        return true;
+    }
+    char* end;
+    unsigned long value = strtoul(colon + 1, &end, 10);
+    *degree = uint32_t(value);
+    return end != colon + 1 && *end == '\0' && value >= 1 && value <= PREFETCH_MAX_DEGREE;
+}
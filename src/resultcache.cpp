@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include "xxhash.cpp"
+
+// Persistent result cache for sweeps
+//
+// With --result-cache=DIR a sweep looks every configuration up in DIR before
+// simulating it, simulates only the ones it does not find and stores their
+// results there, so rerunning a sweep with a few new points only simulates
+// those. A result is keyed by
+//    - RESULT_CACHE_ENGINE_VERSION
+//    - the XXH64 digest (xxhash.cpp, shared with the snapshots) and the
+//      length of the trace file's bytes
+//    - the configuration: cache_params_t and every option that changes the
+//      result rows (victim and miss caches, inclusion, write policies and
+//      buffers, prefetchers, timing and DRAM)
+// and kept in DIR/<XXH64 of the key, in hex>.res:
+//    bytes 0-3    magic "CRES"
+//    bytes 4-5    format version (RESULT_CACHE_VERSION)
+//    bytes 6-7    reserved, 0
+//    bytes 8-15   XXH64 of the rest of the file
+//    then the key (result_key_t) and the results (sim_results_t)
+// An entry is written to a temporary file in DIR and renamed into place, so
+// concurrent sweeps can share a directory: a reader sees a whole entry or
+// none, and two writers of the same entry store the same results. An entry
+// that is truncated or corrupt, or whose key differs from the one looked up,
+// counts as not found and is overwritten.
+// A change to the simulator that changes any result must bump
+// RESULT_CACHE_ENGINE_VERSION; entries of other versions are then never found.
+
+#define RESULT_CACHE_MAGIC "CRES"
+#define RESULT_CACHE_VERSION 2
+#define RESULT_CACHE_ENGINE_VERSION 2
+#define RESULT_CACHE_HEADER_SIZE 16
+// Bytes of the trace file hashed at a time
+#define RESULT_CACHE_READ_SIZE (1 << 20)
+
+// What a cached result is looked up by; fields an option does not use are 0
+typedef
+struct {
+   uint64_t engineVersion;	// RESULT_CACHE_ENGINE_VERSION
+   uint64_t traceDigest;	// XXH64 of the trace file...
+   uint64_t traceBytes;		// ...and its length
+   cache_params_t params;
+   uint32_t assistKind[2];
+   uint32_t assistEntries[2];
+   uint32_t inclusion;
+   uint32_t writePolicy[2];
+   uint32_t writeBufferEntries[2];
+   uint32_t writeBufferDrain;
+   uint32_t prefetcherKind[2];
+   uint32_t prefetcherDegree[2];
+   uint32_t prefetchLatency;
+   uint32_t timing;
+   uint32_t hitLatency[2];
+   uint32_t memoryLatency;
+   uint32_t mshrs[2];
+   uint32_t dram;
+   uint32_t padding;
+   dram_params_t dramParams;
+} result_key_t;
+
+class ResultCache {
+private:
+    std::string directory;
+    uint64_t traceDigest;
+    uint64_t traceBytes;
+    std::vector<uint8_t> entry; // the entry being read or written
+
+    static const size_t ENTRY_SIZE = RESULT_CACHE_HEADER_SIZE + sizeof(result_key_t) + sizeof(sim_results_t);
+
+    result_key_t makeKey(const cache_params_t& params, const sim_options_t& options) const {
+        result_key_t key;
+        memset(&key, 0, sizeof(key)); // the padding is hashed and compared too
+        key.engineVersion = RESULT_CACHE_ENGINE_VERSION;
+        key.traceDigest = traceDigest;
+        key.traceBytes = traceBytes;
+        key.params = params;
+        for (int level = 0; level < 2; ++level) {
+            key.assistKind[level] = options.assistKind[level];
+            key.assistEntries[level] = (options.assistKind[level] != ASSIST_NONE) ? options.assistEntries[level] : 0;
+            key.writePolicy[level] = options.writePolicy[level];
+            key.writeBufferEntries[level] = options.writeBufferEntries[level];
+            key.prefetcherKind[level] = options.prefetcherKind[level];
+            key.prefetcherDegree[level] = (options.prefetcherKind[level] != PREFETCH_NONE) ? options.prefetcherDegree[level] : 0;
+        }
+        key.inclusion = options.inclusion;
+        key.writeBufferDrain = options.writeBufferDrain;
+        key.prefetchLatency = options.prefetchLatency;
+        if (options.timing) {
+            key.timing = 1;
+            key.hitLatency[0] = options.hitLatency[0];
+            key.hitLatency[1] = options.hitLatency[1];
+            key.memoryLatency = options.memoryLatency;
+            key.mshrs[0] = options.mshrs[0];
+            key.mshrs[1] = options.mshrs[1];
+        }
+        if (options.dram) {
+            key.dram = 1;
+            key.dramParams = options.dramParams;
+        }
+        return key;
+    }
+
+    std::string getPath(const result_key_t& key) const {
+        char name[32];
+        snprintf(name, sizeof(name), "/%016" PRIx64 ".res", Xxh64::of(&key, sizeof(key)));
+        return directory + name;
+    }
+
+public:
+    ResultCache() : traceDigest(0), traceBytes(0) {
+    }
+
+    // Uses directory, creating it if needed, for the results of the trace
+    // file at tracePath; returns false with an error printed if either
+    // cannot be used
+    bool open(const char* path, const char* tracePath) {
+        directory = path;
+        // Create the missing directories of the path one after another, like mkdir -p
+        for (size_t slash = directory.find('/', 1); slash != std::string::npos; slash = directory.find('/', slash + 1)) {
+            mkdir(directory.substr(0, slash).c_str(), 0777);
+        }
+        if (mkdir(path, 0777) != 0 && errno != EEXIST) {
+            printf("Error: Unable to create the result cache directory %s\n", path);
+            return false;
+        }
+        if (strcmp(tracePath, "-") == 0) {
+            printf("Error: --result-cache needs a trace file, not standard input.\n");
+            return false;
+        }
+        int fd = ::open(tracePath, O_RDONLY);
+        if (fd < 0) {
+            printf("Error: Unable to open file %s\n", tracePath);
+            return false;
+        }
+        std::vector<uint8_t> buffer(RESULT_CACHE_READ_SIZE);
+        Xxh64 hash;
+        ssize_t count;
+        traceBytes = 0;
+        while ((count = read(fd, buffer.data(), buffer.size())) > 0) {
+            hash.update(buffer.data(), size_t(count));
+            traceBytes += uint64_t(count);
+        }
+        ::close(fd);
+        if (count < 0) {
+            printf("Error: Unable to read file %s\n", tracePath);
+            return false;
+        }
+        traceDigest = hash.digest();
+        entry.resize(ENTRY_SIZE);
+        return true;
+    }
+
+    // Looks up the results of a configuration; returns false if they are not cached
+    bool find(const cache_params_t& params, const sim_options_t& options, sim_results_t* results) {
+        result_key_t key = this->makeKey(params, options);
+        FILE* fp = fopen(this->getPath(key).c_str(), "rb");
+        if (fp == (FILE *) NULL) {
+            return false;
+        }
+        // One byte more than an entry shows up a longer file
+        entry.resize(ENTRY_SIZE + 1);
+        size_t length = fread(entry.data(), 1, entry.size(), fp);
+        fclose(fp);
+        uint16_t version;
+        memcpy(&version, entry.data() + 4, sizeof(version));
+        uint64_t checksum;
+        memcpy(&checksum, entry.data() + 8, sizeof(checksum));
+        const uint8_t* body = entry.data() + RESULT_CACHE_HEADER_SIZE;
+        if (length != ENTRY_SIZE || memcmp(entry.data(), RESULT_CACHE_MAGIC, 4) != 0 || version != RESULT_CACHE_VERSION
+            || checksum != Xxh64::of(body, ENTRY_SIZE - RESULT_CACHE_HEADER_SIZE) || memcmp(body, &key, sizeof(key)) != 0) {
+            return false;
+        }
+        memcpy(results, body + sizeof(key), sizeof(*results));
+        return true;
+    }
+
+    // Stores the results of a configuration; warns and carries on if they cannot be written
+    void store(const cache_params_t& params, const sim_options_t& options, const sim_results_t& results) {
+        result_key_t key = this->makeKey(params, options);
+        entry.assign(ENTRY_SIZE, 0);
+        uint16_t version = RESULT_CACHE_VERSION;
+        memcpy(entry.data(), RESULT_CACHE_MAGIC, 4);
+        memcpy(entry.data() + 4, &version, sizeof(version));
+        uint8_t* body = entry.data() + RESULT_CACHE_HEADER_SIZE;
+        memcpy(body, &key, sizeof(key));
+        memcpy(body + sizeof(key), &results, sizeof(results));
+        uint64_t checksum = Xxh64::of(body, ENTRY_SIZE - RESULT_CACHE_HEADER_SIZE);
+        memcpy(entry.data() + 8, &checksum, sizeof(checksum));
+
+        std::string path = this->getPath(key);
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), ".%ld.tmp", long(getpid()));
+        std::string temporary = path + suffix;
+        FILE* fp = fopen(temporary.c_str(), "wb");
+        bool ok = fp != (FILE *) NULL && fwrite(entry.data(), 1, entry.size(), fp) == entry.size();
+        ok = (fp != (FILE *) NULL && fclose(fp) == 0) && ok;
+        if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+            unlink(temporary.c_str());
+            fprintf(stderr, "Warning: Unable to write %s to the result cache\n", path.c_str());
+        }
+    }
+};
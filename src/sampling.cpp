@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+// Set sampling
+//
+// A sampled simulation keeps only a subset of the sets and drops every
+// request that maps anywhere else, so its cost scales with the sampling
+// ratio. The unit of sampling is a value of the low index bits shared by
+// every level (the index of the level with the fewest sets): all blocks of
+// a sampled unit go to sampled sets at every level, writebacks included, so
+// the sets that are kept see exactly the traffic they see in a full run.
+//
+// Each sampled unit is one observation of a cluster sample. Miss rates are
+// estimated as the ratio of misses to accesses over the sampled units, and
+// totals such as memory traffic by scaling the per-unit mean up to every
+// unit. Both come with a 95% confidence interval from the spread between
+// units: Student's t, with the finite population correction for the units
+// that were not sampled.
+
+enum SampleSelection {SAMPLE_STRIDED=0, SAMPLE_RANDOM};
+
+// Two-sided 95% quantile of Student's t distribution with the given degrees of freedom
+// A handful of sampled units is common, where the normal 1.96 would be far too optimistic
+static double studentT95(uint32_t degrees) {
+    static const double quantiles[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (degrees == 0) {
+        return 0.0;
+    }
+    if (degrees <= 30) {
+        return quantiles[degrees - 1];
+    }
+    // Within 0.003 of the exact quantile beyond 30 degrees of freedom
+    return 1.96 + 2.4 / degrees;
+}
+
+// Counters of one sampled unit
+typedef
+struct {
+   uint64_t l1Accesses;
+   uint64_t l1Misses;
+   uint64_t l2Reads;
+   uint64_t l2ReadMisses;
+   uint64_t memTraffic;
+} sample_counters_t;
+
+// An estimate and the half width of its 95% confidence interval
+typedef
+struct {
+   double value;
+   double halfWidth;
+} sample_estimate_t;
+
+class SetSampler {
+public:
+    enum : uint32_t { NOT_SAMPLED = 0xFFFFFFFFu };
+
+private:
+    uint32_t unitMask; // unit of a set index
+    uint32_t selection; // a SampleSelection
+    std::vector<uint32_t> slots; // slots[unit]: position of the unit among the sampled ones, or NOT_SAMPLED
+    std::vector<uint32_t> units; // sampled units in slot order
+    std::vector<sample_counters_t> counters; // counters[slot]
+
+    void addUnit(uint32_t unit) {
+        slots[unit] = uint32_t(units.size());
+        units.push_back(unit);
+    }
+
+    // Ratio of two counters summed over the sampled units
+    sample_estimate_t estimateRatio(uint64_t sample_counters_t::*numerator, uint64_t sample_counters_t::*denominator) const {
+        sample_estimate_t estimate = {0.0, 0.0};
+        double n = double(counters.size());
+        double sumNumerator = 0.0, sumDenominator = 0.0;
+        for (auto& unit : counters) {
+            sumNumerator += double(unit.*numerator);
+            sumDenominator += double(unit.*denominator);
+        }
+        if (sumDenominator == 0.0) {
+            return estimate;
+        }
+        estimate.value = sumNumerator / sumDenominator;
+        // Linearised variance of a ratio estimator
+        double residuals = 0.0;
+        for (auto& unit : counters) {
+            double residual = double(unit.*numerator) - estimate.value * double(unit.*denominator);
+            residuals += residual * residual;
+        }
+        double meanDenominator = sumDenominator / n;
+        double variance = (1.0 - this->getFraction()) * residuals / ((n - 1.0) * n * meanDenominator * meanDenominator);
+        estimate.halfWidth = studentT95(uint32_t(n) - 1) * sqrt(variance);
+        return estimate;
+    }
+
+    // Total of a counter over every unit
+    sample_estimate_t estimateTotal(uint64_t sample_counters_t::*counter) const {
+        double n = double(counters.size());
+        double sum = 0.0, sumSquares = 0.0;
+        for (auto& unit : counters) {
+            sum += double(unit.*counter);
+            sumSquares += double(unit.*counter) * double(unit.*counter);
+        }
+        double mean = sum / n;
+        double spread = (sumSquares - n * mean * mean) / (n - 1.0);
+        double unitCount = double(slots.size());
+        sample_estimate_t estimate;
+        estimate.value = unitCount * mean;
+        estimate.halfWidth = studentT95(uint32_t(n) - 1) * unitCount * sqrt((1.0 - this->getFraction()) * (spread > 0.0 ? spread : 0.0) / n);
+        return estimate;
+    }
+
+public:
+    // Samples a fraction ratio of the 2^unitBits units, evenly spaced or
+    // drawn with the given seed; exits if fewer than two units would be sampled
+    SetSampler(uint32_t unitBits, double ratio, uint32_t selection, uint32_t seed) : selection(selection) {
+        uint32_t unitCount = 1u << unitBits;
+        unitMask = unitCount - 1;
+        uint32_t sampleCount = uint32_t(ratio * unitCount + 0.5);
+        if (sampleCount > unitCount) {
+            sampleCount = unitCount;
+        }
+        if (sampleCount < 2) {
+            printf("Error: Set sampling at ratio %g keeps %u of %u sets; at least 2 are needed.\n", ratio, sampleCount, unitCount);
+            exit(EXIT_FAILURE);
+        }
+        slots.assign(unitCount, NOT_SAMPLED);
+        units.reserve(sampleCount);
+        if (selection == SAMPLE_RANDOM) {
+            // Partial Fisher-Yates shuffle: the first sampleCount units drawn
+            std::vector<uint32_t> order(unitCount);
+            for (uint32_t unit = 0; unit < unitCount; ++unit) {
+                order[unit] = unit;
+            }
+            XorShift32 random(seed);
+            for (uint32_t i = 0; i < sampleCount; ++i) {
+                uint32_t pick = i + random.next() % (unitCount - i);
+                std::swap(order[i], order[pick]);
+                this->addUnit(order[i]);
+            }
+        }
+        else {
+            for (uint32_t i = 0; i < sampleCount; ++i) {
+                this->addUnit(uint32_t(uint64_t(i) * unitCount / sampleCount));
+            }
+        }
+        counters.assign(sampleCount, sample_counters_t());
+    }
+
+    // Slot of the unit of a set index, or NOT_SAMPLED if the set is not simulated
+    uint32_t getSlot(uint32_t index) const {
+        return slots[index & unitMask];
+    }
+
+    bool isSampled(uint32_t index) const {
+        return slots[index & unitMask] != NOT_SAMPLED;
+    }
+
+    sample_counters_t& getCounters(uint32_t slot) {
+        return counters[slot];
+    }
+
+    uint32_t getUnitCount() const {
+        return uint32_t(slots.size());
+    }
+
+    uint32_t getSampledCount() const {
+        return uint32_t(units.size());
+    }
+
+    double getFraction() const {
+        return double(units.size()) / double(slots.size());
+    }
+
+    // Prints the estimates of a sampled simulation of requestCount requests
+    void printEstimates(bool hasL2, uint64_t requestCount) const {
+        uint64_t simulated = 0;
+        for (auto& unit : counters) {
+            simulated += unit.l1Accesses;
+        }
+        printf("===== Sampled estimates =====\n");
+        printf("sampled sets:                 %u of %u (%s)\n", this->getSampledCount(), this->getUnitCount(),
+               selection == SAMPLE_RANDOM ? "random" : "strided");
+        printf("requests simulated:           %" PRIu64 " of %" PRIu64 "\n", simulated, requestCount);
+        sample_estimate_t estimate = this->estimateRatio(&sample_counters_t::l1Misses, &sample_counters_t::l1Accesses);
+        printf("L1 miss rate:                 %.4f +/- %.4f\n", estimate.value, estimate.halfWidth);
+        if (hasL2) {
+            estimate = this->estimateRatio(&sample_counters_t::l2ReadMisses, &sample_counters_t::l2Reads);
+            printf("L2 miss rate:                 %.4f +/- %.4f\n", estimate.value, estimate.halfWidth);
+        }
+        estimate = this->estimateTotal(&sample_counters_t::memTraffic);
+        printf("memory traffic:               %.0f +/- %.0f\n", estimate.value, estimate.halfWidth);
+        printf("(+/- is the half width of a 95%% confidence interval)\n");
+    }
+};
+
+// Parses "strided", "random" or "random:SEED"; returns false on anything else
+static bool parseSampleSelection(const char* text, uint32_t* selection, uint32_t* seed) {
+    if (strcmp(text, "strided") == 0) {
+        *selection = SAMPLE_STRIDED;
+        return true;
+    }
+    if (strncmp(text, "random", 6) != 0) {
+        return false;
+    }
+    *selection = SAMPLE_RANDOM;
+    if (text[6] == '\0') {
+        return true;
+    }
+    char* end;
+    *seed = (uint32_t) strtoul(text + 7, &end, 10);
+    return text[6] == ':' && end != text + 7 && *end == '\0';
+}
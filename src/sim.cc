@@ -1,9 +1,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
 #include <typeinfo>
 #include "sim.h"
+#include "alloccount.cpp"
 #include "cache.cpp"
+#include "trace.cpp"
+#include "pipeline.cpp"
+#include "hierarchy.cpp"
+#include "interval.cpp"
+#include "coherence.cpp"
+#include "resultcache.cpp"
+#include "sweep.cpp"
+#include "stackdist.cpp"
+
+// Most worker threads --threads can ask for, as in tracegen
+#define SIM_MAX_THREADS 1024
 
 /*  "argc" holds the number of command-line arguments.
     "argv[]" holds the arguments themselves.
@@ -15,34 +30,740 @@
     argv[1] = "32"
     argv[2] = "8192"
     ... and so on
+
+    The trace file may be a text trace or a binary trace written by trace2bin,
+    either of them gzip or zstd compressed, or "-" to read the trace from standard input.
+
+    Multi-core mode simulates one private L1 per core and a shared L2, kept
+    coherent with MESI (see src/coherence.cpp); every request of the trace
+    names the core that issued it ("3 r 7b0335b8"):
+    ./sim --cores=4 32 8192 4 262144 8 0 0 threads_trace.txt
+
+    Sweep mode simulates many configurations over a single pass of the trace
+    and prints one CSV row per configuration (see src/sweep.cpp for the spec format):
+    ./sim --sweep=sweep.txt [--sweep-out=results.csv] gcc_trace.txt
+
+    Options start with "--" and may appear anywhere on the command line:
+    --sweep=FILE           run the configurations listed in FILE instead of the one given as arguments
+    --sweep-out=FILE       write the sweep results to FILE instead of stdout
+    --result-cache=DIR     keep the sweep's results in the directory DIR and only simulate the configurations
+                           not found there (see src/resultcache.cpp)
+    --threads=N            simulate the sweep, or the cores of --cores, on N worker threads (0: one per
+                           hardware thread)
+    --cores=N              simulate N cores with private L1s and a shared L2, kept coherent with MESI
+    --policy=NAME          replacement policy of every level: lru (default), plru, nru, srrip,
+                           brrip, random or fifo; in a sweep, the policy of lines that name none
+    --mrc=B:MAX            print L1 miss counts of every LRU cache up to MAX bytes
+                           with B byte blocks, from one stack-distance analysis of the trace
+    --sample=RATIO         simulate only this fraction of the sets (e.g. 0.0625 or 1/16) and print
+                           estimated miss rates and memory traffic with 95% confidence intervals
+    --sample-select=S      which sets are sampled: strided (default, evenly spaced) or random[:SEED]
+    --classify-misses[=FILE]
+                           count the compulsory, capacity and conflict misses of every level, and
+                           write them per set as CSV to FILE if given
+    --victim-cache=L:N     add an N entry victim cache to level L, L1 or L2 (see src/assist.cpp)
+    --miss-cache=L:N       add an N entry miss cache to level L instead
+    --inclusion=P          what L2 holds of L1: nine (default, non-inclusive non-exclusive), inclusive
+                           (with back-invalidation of L1) or exclusive (L2 holds L1's victims)
+    --write-policy=[L:]P   write policy of level L, or of every level: wbwa (default), wbna, wtwa or
+                           wtna (write-back or -through, write-allocate or not; see src/writebuf.cpp)
+    --write-buffer=L:N     buffer the writes level L passes on in an N entry coalescing write buffer
+    --write-buffer-drain=K the write buffers drain one entry every K requests of the trace (default 4)
+    --prefetcher=L:KIND[:D]
+                           prefetch into the sets of level L: next-line, stride, region or ampm, asking
+                           for up to D blocks at a time (see src/prefetch.cpp)
+    --prefetch-latency=K   a prefetch hit less than K requests after it was issued counts as late (default 8)
+    --prefetch-stats       print the counters of the prefetchers, the stream buffers included, even without
+                           --prefetcher
+    --timing               time every request with hit latencies, MSHRs at L1 and L2 and a memory latency,
+                           and print the AMAT, the stall cycles and the MSHR occupancy (see src/timing.cpp)
+    --hit-latency=L:C      level L hits in C cycles (default: derived from its size and associativity)
+    --memory-latency=C     a block comes from memory C cycles after the last level misses (default 100)
+    --mshrs=L:N            level L has N MSHRs, 1 to 64 (default 8 at L1 and 16 at L2)
+                           --hit-latency, --memory-latency and --mshrs imply --timing
+    --dram[=C:B:R]         time main memory with a DRAM model of C channels of B banks with R byte rows
+                           (default 1:16:8192) instead of --memory-latency (see src/dram.cpp)
+    --dram-timing=CAS:RCD:RP
+                           DRAM timings in core cycles (default 42:42:42)
+    --dram-bandwidth=B     a DRAM channel moves at most B bytes per cycle (default 6.4)
+    --dram-queue=N         each channel's controller queue holds N requests (default 32)
+    --dram-scheduler=S     the controller serves requests frfcfs (default, row hits first) or fcfs
+                           the --dram options imply --timing
+    --interval=K           print what every counter grew by in each interval of K requests as a time series
+    --interval-out=FILE    write the time series to FILE instead of stdout
+    --interval-format=F    format of the time series: csv (default) or json (one object per line)
+    --checkpoint=FILE      write the complete cache state to the snapshot FILE (see src/snapshot.cpp)...
+    --checkpoint-at=N      ...after the first N requests of the trace instead of at its end
+    --restore=FILE         start from the cache state in the snapshot FILE and simulate the trace from the
+                           request after the snapshot on; with --sweep the snapshot holds every configuration
+    --report-rss           print the simulator's peak resident set size to stderr on exit
+    --trace-level=L        only trace level L: 0 (the requests), 1 or 2 (repeat for several levels)
+    --trace-sets=LO:HI     only trace sets LO through HI
+    --trace-addrs=LO:HI    only trace addresses LO through HI (hex)
+    --trace-out=FILE       write the trace to FILE instead of stdout
+    Tracing is compiled out unless the simulator is built with "make DEBUG=1".
 */
+
+// Parses one end of a range, from 0 to UINT32_MAX, and sets *end past it
+// strtoull() alone would also take a sign or leading spaces
+static bool parseRangeEnd(const char* text, int base, char** end, uint32_t* value) {
+   if (!isxdigit((unsigned char) text[0]) || (base == 10 && !isdigit((unsigned char) text[0]))) {
+      return false;
+   }
+   errno = 0;
+   unsigned long long parsed = strtoull(text, end, base);
+   *value = uint32_t(parsed);
+   return errno == 0 && parsed <= UINT32_MAX;
+}
+
+// Parses "LO:HI" into an inclusive range; returns false on malformed input
+static bool parseRange(const char* text, int base, uint32_t* lo, uint32_t* hi) {
+   char* end;
+   if (!parseRangeEnd(text, base, &end, lo) || *end != ':') {
+      return false;
+   }
+   return parseRangeEnd(end + 1, base, &end, hi) && *end == '\0' && *lo <= *hi;
+}
+
+// Parses "L1:VALUE" or "L2:VALUE" with VALUE from min to max; returns false on anything else
+static bool parseLevelValue(const char* text, uint32_t min, uint32_t max, uint32_t* level, uint32_t* value) {
+   // strtoul() would also take a sign or leading spaces
+   if (text[0] != 'L' || (text[1] != '1' && text[1] != '2') || text[2] != ':' || !isdigit((unsigned char) text[3])) {
+      return false;
+   }
+   *level = uint32_t(text[1] - '0');
+   char* end;
+   unsigned long parsed = strtoul(text + 3, &end, 10);
+   *value = uint32_t(parsed);
+   return end != text + 3 && *end == '\0' && parsed >= min && parsed <= max;
+}
+
+// Handles one "--trace-*" option; returns false if it is not recognised
+static bool parseTraceOption(const char* option) {
+   uint32_t lo, hi;
+   if (strncmp(option, "--trace-level=", 14) == 0) {
+      char* end;
+      unsigned long level = strtoul(option + 14, &end, 10);
+      if (!isdigit((unsigned char) option[14]) || *end != '\0' || level > DEBUG_MAX_LEVEL) {
+         printf("Error: --trace-level expects 0 (the requests of the trace), 1 or 2.\n");
+         exit(EXIT_FAILURE);
+      }
+      debugFilter.addLevel(uint32_t(level));
+   }
+   else if (strncmp(option, "--trace-sets=", 13) == 0 && parseRange(option + 13, 10, &lo, &hi)) {
+      debugFilter.setSetRange(lo, hi);
+   }
+   else if (strncmp(option, "--trace-addrs=", 14) == 0 && parseRange(option + 14, 16, &lo, &hi)) {
+      debugFilter.setAddrRange(lo, hi);
+   }
+   else if (strncmp(option, "--trace-out=", 12) == 0) {
+      if (!debugSink.open(option + 12)) {
+         printf("Error: Unable to open file %s\n", option + 12);
+         exit(EXIT_FAILURE);
+      }
+   }
+   else {
+      return false;
+   }
+   if (!DEBUG) {
+      fprintf(stderr, "Warning: %s ignored; tracing is compiled out (rebuild with make DEBUG=1)\n", option);
+   }
+   return true;
+}
+
+// Prints the peak resident set size of this process to stderr
+// VmHWM covers only this program's address space; getrusage() would also
+// count what the process that started it had resident when it forked.
+static void reportPeakRSS() {
+   FILE* fp = fopen("/proc/self/status", "r");
+   if (fp == (FILE *) NULL) {
+      return;
+   }
+   char line[256];
+   while (fgets(line, sizeof(line), fp) != NULL) {
+      unsigned long kb;
+      if (sscanf(line, "VmHWM: %lu kB", &kb) == 1) {
+         fprintf(stderr, "peak_rss_kb: %lu\n", kb);
+         break;
+      }
+   }
+   fclose(fp);
+}
+
+// Handles one "--name=value" option; returns false if it is not recognised
+static bool parseOption(const char* option, sim_options_t* options) {
+   if (strncmp(option, "--sweep=", 8) == 0) {
+      options->sweepFile = option + 8;
+      return true;
+   }
+   if (strncmp(option, "--sweep-out=", 12) == 0) {
+      options->sweepOut = option + 12;
+      return true;
+   }
+   if (strncmp(option, "--result-cache=", 15) == 0) {
+      options->resultCache = option + 15;
+      return true;
+   }
+   if (strncmp(option, "--mrc=", 6) == 0) {
+      if (!parseRange(option + 6, 10, &options->mrcBlocksize, &options->mrcMaxSize)
+          || options->mrcBlocksize == 0 || (options->mrcBlocksize & (options->mrcBlocksize - 1)) != 0) {
+         printf("Error: --mrc expects BLOCKSIZE:MAX_SIZE with a power-of-two BLOCKSIZE and sizes below 2^32.\n");
+         exit(EXIT_FAILURE);
+      }
+      return true;
+   }
+   if (strncmp(option, "--policy=", 9) == 0) {
+      if (!parseReplacementPolicy(option + 9, &options->policy)) {
+         printf("Error: Unknown replacement policy %s.\n", option + 9);
+         exit(EXIT_FAILURE);
+      }
+      return true;
+   }
+   if (strncmp(option, "--sample=", 9) == 0) {
+      char* end;
+      double ratio = strtod(option + 9, &end);
+      if (*end == '/') {
+         const char* denominator = end + 1;
+         ratio /= strtod(denominator, &end);
+         if (end == denominator) {
+            ratio = 0.0;
+         }
+      }
+      if (end == option + 9 || *end != '\0' || !(ratio > 0.0 && ratio <= 1.0)) {
+         printf("Error: --sample expects a fraction of the sets greater than 0 and at most 1.\n");
+         exit(EXIT_FAILURE);
+      }
+      options->sampleRatio = ratio;
+      return true;
+   }
+   if (strncmp(option, "--sample-select=", 16) == 0) {
+      if (!parseSampleSelection(option + 16, &options->sampleSelection, &options->sampleSeed)) {
+         printf("Error: --sample-select expects strided, random or random:SEED.\n");
+         exit(EXIT_FAILURE);
+      }
+      return true;
+   }
+   if (strcmp(option, "--classify-misses") == 0 || strncmp(option, "--classify-misses=", 18) == 0) {
+      options->classifyMisses = true;
+      if (option[17] == '=') {
+         options->classifyOut = option + 18;
+      }
+      return true;
+   }
+   if (strncmp(option, "--interval=", 11) == 0) {
+      char* end;
+      options->intervalLength = strtoull(option + 11, &end, 10);
+      if (end == option + 11 || *end != '\0' || options->intervalLength == 0) {
+         printf("Error: --interval expects a number of requests greater than 0.\n");
+         exit(EXIT_FAILURE);
+      }
+      return true;
+   }
+   if (strncmp(option, "--interval-out=", 15) == 0) {
+      options->intervalOut = option + 15;
+      return true;
+   }
+   if (strncmp(option, "--interval-format=", 18) == 0) {
+      if (!parseIntervalFormat(option + 18, &options->intervalFormat)) {
+         printf("Error: --interval-format expects csv or json.\n");
+         exit(EXIT_FAILURE);
+      }
+      return true;
+   }
+   if (strncmp(option, "--victim-cache=", 15) == 0 || strncmp(option, "--miss-cache=", 13) == 0) {
+      uint32_t kind = (option[2] == 'v') ? ASSIST_VICTIM : ASSIST_MISS;
+      const char* value = strchr(option, '=') + 1;
+      uint32_t level, entries;
+      if (!parseLevelValue(value, 1, ASSIST_MAX_ENTRIES, &level, &entries)) {
+         printf("Error: %.*s expects L1:ENTRIES or L2:ENTRIES with 1 to %u entries.\n", int(value - option - 1), option, ASSIST_MAX_ENTRIES);
+         exit(EXIT_FAILURE);
+      }
+      if (options->assistKind[level - 1] != ASSIST_NONE && options->assistKind[level - 1] != kind) {
+         printf("Error: L%u can have a victim cache or a miss cache, not both.\n", level);
+         exit(EXIT_FAILURE);
+      }
+      options->assistKind[level - 1] = kind;
+      options->assistEntries[level - 1] = entries;
+      return true;
+   }
+   if (strncmp(option, "--inclusion=", 12) == 0) {
+      if (!parseInclusionPolicy(option + 12, &options->inclusion)) {
+         printf("Error: --inclusion expects nine, inclusive or exclusive.\n");
+         exit(EXIT_FAILURE);
+      }
+      options->inclusionGiven = true;
+      return true;
+   }
+   if (strncmp(option, "--write-policy=", 15) == 0) {
+      uint32_t level, policy;
+      if (!parseLevelWritePolicy(option + 15, &level, &policy)) {
+         printf("Error: --write-policy expects wbwa, wbna, wtwa or wtna, optionally after L1: or L2:.\n");
+         exit(EXIT_FAILURE);
+      }
+      for (uint32_t i = 1; i <= 2; ++i) {
+         if (level == 0 || level == i) {
+            options->writePolicy[i - 1] = policy;
+         }
+      }
+      options->writePolicyGiven = true;
+      return true;
+   }
+   if (strncmp(option, "--write-buffer=", 15) == 0) {
+      uint32_t level, entries;
+      if (!parseLevelValue(option + 15, 1, WRITE_BUFFER_MAX_ENTRIES, &level, &entries)) {
+         printf("Error: --write-buffer expects L1:ENTRIES or L2:ENTRIES with 1 to %u entries.\n", WRITE_BUFFER_MAX_ENTRIES);
+         exit(EXIT_FAILURE);
+      }
+      options->writeBufferEntries[level - 1] = entries;
+      return true;
+   }
+   if (strncmp(option, "--write-buffer-drain=", 21) == 0) {
+      char* end;
+      unsigned long value = strtoul(option + 21, &end, 10);
+      if (end == option + 21 || *end != '\0' || value == 0 || value > 0xFFFFu) {
+         printf("Error: --write-buffer-drain expects a number of requests from 1 to 65535.\n");
+         exit(EXIT_FAILURE);
+      }
+      options->writeBufferDrain = uint32_t(value);
+      return true;
+   }
+   if (strncmp(option, "--prefetcher=", 13) == 0) {
+      uint32_t level, kind, degree;
+      if (!parsePrefetcher(option + 13, &level, &kind, &degree)) {
+         printf("Error: --prefetcher expects L1: or L2: followed by next-line, stride, region or ampm, and optionally :DEGREE from 1 to %u.\n", PREFETCH_MAX_DEGREE);
+         exit(EXIT_FAILURE);
+      }
+      options->prefetcherKind[level - 1] = kind;
+      options->prefetcherDegree[level - 1] = degree;
+      return true;
+   }
+   if (strncmp(option, "--prefetch-latency=", 19) == 0) {
+      char* end;
+      unsigned long value = strtoul(option + 19, &end, 10);
+      if (end == option + 19 || *end != '\0' || value > 0xFFFFu) {
+         printf("Error: --prefetch-latency expects a number of requests from 0 to 65535.\n");
+         exit(EXIT_FAILURE);
+      }
+      options->prefetchLatency = uint32_t(value);
+      return true;
+   }
+   if (strcmp(option, "--prefetch-stats") == 0) {
+      options->prefetchStats = true;
+      return true;
+   }
+   if (strcmp(option, "--timing") == 0) {
+      options->timing = true;
+      return true;
+   }
+   if (strncmp(option, "--hit-latency=", 14) == 0) {
+      uint32_t level, cycles;
+      if (!parseLevelValue(option + 14, 1, TIMING_MAX_LATENCY, &level, &cycles)) {
+         printf("Error: --hit-latency expects L1:CYCLES or L2:CYCLES with 1 to %u cycles.\n", TIMING_MAX_LATENCY);
+         exit(EXIT_FAILURE);
+      }
+      options->hitLatency[level - 1] = cycles;
+      options->timing = true;
+      return true;
+   }
+   if (strncmp(option, "--memory-latency=", 17) == 0) {
+      char* end;
+      unsigned long value = strtoul(option + 17, &end, 10);
+      if (end == option + 17 || *end != '\0' || value == 0 || value > TIMING_MAX_LATENCY) {
+         printf("Error: --memory-latency expects 1 to %u cycles.\n", TIMING_MAX_LATENCY);
+         exit(EXIT_FAILURE);
+      }
+      options->memoryLatency = uint32_t(value);
+      options->timing = true;
+      return true;
+   }
+   if (strcmp(option, "--dram") == 0 || strncmp(option, "--dram=", 7) == 0) {
+      uint32_t values[3];
+      if (option[6] == '=') {
+         if (!parseColonValues(option + 7, 3, 1u << 20, values) || values[0] > DRAM_MAX_CHANNELS || values[1] > DRAM_MAX_BANKS) {
+            printf("Error: --dram expects CHANNELS:BANKS:ROW_BYTES with up to %u channels and %u banks.\n", DRAM_MAX_CHANNELS, DRAM_MAX_BANKS);
+            exit(EXIT_FAILURE);
+         }
+         options->dramParams.channels = values[0];
+         options->dramParams.banks = values[1];
+         options->dramParams.rowBytes = values[2];
+      }
+      options->dram = true;
+      options->timing = true;
+      return true;
+   }
+   if (strncmp(option, "--dram-timing=", 14) == 0) {
+      uint32_t values[3];
+      if (!parseColonValues(option + 14, 3, DRAM_MAX_CYCLES, values)) {
+         printf("Error: --dram-timing expects CAS:RCD:RP with 1 to %u cycles each.\n", DRAM_MAX_CYCLES);
+         exit(EXIT_FAILURE);
+      }
+      options->dramParams.tCAS = values[0];
+      options->dramParams.tRCD = values[1];
+      options->dramParams.tRP = values[2];
+      options->dram = true;
+      options->timing = true;
+      return true;
+   }
+   if (strncmp(option, "--dram-bandwidth=", 17) == 0) {
+      char* end;
+      double bandwidth = strtod(option + 17, &end);
+      if (end == option + 17 || *end != '\0' || !(bandwidth > 0.0 && bandwidth <= 4096.0)) {
+         printf("Error: --dram-bandwidth expects bytes per cycle greater than 0 and at most 4096.\n");
+         exit(EXIT_FAILURE);
+      }
+      options->dramParams.bandwidth = bandwidth;
+      options->dram = true;
+      options->timing = true;
+      return true;
+   }
+   if (strncmp(option, "--dram-queue=", 13) == 0) {
+      uint32_t entries;
+      if (!parseColonValues(option + 13, 1, DRAM_MAX_QUEUE, &entries)) {
+         printf("Error: --dram-queue expects 1 to %u entries.\n", DRAM_MAX_QUEUE);
+         exit(EXIT_FAILURE);
+      }
+      options->dramParams.queueEntries = entries;
+      options->dram = true;
+      options->timing = true;
+      return true;
+   }
+   if (strncmp(option, "--dram-scheduler=", 17) == 0) {
+      if (!parseDramScheduler(option + 17, &options->dramParams.scheduler)) {
+         printf("Error: --dram-scheduler expects fcfs or frfcfs.\n");
+         exit(EXIT_FAILURE);
+      }
+      options->dram = true;
+      options->timing = true;
+      return true;
+   }
+   if (strncmp(option, "--mshrs=", 8) == 0) {
+      uint32_t level, count;
+      if (!parseLevelValue(option + 8, 1, TIMING_MAX_MSHRS, &level, &count)) {
+         printf("Error: --mshrs expects L1:COUNT or L2:COUNT with 1 to %u MSHRs.\n", TIMING_MAX_MSHRS);
+         exit(EXIT_FAILURE);
+      }
+      options->mshrs[level - 1] = count;
+      options->timing = true;
+      return true;
+   }
+   if (strncmp(option, "--checkpoint=", 13) == 0) {
+      options->checkpointFile = option + 13;
+      return true;
+   }
+   if (strncmp(option, "--checkpoint-at=", 16) == 0) {
+      char* end;
+      options->checkpointAt = strtoull(option + 16, &end, 10);
+      if (end == option + 16 || *end != '\0') {
+         printf("Error: --checkpoint-at expects a number of requests.\n");
+         exit(EXIT_FAILURE);
+      }
+      return true;
+   }
+   if (strncmp(option, "--restore=", 10) == 0) {
+      options->restoreFile = option + 10;
+      return true;
+   }
+   if (strcmp(option, "--report-rss") == 0) {
+      atexit(reportPeakRSS);
+      return true;
+   }
+   if (strncmp(option, "--cores=", 8) == 0) {
+      char* end;
+      unsigned long value = strtoul(option + 8, &end, 10);
+      if (!isdigit((unsigned char) option[8]) || *end != '\0' || value == 0 || value > TRACE_MAX_CORES) {
+         printf("Error: --cores expects a number of cores from 1 to %u.\n", TRACE_MAX_CORES);
+         exit(EXIT_FAILURE);
+      }
+      options->cores = uint32_t(value);
+      return true;
+   }
+   if (strncmp(option, "--threads=", 10) == 0) {
+      char* end;
+      unsigned long value = strtoul(option + 10, &end, 10);
+      if (!isdigit((unsigned char) option[10]) || *end != '\0' || value > SIM_MAX_THREADS) {
+         printf("Error: --threads expects a number of threads from 0 (one per hardware thread) to %u.\n", SIM_MAX_THREADS);
+         exit(EXIT_FAILURE);
+      }
+      options->threads = uint32_t(value);
+      options->threadsGiven = true;
+      return true;
+   }
+   return parseTraceOption(option);
+}
+
+// Sweep mode: simulate every configuration of the sweep spec over one pass of the trace
+// With a result cache only the configurations it does not hold are simulated.
+static int runSweep(const sim_options_t& options, const char* trace_file) {
+   std::vector<cache_params_t> configs;
+   if (!Sweep::parseSpec(options.sweepFile, options.policy, &configs)) {
+      exit(EXIT_FAILURE);
+   }
+   FILE* out = stdout;
+   if (options.sweepOut != nullptr) {
+      out = fopen(options.sweepOut, "w");
+      if (out == (FILE *) NULL) {
+         printf("Error: Unable to open file %s\n", options.sweepOut);
+         exit(EXIT_FAILURE);
+      }
+   }
+   std::vector<sim_results_t> results(configs.size());
+   std::vector<cache_params_t> pending;	// configurations to simulate...
+   std::vector<size_t> pendingIndex;	// ...and where they are in the spec
+   ResultCache cache;
+   bool cached = options.resultCache != nullptr;
+   if (cached && (options.checkpointFile != nullptr || options.restoreFile != nullptr)) {
+      fprintf(stderr, "Warning: --result-cache does not apply to --checkpoint and --restore; ignored\n");
+      cached = false;
+   }
+   if (cached && !cache.open(options.resultCache, trace_file)) {
+      exit(EXIT_FAILURE);
+   }
+   for (size_t i = 0; i < configs.size(); ++i) {
+      if (!cached || !cache.find(configs[i], options, &results[i])) {
+         pending.push_back(configs[i]);
+         pendingIndex.push_back(i);
+      }
+   }
+   if (cached) {
+      fprintf(stderr, "Result cache: %zu of %zu configurations found in %s\n", configs.size() - pending.size(), configs.size(), options.resultCache);
+   }
+
+   if (!pending.empty()) {
+      TraceReader trace;
+      if (!trace.open(trace_file)) {
+         printf("Error: Unable to open file %s\n", trace_file);
+         exit(EXIT_FAILURE);
+      }
+      uint32_t threads = options.threadsGiven ? options.threads : 1;
+      if (threads == 0) {
+         threads = std::thread::hardware_concurrency();
+         threads = (threads == 0) ? 1 : threads;
+      }
+      if (threads > pending.size()) {
+         threads = pending.size();
+      }
+      if (threads > 1 && options.checkpointFile != nullptr) {
+         fprintf(stderr, "Warning: --checkpoint simulates the sweep on one thread\n");
+         threads = 1;
+      }
+      std::vector<sim_results_t> simulated;
+      if (threads > 1) {
+         Sweep::runParallel(pending, trace, threads, options, &simulated);
+      }
+      else {
+         Sweep::run(pending, trace, options, &simulated);
+      }
+      for (size_t i = 0; i < pending.size(); ++i) {
+         results[pendingIndex[i]] = simulated[i];
+         if (cached) {
+            cache.store(pending[i], options, simulated[i]);
+         }
+      }
+   }
+   Sweep::printResults(out, results, options.timing);
+   if (out != stdout) {
+      fclose(out);
+   }
+   return(0);
+}
+
+// Miss-ratio curve mode: stack-distance analysis of the trace for every LRU cache size
+static int runMissRatioCurve(const sim_options_t& options, const char* trace_file) {
+   TraceReader trace;
+   if (!trace.open(trace_file)) {
+      printf("Error: Unable to open file %s\n", trace_file);
+      exit(EXIT_FAILURE);
+   }
+   std::vector<TraceRecord> records;
+   trace.readAll(&records);
+   if (records.size() > STACK_DISTANCE_MAX_REQUESTS) {
+      printf("Error: --mrc handles traces of at most %u requests; %s has %zu.\n", STACK_DISTANCE_MAX_REQUESTS, trace_file, records.size());
+      exit(EXIT_FAILURE);
+   }
+   StackDistance stackDistance(options.mrcBlocksize, records);
+   stackDistance.printMissRatioCurve(options.mrcMaxSize, stdout);
+   return(0);
+}
+
 int main (int argc, char *argv[]) {
-   FILE *fp;			// File pointer.
+   TraceReader trace;		// Reads text or binary traces; the format is detected when the file is opened.
    char *trace_file;		// This variable holds the trace file name.
    cache_params_t params;	// Look at the sim.h header file for the definition of struct cache_params_t.
-   char rw;			// This variable holds the request's type (read or write) obtained from the trace.
-   uint32_t addr;		// This variable holds the request's address obtained from the trace.
+   sim_options_t options;	// Options given on the command line; also in sim.h.
+   const TraceRecord* requests;	// A batch of requests (type and address) read from the trace.
 				// The header file <inttypes.h> above defines signed and unsigned integers of various sizes in a machine-agnostic way.  "uint32_t" is an unsigned integer of 32 bits.
 
+   // Separate options from the positional arguments
+   memset(&options, 0, sizeof(options));
+   options.checkpointAt = CHECKPOINT_AT_END;
+   options.writeBufferDrain = WRITE_BUFFER_DRAIN_INTERVAL;
+   options.prefetchLatency = PREFETCH_LATENCY;
+   options.memoryLatency = TIMING_MEMORY_LATENCY;
+   options.mshrs[0] = TIMING_L1_MSHRS;
+   options.mshrs[1] = TIMING_L2_MSHRS;
+   options.dramParams.channels = DRAM_CHANNELS;
+   options.dramParams.banks = DRAM_BANKS;
+   options.dramParams.rowBytes = DRAM_ROW_BYTES;
+   options.dramParams.tCAS = DRAM_TCAS;
+   options.dramParams.tRCD = DRAM_TRCD;
+   options.dramParams.tRP = DRAM_TRP;
+   options.dramParams.bandwidth = DRAM_BANDWIDTH;
+   options.dramParams.queueEntries = DRAM_QUEUE_ENTRIES;
+   options.dramParams.scheduler = DRAM_FRFCFS;
+   char *args[9];		// Positional arguments; args[0] is the program name.
+   int argCount = 0;
+   for (int i = 0; i < argc; ++i) {
+      if (i > 0 && strncmp(argv[i], "--", 2) == 0) {
+         if (!parseOption(argv[i], &options)) {
+            printf("Error: Unknown option %s.\n", argv[i]);
+            exit(EXIT_FAILURE);
+         }
+      }
+      else {
+         if (argCount < 9) {
+            args[argCount] = argv[i];
+         }
+         argCount++;
+      }
+   }
+
+   if (options.sampleRatio != 0.0 && (options.sweepFile != nullptr || options.mrcMaxSize != 0)) {
+      fprintf(stderr, "Warning: --sample only applies to a single simulation; ignored\n");
+      options.sampleRatio = 0.0;
+   }
+   if (options.resultCache != nullptr && options.sweepFile == nullptr) {
+      fprintf(stderr, "Warning: --result-cache only applies to --sweep; ignored\n");
+   }
+   if (options.mrcMaxSize != 0 && (options.checkpointFile != nullptr || options.restoreFile != nullptr)) {
+      fprintf(stderr, "Warning: --checkpoint and --restore do not apply to --mrc; ignored\n");
+   }
+   if (options.classifyMisses && (options.sweepFile != nullptr || options.mrcMaxSize != 0)) {
+      fprintf(stderr, "Warning: --classify-misses only applies to a single simulation; ignored\n");
+      options.classifyMisses = false;
+   }
+   if (options.intervalLength != 0 && (options.sweepFile != nullptr || options.mrcMaxSize != 0)) {
+      fprintf(stderr, "Warning: --interval only applies to a single simulation; ignored\n");
+      options.intervalLength = 0;
+   }
+   // The counters of a sampled simulation only cover the sampled sets
+   if (options.intervalLength != 0 && options.sampleRatio != 0.0) {
+      printf("Error: --interval cannot be combined with --sample.\n");
+      exit(EXIT_FAILURE);
+   }
+   if (options.cores != 0 && (options.sweepFile != nullptr || options.mrcMaxSize != 0)) {
+      fprintf(stderr, "Warning: --cores only applies to a single simulation; ignored\n");
+      options.cores = 0;
+   }
+   if (options.cores != 0 && (options.sampleRatio != 0.0 || options.classifyMisses)) {
+      printf("Error: --cores cannot be combined with --sample or --classify-misses.\n");
+      exit(EXIT_FAILURE);
+   }
+   // A victim or miss cache is shared by every set, so the sampled sets would see too large a share of it
+   bool assistCaches = options.assistKind[0] != ASSIST_NONE || options.assistKind[1] != ASSIST_NONE;
+   if (assistCaches && options.mrcMaxSize != 0) {
+      fprintf(stderr, "Warning: --victim-cache and --miss-cache do not apply to --mrc; ignored\n");
+   }
+   if (assistCaches && (options.sampleRatio != 0.0 || options.cores != 0)) {
+      printf("Error: --victim-cache and --miss-cache cannot be combined with --sample or --cores.\n");
+      exit(EXIT_FAILURE);
+   }
+   if (options.inclusionGiven && options.mrcMaxSize != 0) {
+      fprintf(stderr, "Warning: --inclusion does not apply to --mrc; ignored\n");
+   }
+   if (options.inclusion != INCLUSION_NINE && options.cores != 0) {
+      printf("Error: --inclusion=%s cannot be combined with --cores.\n", inclusionPolicyNames[options.inclusion]);
+      exit(EXIT_FAILURE);
+   }
+   // A write buffer is shared by every set, like a victim cache
+   bool writeBuffers = options.writeBufferEntries[0] != 0 || options.writeBufferEntries[1] != 0;
+   // Write-back, write-allocate levels are the default and print nothing, as --policy=lru does
+   bool writePolicies = options.writePolicy[0] != WRITE_WBWA || options.writePolicy[1] != WRITE_WBWA;
+   if ((options.writePolicyGiven || writeBuffers) && options.mrcMaxSize != 0) {
+      fprintf(stderr, "Warning: --write-policy and --write-buffer do not apply to --mrc; ignored\n");
+   }
+   if (writeBuffers && (options.sampleRatio != 0.0 || options.cores != 0)) {
+      printf("Error: --write-buffer cannot be combined with --sample or --cores.\n");
+      exit(EXIT_FAILURE);
+   }
+   if (writePolicies && options.cores != 0) {
+      printf("Error: --write-policy other than wbwa cannot be combined with --cores.\n");
+      exit(EXIT_FAILURE);
+   }
+   // An exclusive L2 takes L1's evictions directly, and a write passed through to it would copy an L1 block there
+   if (options.inclusion == INCLUSION_EXCLUSIVE && (isWriteThrough(options.writePolicy[0]) || isWriteThrough(options.writePolicy[1]) || options.writeBufferEntries[0] != 0)) {
+      printf("Error: --inclusion=exclusive needs write-back levels and no write buffer below L1.\n");
+      exit(EXIT_FAILURE);
+   }
+   // Prefetches cross sets like the streams of the stream buffers
+   bool prefetchers = options.prefetcherKind[0] != PREFETCH_NONE || options.prefetcherKind[1] != PREFETCH_NONE;
+   if (prefetchers && options.mrcMaxSize != 0) {
+      fprintf(stderr, "Warning: --prefetcher does not apply to --mrc; ignored\n");
+   }
+   if (prefetchers && (options.sampleRatio != 0.0 || options.cores != 0)) {
+      printf("Error: --prefetcher cannot be combined with --sample or --cores.\n");
+      exit(EXIT_FAILURE);
+   }
+   // An exclusive L2 hands its blocks up instead of serving prefetch reads, and gives up the ones that are hit
+   if (prefetchers && options.inclusion == INCLUSION_EXCLUSIVE) {
+      printf("Error: --prefetcher cannot be combined with --inclusion=exclusive.\n");
+      exit(EXIT_FAILURE);
+   }
+   if (options.timing && options.mrcMaxSize != 0) {
+      fprintf(stderr, "Warning: --timing does not apply to --mrc; ignored\n");
+   }
+   // The requests to sets that are not sampled never reach the MSHRs, and the cores of --cores have no common clock
+   if (options.timing && (options.sampleRatio != 0.0 || options.cores != 0)) {
+      printf("Error: --timing cannot be combined with --sample or --cores.\n");
+      exit(EXIT_FAILURE);
+   }
+   // A classification needs every request from the first on, and all the sets
+   if (options.classifyMisses && (options.restoreFile != nullptr || options.sampleRatio != 0.0)) {
+      printf("Error: --classify-misses cannot be combined with --restore or --sample.\n");
+      exit(EXIT_FAILURE);
+   }
+   if (options.sampleRatio != 0.0 && (options.checkpointFile != nullptr || options.restoreFile != nullptr)) {
+      printf("Error: A sampled simulation cannot be checkpointed or restored.\n");
+      exit(EXIT_FAILURE);
+   }
+   // In sweep mode the configurations come from the sweep spec; only the trace file is given.
+   if (options.sweepFile != nullptr) {
+      if (argCount != 2) {
+         printf("Error: Expected only the trace file with --sweep but was provided %d arguments.\n", (argCount - 1));
+         exit(EXIT_FAILURE);
+      }
+      return runSweep(options, args[1]);
+   }
+   // The miss-ratio curve also takes only the trace file.
+   if (options.mrcMaxSize != 0) {
+      if (argCount != 2) {
+         printf("Error: Expected only the trace file with --mrc but was provided %d arguments.\n", (argCount - 1));
+         exit(EXIT_FAILURE);
+      }
+      return runMissRatioCurve(options, args[1]);
+   }
+   if (options.threadsGiven && options.cores == 0) {
+      fprintf(stderr, "Warning: --threads only applies to --sweep and --cores; ignored\n");
+   }
+
    // Exit with an error if the number of command-line arguments is incorrect.
-   if (argc != 9) {
-      printf("Error: Expected 8 command-line arguments but was provided %d.\n", (argc - 1));
+   if (argCount != 9) {
+      printf("Error: Expected 8 command-line arguments but was provided %d.\n", (argCount - 1));
       exit(EXIT_FAILURE);
    }
     
    // "atoi()" (included by <stdlib.h>) converts a string (char *) to an integer (int).
-   params.BLOCKSIZE = (uint32_t) atoi(argv[1]);
-   params.L1_SIZE   = (uint32_t) atoi(argv[2]);
-   params.L1_ASSOC  = (uint32_t) atoi(argv[3]);
-   params.L2_SIZE   = (uint32_t) atoi(argv[4]);
-   params.L2_ASSOC  = (uint32_t) atoi(argv[5]);
-   params.PREF_N    = (uint32_t) atoi(argv[6]);
-   params.PREF_M    = (uint32_t) atoi(argv[7]);
-   trace_file       = argv[8];
+   params.BLOCKSIZE = (uint32_t) atoi(args[1]);
+   params.L1_SIZE   = (uint32_t) atoi(args[2]);
+   params.L1_ASSOC  = (uint32_t) atoi(args[3]);
+   params.L2_SIZE   = (uint32_t) atoi(args[4]);
+   params.L2_ASSOC  = (uint32_t) atoi(args[5]);
+   params.PREF_N    = (uint32_t) atoi(args[6]);
+   params.PREF_M    = (uint32_t) atoi(args[7]);
+   params.REPL_POLICY = options.policy;
+   trace_file       = args[8];
 
    // Open the trace file for reading.
-   fp = fopen(trace_file, "r");
-   if (fp == (FILE *) NULL) {
+   if (!trace.open(trace_file)) {
       // Exit with an error if file open failed.
       printf("Error: Unable to open file %s\n", trace_file);
       exit(EXIT_FAILURE);
@@ -57,120 +778,161 @@ int main (int argc, char *argv[]) {
    printf("L2_ASSOC:   %u\n", params.L2_ASSOC);
    printf("PREF_N:     %u\n", params.PREF_N);
    printf("PREF_M:     %u\n", params.PREF_M);
+   if (options.cores != 0) {
+      printf("CORES:      %u\n", options.cores);
+   }
+   if (params.REPL_POLICY != REPL_LRU) {
+      printf("POLICY:     %s\n", getReplacementPolicyName(params.REPL_POLICY));
+   }
+   if (options.inclusionGiven) {
+      printf("INCLUSION:  %s\n", inclusionPolicyNames[options.inclusion]);
+   }
+   if (writePolicies) {
+      printf("WRITE:      L1 %s, L2 %s\n", writePolicyNames[options.writePolicy[0]], writePolicyNames[options.writePolicy[1]]);
+   }
+   if (prefetchers) {
+      printf("PREFETCHER:");
+      for (uint32_t level = 1; level <= 2; ++level) {
+         uint32_t kind = options.prefetcherKind[level - 1];
+         if (kind != PREFETCH_NONE) {
+            printf(" L%u %s:%u", level, prefetcherNames[kind], options.prefetcherDegree[level - 1]);
+         }
+         else {
+            printf(" L%u none", level);
+         }
+         printf((level == 1) ? "," : "\n");
+      }
+   }
+   if (options.sampleRatio != 0.0) {
+      printf("SAMPLE:     %g\n", options.sampleRatio);
+   }
    printf("trace_file: %s\n", trace_file);
    printf("\n");
 
-   // Construct cache hierarchy
-   Cache* l1Cache = nullptr;
-   Cache* l2Cache = nullptr;
-   Cache* cacheWithPrefetch = nullptr;
-
-   // Instantiate L1 cache
-   if (params.L1_SIZE != 0) {
-      l1Cache = new Cache(1, params.L1_SIZE, params.BLOCKSIZE, params.L1_ASSOC);
-
-      // Instantiate L2 cache
-      if (params.L2_SIZE !=0) {
-         l2Cache = new Cache(2, params.L2_SIZE, params.BLOCKSIZE, params.L2_ASSOC);
-         // Linking the caches such that L1 can access L2
-         l1Cache->setNextCacheLevel(l2Cache);
-
-         if (params.PREF_N > 0) { // Stream buffers have to be added
-            // Stream Buffers has to be added to the last level of cache
-            // If L2 exists, add the stream buffers to L2
-            l2Cache->addStreamBuffers(params.PREF_N, params.PREF_M);
-            cacheWithPrefetch = l2Cache;
-         }
-      }
-      else if (params.PREF_N > 0) { // Stream buffers have to be added
-         // Stream Buffers has to be added to the last level of cache
-         // Since L2 does not exist, add the stream buffers to L1
-         l1Cache->addStreamBuffers(params.PREF_N, params.PREF_M);
-         cacheWithPrefetch = l1Cache;
+   // Construct cache hierarchy, specialised for the replacement policy
+   CacheHierarchy* hierarchy;
+   if (options.cores != 0) {
+      uint32_t threads = options.threadsGiven ? options.threads : 1;
+      if (threads == 0) {
+         threads = std::thread::hardware_concurrency();
+         threads = (threads == 0) ? 1 : threads;
       }
+      hierarchy = CacheHierarchy::createMultiCore(params, options.cores, threads);
    }
-
-   // Read requests from the trace file and proceess them
-   uint32_t rwCount = 0;
-   while (fscanf(fp, "%c %x\n", &rw, &addr) == 2) {	// Stay in the loop if fscanf() successfully parsed two tokens as specified.
-      if (rw != 'r' && rw !='w') {
-        printf("Error: Unknown request type %c.\n", rw);
-	   exit(EXIT_FAILURE);
+   else {
+      hierarchy = CacheHierarchy::create(params);
+   }
+   hierarchy->configure(options);
+   if (options.sampleRatio != 0.0) {
+      hierarchy->enableSampling(options.sampleRatio, options.sampleSelection, options.sampleSeed);
+   }
+   if (options.classifyMisses) {
+      hierarchy->enableMissClassification();
+   }
+   // Start from a saved cache state instead of cold caches if asked to
+   std::vector<CacheHierarchy*> hierarchies(1, hierarchy);
+   uint64_t restored = 0;
+   TraceDigest traceDigest;
+   if (options.restoreFile != nullptr) {
+      restored = CacheHierarchy::restoreSnapshot(options.restoreFile, hierarchies, trace, &traceDigest);
+   }
+   CheckpointRunner runner(hierarchies, options.checkpointFile, options.checkpointAt, restored, traceDigest);
+   FILE* intervalOut = nullptr;
+   if (options.intervalLength != 0) {
+      intervalOut = stdout;
+      if (options.intervalOut != nullptr) {
+         intervalOut = fopen(options.intervalOut, "w");
+         if (intervalOut == (FILE *) NULL) {
+            printf("Error: Unable to open file %s\n", options.intervalOut);
+            exit(EXIT_FAILURE);
+         }
       }
+   }
+   IntervalSeries intervals(hierarchy, intervalOut, options.intervalFormat, options.intervalLength, restored);
 
+   // Read requests from the trace file a batch at a time and process them
+   // The trace is decoded on a separate thread while earlier batches are simulated;
+   // pipeline.next() exits with an error on a request type other than r or w.
+   TracePipeline pipeline(trace);
+   size_t count;
+   uint64_t accessAllocations = 0;	// Heap allocations while simulating; counted only in "make allocheck" builds.
+   while ((requests = pipeline.next(&count)) != nullptr) {	// Stay in the loop while the trace has requests left.
       ///////////////////////////////////////////////////////
-      // Issue the request to the L1 cache instance here.
+      // Issue the requests to the L1 cache instance here.
       ///////////////////////////////////////////////////////
-      if (l1Cache != nullptr) {
-         rwCount += 1;
-         debugPrint("%d=%c %x\n", rwCount, rw, addr);
-         l1Cache->executeInstruction(rw, addr);
-      }
+      uint64_t allocationsBefore = getAllocationCount();
+      intervals.run(runner, requests, count);
+      accessAllocations += getAllocationCount() - allocationsBefore;
+   }
+   runner.finish();
+   intervals.finish();
+   if (intervalOut == stdout) {
+      printf("\n");
    }
+   else if (intervalOut != nullptr) {
+      fclose(intervalOut);
+   }
+   if (accessAllocations != 0) {
+      fprintf(stderr, "Error: %" PRIu64 " heap allocations while processing the trace.\n", accessAllocations);
+      exit(EXIT_FAILURE);
+   }
+   // Drain any buffered trace output before printing the results
+   debugSink.flush();
+
    // Generate output
-   // Print L1 cache contents
-   if (l1Cache != nullptr) {
-      l1Cache->printContents();
+   // A sampled simulation only has estimates; its contents and counts cover the sampled sets alone
+   if (options.sampleRatio != 0.0) {
+      hierarchy->printSampledEstimates();
+      delete hierarchy;
+      return(0);
+   }
+   // Print cache and stream buffer contents
+   hierarchy->printContents();
+   // Print Measurements
+   CacheHierarchy::printMeasurements(hierarchy->getResults());
+   if (options.cores != 0) {
       printf("\n");
+      hierarchy->printCoherence();
    }
-   // Print L2 cache contents
-   if (l2Cache != nullptr) {
-      l2Cache->printContents();
+   if (assistCaches) {
       printf("\n");
+      hierarchy->printAssistCaches();
    }
-   // Print Stream buffer contents if it exists
-   if (cacheWithPrefetch != nullptr) {
-      cacheWithPrefetch->printStreamBufferContents();
+   if (options.inclusionGiven) {
       printf("\n");
+      hierarchy->printInclusion();
    }
-   // Print Measurements
-   printf("===== Measurements =====\n");
-   // L1 measurements
-   if (l1Cache != nullptr) {
-      printf("a. L1 reads:                   %d\n", l1Cache->getReads());
-      printf("b. L1 read misses:             %d\n", l1Cache->getReadMisses());
-      printf("c. L1 writes:                  %d\n", l1Cache->getWrites());
-      printf("d. L1 write misses:            %d\n", l1Cache->getWriteMisses());
-      printf("e. L1 miss rate:               %.4f\n", l1Cache->getMissRate());
-      printf("f. L1 writebacks:              %d\n", l1Cache->getWritebacks());
-      printf("g. L1 prefetches:              %d\n", l1Cache->getPrefetches());
+   if (writePolicies || writeBuffers) {
+      printf("\n");
+      hierarchy->printWritePolicies();
    }
-   else {
-      printf("a. L1 reads:                   %d\n", 0);
-      printf("b. L1 read misses:             %d\n", 0);
-      printf("c. L1 writes:                  %d\n", 0);
-      printf("d. L1 write misses:            %d\n", 0);
-      printf("e. L1 miss rate:               %.4f\n", 0.0);
-      printf("f. L1 writebacks:              %d\n", 0);
-      printf("g. L1 prefetches:              %d\n", 0);
-   }
-   if (l2Cache != nullptr) {
-      printf("h. L2 reads (demand):          %d\n", l2Cache->getReads());
-      printf("i. L2 read misses (demand):    %d\n", l2Cache->getReadMisses());
-      printf("j. L2 reads (prefetch):        %d\n", l2Cache->getReadPrefetches());
-      printf("k. L2 read misses (prefetch):  %d\n", l2Cache->getReadMissPrefetches());
-      printf("l. L2 writes:                  %d\n", l2Cache->getWrites());
-      printf("m. L2 write misses:            %d\n", l2Cache->getWriteMisses());
-      printf("n. L2 miss rate:               %.4f\n", l2Cache->getMissRate());
-      printf("o. L2 writebacks:              %d\n", l2Cache->getWritebacks());
-      printf("p. L2 prefetches:              %d\n", l2Cache->getPrefetches());
+   if (prefetchers || options.prefetchStats) {
+      printf("\n");
+      hierarchy->printPrefetchers();
    }
-   else {
-      printf("h. L2 reads (demand):          %d\n", 0);
-      printf("i. L2 read misses (demand):    %d\n", 0);
-      printf("j. L2 reads (prefetch):        %d\n", 0);
-      printf("k. L2 read misses (prefetch):  %d\n", 0);
-      printf("l. L2 writes:                  %d\n", 0);
-      printf("m. L2 write misses:            %d\n", 0);
-      printf("n. L2 miss rate:               %.4f\n", 0.0);
-      printf("o. L2 writebacks:              %d\n", 0);
-      printf("p. L2 prefetches:              %d\n", 0);
-   }
-   printf("q. memory traffic:             %d\n", memTraffic);
-
-   // Deallocate dynamic memory allocation for creating the instances of these classes
-   // This is to avoid memory leaks
-   delete l1Cache;
-   delete l2Cache;
+   if (options.timing) {
+      printf("\n");
+      hierarchy->printTiming();
+   }
+   if (options.dram) {
+      printf("\n");
+      hierarchy->printDram();
+   }
+   if (options.classifyMisses) {
+      FILE* perSetOut = nullptr;
+      if (options.classifyOut != nullptr) {
+         perSetOut = fopen(options.classifyOut, "w");
+         if (perSetOut == (FILE *) NULL) {
+            printf("Error: Unable to open file %s\n", options.classifyOut);
+            exit(EXIT_FAILURE);
+         }
+      }
+      printf("\n");
+      hierarchy->printMissClassification(perSetOut);
+      if (perSetOut != nullptr) {
+         fclose(perSetOut);
+      }
+   }
+   delete hierarchy;
    return(0);
 }
@@ -10,8 +10,100 @@ struct {
    uint32_t L2_ASSOC;
    uint32_t PREF_N;
    uint32_t PREF_M;
+   uint32_t REPL_POLICY;	// replacement policy of every level, a ReplacementPolicy (src/policy.cpp)
 } cache_params_t;
 
 // Put additional data structures here as per your requirement.
 
+// Measurements of one cache level at the end of a simulation
+typedef
+struct {
+   uint64_t reads;
+   uint64_t readMisses;
+   uint64_t writes;
+   uint64_t writeMisses;
+   double   missRate;
+   uint64_t writebacks;
+   uint64_t prefetches;
+   uint64_t readsPrefetch;
+   uint64_t readMissesPrefetch;
+} level_results_t;
+
+// Main memory behind the last level (see src/dram.cpp); times are in core cycles
+typedef
+struct {
+   uint32_t channels;
+   uint32_t banks;		// banks per channel
+   uint32_t rowBytes;		// bytes of a row, the row buffer of a bank
+   uint32_t tCAS;		// cycles from a column command to the data
+   uint32_t tRCD;		// cycles from opening a row to a column command
+   uint32_t tRP;		// cycles to close the open row of a bank
+   double   bandwidth;		// bytes per cycle the data bus of a channel moves at most
+   uint32_t queueEntries;	// requests each channel's controller queue holds
+   uint32_t scheduler;		// a DramScheduler (src/dram.cpp)
+} dram_params_t;
+
+// Timing of a whole cache hierarchy (see src/timing.cpp); all zero unless it is timed
+typedef
+struct {
+   uint32_t L1HitLatency;	// hit latencies in cycles, given or derived from the size and associativity
+   uint32_t L2HitLatency;
+   uint64_t cycles;		// cycle at which the last request completed
+   uint64_t stallCycles;	// cycles the core stalled for an L1 MSHR
+   double   amat;		// average memory access time in cycles
+} timing_results_t;
+
+// Measurements of a whole cache hierarchy; levels that are absent are all zero
+typedef
+struct {
+   cache_params_t params;
+   level_results_t L1;
+   level_results_t L2;
+   uint64_t memTraffic;
+   timing_results_t timing;
+} sim_results_t;
+
+// Options given as "--name=value" on the command line
+typedef
+struct {
+   const char *sweepFile;	// --sweep: simulate every configuration listed in this file
+   const char *sweepOut;	// --sweep-out: write the sweep results to this file instead of stdout
+   const char *resultCache;	// --result-cache: look the sweep's results up in, and store them to, this directory
+   uint32_t threads;		// --threads: worker threads for a sweep; 0 uses every hardware thread
+   bool threadsGiven;		// true if --threads was given
+   uint32_t mrcBlocksize;	// --mrc: print the LRU miss-ratio curve for this block size...
+   uint32_t mrcMaxSize;		// ...covering every cache size up to this many bytes; 0 if not requested
+   uint32_t policy;		// --policy: replacement policy of every level; LRU unless given
+   double sampleRatio;		// --sample: fraction of the sets to simulate; 0 simulates all of them
+   uint32_t sampleSelection;	// --sample-select: how the sampled sets are chosen, a SampleSelection (src/sampling.cpp)
+   uint32_t sampleSeed;		// ...and the seed of a random selection
+   const char *checkpointFile;	// --checkpoint: write a snapshot of the cache state to this file...
+   uint64_t checkpointAt;	// ...after this many requests (--checkpoint-at); the end of the trace unless given
+   const char *restoreFile;	// --restore: start from the cache state in this snapshot instead of cold caches
+   bool classifyMisses;		// --classify-misses: classify the misses of every level as compulsory, capacity or conflict...
+   const char *classifyOut;	// ...and write the breakdown per set to this file (--classify-misses=FILE)
+   uint64_t intervalLength;	// --interval: print the counters every this many requests; 0 if not requested...
+   const char *intervalOut;	// ...to this file (--interval-out) instead of stdout...
+   uint32_t intervalFormat;	// ...as CSV or JSON lines (--interval-format), an IntervalFormat (src/interval.cpp)
+   uint32_t cores;		// --cores: simulate this many cores with private L1s, a shared L2 and MESI coherence; 0 for one core without coherence
+   uint32_t assistKind[2];	// --victim-cache, --miss-cache: kind of small fully associative cache next to L1 and L2, an AssistCacheKind (src/assist.cpp)...
+   uint32_t assistEntries[2];	// ...and its number of entries
+   uint32_t inclusion;		// --inclusion: what L2 holds of L1, an InclusionPolicy (src/cache.cpp); NINE unless given
+   bool inclusionGiven;		// true if --inclusion was given
+   uint32_t writePolicy[2];	// --write-policy: write policy of L1 and L2, a WritePolicy (src/writebuf.cpp); wbwa unless given
+   bool writePolicyGiven;	// true if --write-policy was given
+   uint32_t writeBufferEntries[2];	// --write-buffer: entries of the write buffer below L1 and below L2; 0 for none...
+   uint32_t writeBufferDrain;	// ...and requests of the trace per entry drained (--write-buffer-drain)
+   uint32_t prefetcherKind[2];	// --prefetcher: prefetcher of L1 and L2, a PrefetcherKind (src/prefetch.cpp); none unless given...
+   uint32_t prefetcherDegree[2];	// ...and the most blocks it asks for at a time
+   uint32_t prefetchLatency;	// --prefetch-latency: requests of the trace a prefetch takes to arrive, for counting late prefetches
+   bool prefetchStats;		// --prefetch-stats: print the prefetcher counters, those of the stream buffers too, without --prefetcher
+   bool timing;			// --timing: time every request with hit latencies, MSHRs and a memory latency (src/timing.cpp)...
+   uint32_t hitLatency[2];	// ...with these hit latencies of L1 and L2 in cycles (--hit-latency); 0 derives them from the size and associativity...
+   uint32_t memoryLatency;	// ...this memory latency in cycles (--memory-latency)...
+   uint32_t mshrs[2];		// ...and this many MSHRs at L1 and L2 (--mshrs)
+   bool dram;			// --dram: time main memory with a DRAM model instead of the memory latency...
+   dram_params_t dramParams;	// ...of these channels, banks, rows, timings, bandwidth and controller queue
+} sim_options_t;
+
 #endif
@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+#include "xxhash.cpp"
+
+// Cache-state snapshots (checkpoints)
+//
+// A snapshot holds the complete state of one or more cache hierarchies after
+// the first `records` requests of a trace: tags, valid and dirty bits, the
+// replacement state, stream buffers, victim and miss caches, write buffers,
+// prefetchers, the MSHRs and DRAM queues of the timing model and every
+// counter. Restoring it and simulating the rest of the trace gives exactly the
+// results of simulating the whole trace, so a warm-up phase is simulated once
+// and shared by every later run. The snapshot keeps a digest of those
+// requests, and restoring it onto a trace that does not start with the same
+// requests is an error.
+//
+// Layout (little-endian):
+//    bytes 0-3    magic "CSNP"
+//    bytes 4-5    version (SNAPSHOT_VERSION)
+//    bytes 6-7    reserved, 0
+//    bytes 8-15   requests simulated before the snapshot was taken
+//    bytes 16-19  number of hierarchies H
+//    bytes 20-23  reserved, 0
+//    bytes 24-31  digest of those requests (see TraceDigest in hierarchy.cpp)
+//    then H table entries of SNAPSHOT_ENTRY_SIZE bytes: the eight fields of
+//    cache_params_t (uint32 each, in declaration order), then the offset and
+//    the length of the hierarchy's section (uint64 each)
+//    then the sections, each starting on an 8 byte boundary
+// A section is the hierarchy's state in the order its save() method writes
+// it. Arrays are written as a uint64 element count followed by the elements
+// and padded to 8 bytes, so the large ones are aligned in the mapped file.
+// Any change to what a save() method writes must bump SNAPSHOT_VERSION.
+
+#define SNAPSHOT_MAGIC "CSNP"
+#define SNAPSHOT_VERSION 10
+#define SNAPSHOT_HEADER_SIZE 32
+#define SNAPSHOT_PARAM_COUNT 8
+#define SNAPSHOT_ENTRY_SIZE (SNAPSHOT_PARAM_COUNT * 4 + 16)
+
+// Writes values one after another into a snapshot file
+class SnapshotWriter {
+private:
+    FILE* fp;
+    uint64_t offset; // bytes written so far
+    bool failed;
+
+public:
+    SnapshotWriter() : fp(nullptr), offset(0), failed(false) {
+    }
+
+    ~SnapshotWriter() {
+        if (fp != nullptr) {
+            fclose(fp);
+        }
+    }
+
+    bool open(const char* path) {
+        fp = fopen(path, "wb");
+        offset = 0;
+        failed = false;
+        return fp != (FILE *) NULL;
+    }
+
+    void write(const void* bytes, size_t length) {
+        if (length != 0 && fwrite(bytes, 1, length, fp) != length) {
+            failed = true;
+        }
+        offset += length;
+    }
+
+    // Pads with zeros up to the next multiple of 8 bytes
+    void align() {
+        static const uint8_t zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+        this->write(zeros, size_t((8 - offset % 8) % 8));
+    }
+
+    template <class T>
+    void put(const T& value) {
+        this->write(&value, sizeof(value));
+    }
+
+    template <class T>
+    void putVector(const std::vector<T>& values) {
+        this->put(uint64_t(values.size()));
+        this->write(values.data(), values.size() * sizeof(T));
+        this->align();
+    }
+
+    uint64_t getOffset() const {
+        return offset;
+    }
+
+    // Rewrites bytes already written at position, then carries on at the end
+    void patch(uint64_t position, const void* bytes, size_t length) {
+        if (fseek(fp, long(position), SEEK_SET) != 0 || fwrite(bytes, 1, length, fp) != length || fseek(fp, 0, SEEK_END) != 0) {
+            failed = true;
+        }
+    }
+
+    // Returns false if anything could not be written
+    bool close() {
+        bool ok = !failed && fp != nullptr;
+        if (fp != nullptr && fclose(fp) != 0) {
+            ok = false;
+        }
+        fp = nullptr;
+        return ok;
+    }
+};
+
+// Reads values back from one section of a mapped snapshot
+// Any read past the end of the section, or an array whose length does not
+// match the structure it is restored into, means the snapshot does not fit
+// this simulator and exits with an error.
+class SnapshotReader {
+private:
+    const uint8_t* base; // start of the section; arrays are aligned relative to it
+    const uint8_t* cursor;
+    const uint8_t* end;
+
+    void read(void* bytes, size_t length) {
+        if (size_t(end - cursor) < length) {
+            corrupt();
+        }
+        memcpy(bytes, cursor, length);
+        cursor += length;
+    }
+
+    void align() {
+        size_t padding = (8 - size_t(cursor - base) % 8) % 8;
+        cursor += (size_t(end - cursor) < padding) ? size_t(end - cursor) : padding;
+    }
+
+public:
+    SnapshotReader(const uint8_t* begin, const uint8_t* end) : base(begin), cursor(begin), end(end) {
+    }
+
+    // Exits because the state read back cannot be what a save() method wrote;
+    // restore() methods call it when what they read is inconsistent
+    static void corrupt() {
+        printf("Error: Snapshot is truncated, corrupt or does not match the configuration.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    template <class T>
+    void get(T* value) {
+        this->read(value, sizeof(*value));
+    }
+
+    // Restores an array into values, which must already have its length
+    template <class T>
+    void getVector(std::vector<T>* values) {
+        uint64_t count;
+        this->get(&count);
+        if (count != values->size()) {
+            corrupt();
+        }
+        this->read(values->data(), values->size() * sizeof(T));
+        this->align();
+    }
+
+    bool atEnd() const {
+        return cursor == end;
+    }
+};
+
+// A snapshot file mapped into memory
+class Snapshot {
+private:
+    const uint8_t* map;
+    size_t mapSize;
+    uint64_t records;
+    uint32_t hierarchyCount;
+    uint64_t traceDigest;
+
+    const uint8_t* getEntry(uint32_t index) const {
+        return map + SNAPSHOT_HEADER_SIZE + size_t(index) * SNAPSHOT_ENTRY_SIZE;
+    }
+
+public:
+    Snapshot() : map(nullptr), mapSize(0), records(0), hierarchyCount(0), traceDigest(0) {
+    }
+
+    ~Snapshot() {
+        if (map != nullptr) {
+            munmap(const_cast<uint8_t*>(map), mapSize);
+        }
+    }
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    // Maps a snapshot and checks its header; exits if it is not a snapshot this simulator can read
+    bool open(const char* path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < SNAPSHOT_HEADER_SIZE) {
+            ::close(fd);
+            printf("Error: %s is not a cache snapshot.\n", path);
+            exit(EXIT_FAILURE);
+        }
+        void* mapped = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        map = static_cast<const uint8_t*>(mapped);
+        mapSize = size_t(st.st_size);
+        uint16_t version;
+        memcpy(&version, map + 4, sizeof(version));
+        if (memcmp(map, SNAPSHOT_MAGIC, 4) != 0) {
+            printf("Error: %s is not a cache snapshot.\n", path);
+            exit(EXIT_FAILURE);
+        }
+        if (version != SNAPSHOT_VERSION) {
+            printf("Error: Snapshot %s has version %u; this simulator reads version %u.\n", path, version, SNAPSHOT_VERSION);
+            exit(EXIT_FAILURE);
+        }
+        memcpy(&records, map + 8, sizeof(records));
+        memcpy(&hierarchyCount, map + 16, sizeof(hierarchyCount));
+        memcpy(&traceDigest, map + 24, sizeof(traceDigest));
+        if ((mapSize - SNAPSHOT_HEADER_SIZE) / SNAPSHOT_ENTRY_SIZE < hierarchyCount) {
+            printf("Error: Snapshot %s is truncated or corrupt.\n", path);
+            exit(EXIT_FAILURE);
+        }
+        return true;
+    }
+
+    // Requests of the trace simulated before the snapshot was taken
+    uint64_t getRecords() const {
+        return records;
+    }
+
+    // Digest of those requests
+    uint64_t getTraceDigest() const {
+        return traceDigest;
+    }
+
+    uint32_t getHierarchyCount() const {
+        return hierarchyCount;
+    }
+
+    // Configuration the hierarchy at index was built with
+    cache_params_t getParams(uint32_t index) const {
+        uint32_t fields[SNAPSHOT_PARAM_COUNT];
+        memcpy(fields, this->getEntry(index), sizeof(fields));
+        cache_params_t params;
+        params.BLOCKSIZE = fields[0];
+        params.L1_SIZE = fields[1];
+        params.L1_ASSOC = fields[2];
+        params.L2_SIZE = fields[3];
+        params.L2_ASSOC = fields[4];
+        params.PREF_N = fields[5];
+        params.PREF_M = fields[6];
+        params.REPL_POLICY = fields[7];
+        return params;
+    }
+
+    // State of the hierarchy at index
+    SnapshotReader getSection(uint32_t index) const {
+        uint64_t location[2];
+        memcpy(location, this->getEntry(index) + SNAPSHOT_PARAM_COUNT * 4, sizeof(location));
+        if (location[0] > mapSize || location[1] > mapSize - location[0]) {
+            printf("Error: Snapshot is truncated or corrupt.\n");
+            exit(EXIT_FAILURE);
+        }
+        return SnapshotReader(map + location[0], map + location[0] + location[1]);
+    }
+
+    // Table entry of a hierarchy as written by a snapshot writer
+    static void encodeEntry(const cache_params_t& params, uint64_t offset, uint64_t length, uint8_t* entry) {
+        uint32_t fields[SNAPSHOT_PARAM_COUNT] = {
+            params.BLOCKSIZE, params.L1_SIZE, params.L1_ASSOC, params.L2_SIZE,
+            params.L2_ASSOC, params.PREF_N, params.PREF_M, params.REPL_POLICY
+        };
+        uint64_t location[2] = {offset, length};
+        memcpy(entry, fields, sizeof(fields));
+        memcpy(entry + sizeof(fields), location, sizeof(location));
+    }
+
+    // Returns true if two configurations build identical hierarchies
+    static bool sameParams(const cache_params_t& a, const cache_params_t& b) {
+        return a.BLOCKSIZE == b.BLOCKSIZE && a.L1_SIZE == b.L1_SIZE && a.L1_ASSOC == b.L1_ASSOC
+            && a.L2_SIZE == b.L2_SIZE && a.L2_ASSOC == b.L2_ASSOC && a.PREF_N == b.PREF_N
+            && a.PREF_M == b.PREF_M && a.REPL_POLICY == b.REPL_POLICY;
+    }
+};
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <vector>
+#include <unordered_map>
+
+// Stack-distance (Mattson) analysis
+//
+// LRU has the inclusion property: for a fixed number of sets, a request hits
+// in an A-way cache exactly when fewer than A other blocks of its set were
+// touched since the previous request to the same block (its stack distance).
+// So one histogram of stack distances per set count gives the miss counts of
+// every associativity, i.e. of every cache size with that many sets. Since
+// the caches are write-back write-allocate, reads and writes both reference
+// the block and are counted the same way as Cache counts them.
+//
+// Distances are found with a Fenwick (binary indexed) tree per set count.
+// Each set gets its own segment of the tree, one position per request to the
+// set in order; a position is 1 while it holds the most recent request of
+// its block. The distance of a request is then the number of ones strictly
+// between its block's previous request and itself, an O(log n) query.
+// Requests are indexed, and counted, in 32 bits, with one value left for NO_PREVIOUS
+#define STACK_DISTANCE_MAX_REQUESTS 0xFFFFFFFEu
+
+class StackDistance {
+private:
+    // Fenwick tree over positions 0..n-1 holding 0/1 marks
+    class FenwickTree {
+    private:
+        std::vector<uint32_t> tree;
+
+    public:
+        FenwickTree(size_t n) : tree(n + 1, 0) {
+        }
+
+        void add(size_t position, int32_t delta) {
+            for (size_t i = position + 1; i < tree.size(); i += i & (0 - i)) {
+                tree[i] += delta;
+            }
+        }
+
+        // Sum of positions 0..position-1
+        uint32_t prefixSum(size_t position) const {
+            uint32_t sum = 0;
+            for (size_t i = position; i > 0; i -= i & (0 - i)) {
+                sum += tree[i];
+            }
+            return sum;
+        }
+    };
+
+    uint32_t blocksize;
+    uint32_t blockOffsetBitCount;
+    const std::vector<TraceRecord>& records;
+    std::vector<uint32_t> previous; // index of the previous request to the same block, NO_PREVIOUS if none
+
+    static const uint32_t NO_PREVIOUS = 0xFFFFFFFFu;
+
+public:
+    // Stack distance histograms of one set count
+    // readDistances[d] / writeDistances[d] count requests with distance d, for
+    // d below the largest associativity of interest; farther and first
+    // references are counted in readsBeyond / writesBeyond
+    struct Histogram {
+        uint32_t setCount;
+        std::vector<uint32_t> readDistances;
+        std::vector<uint32_t> writeDistances;
+        uint32_t readsBeyond;
+        uint32_t writesBeyond;
+        uint32_t reads;
+        uint32_t writes;
+
+        // Read and write misses of an assoc-way cache with this many sets
+        void getMisses(uint32_t assoc, uint32_t* readMisses, uint32_t* writeMisses) const {
+            *readMisses = readsBeyond;
+            *writeMisses = writesBeyond;
+            for (size_t d = assoc; d < readDistances.size(); ++d) {
+                *readMisses += readDistances[d];
+                *writeMisses += writeDistances[d];
+            }
+        }
+    };
+
+    StackDistance(uint32_t blocksize, const std::vector<TraceRecord>& records)
+        : blocksize(blocksize), blockOffsetBitCount(0), records(records), previous(records.size()) {
+        while ((1u << blockOffsetBitCount) < blocksize) {
+            blockOffsetBitCount++;
+        }
+        // The previous request to the same block does not depend on the set count
+        std::unordered_map<uint32_t, uint32_t> lastRequest;
+        lastRequest.reserve(records.size() / 4);
+        for (size_t i = 0; i < records.size(); ++i) {
+            uint32_t block = records[i].addr >> blockOffsetBitCount;
+            auto found = lastRequest.find(block);
+            if (found == lastRequest.end()) {
+                previous[i] = NO_PREVIOUS;
+                lastRequest.emplace(block, uint32_t(i));
+            }
+            else {
+                previous[i] = found->second;
+                found->second = uint32_t(i);
+            }
+        }
+    }
+
+    // Histogram of stack distances below maxAssoc for a cache with setCount sets
+    Histogram analyse(uint32_t setCount, uint32_t maxAssoc) const {
+        Histogram histogram;
+        histogram.setCount = setCount;
+        histogram.readDistances.assign(maxAssoc, 0);
+        histogram.writeDistances.assign(maxAssoc, 0);
+        histogram.readsBeyond = 0;
+        histogram.writesBeyond = 0;
+        histogram.reads = 0;
+        histogram.writes = 0;
+
+        // Lay out the sets' timelines one after the other
+        uint32_t indexMask = setCount - 1;
+        std::vector<uint32_t> segmentStart(setCount + 1, 0);
+        for (const TraceRecord& record : records) {
+            segmentStart[((record.addr >> blockOffsetBitCount) & indexMask) + 1]++;
+        }
+        for (uint32_t set = 0; set < setCount; ++set) {
+            segmentStart[set + 1] += segmentStart[set];
+        }
+        std::vector<uint32_t> nextPosition(segmentStart.begin(), segmentStart.end() - 1);
+        std::vector<uint32_t> position(records.size()); // tree position of each request
+
+        FenwickTree marks(records.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            uint32_t set = (records[i].addr >> blockOffsetBitCount) & indexMask;
+            uint32_t now = nextPosition[set]++;
+            position[i] = now;
+            bool isWrite = (records[i].rw == 'w');
+            if (isWrite) {
+                histogram.writes++;
+            }
+            else {
+                histogram.reads++;
+            }
+            uint64_t distance = 0xFFFFFFFFu;
+            if (previous[i] != NO_PREVIOUS) {
+                uint32_t before = position[previous[i]];
+                distance = marks.prefixSum(now) - marks.prefixSum(before + 1);
+                marks.add(before, -1);
+            }
+            marks.add(now, 1);
+            if (distance < maxAssoc) {
+                (isWrite ? histogram.writeDistances : histogram.readDistances)[distance]++;
+            }
+            else if (isWrite) {
+                histogram.writesBeyond++;
+            }
+            else {
+                histogram.readsBeyond++;
+            }
+        }
+        return histogram;
+    }
+
+    // Miss-ratio curve: one CSV row for every power-of-two set count and every
+    // associativity whose cache holds at most maxSize bytes
+    void printMissRatioCurve(uint32_t maxSize, FILE* out) const {
+        fprintf(out, "BLOCKSIZE,sets,assoc,size,reads,read_misses,writes,write_misses,miss_rate\n");
+        uint32_t maxBlocks = maxSize / blocksize;
+        for (uint32_t setCount = 1; setCount != 0 && setCount <= maxBlocks; setCount *= 2) {
+            uint32_t maxAssoc = maxBlocks / setCount;
+            Histogram histogram = this->analyse(setCount, maxAssoc);
+            uint32_t requests = histogram.reads + histogram.writes;
+            // Each way more turns the requests at distance assoc - 1 into hits
+            uint32_t readMisses, writeMisses;
+            histogram.getMisses(1, &readMisses, &writeMisses);
+            for (uint32_t assoc = 1; assoc <= maxAssoc; ++assoc) {
+                if (assoc > 1) {
+                    readMisses -= histogram.readDistances[assoc - 1];
+                    writeMisses -= histogram.writeDistances[assoc - 1];
+                }
+                double missRate = (requests != 0) ? double(readMisses + writeMisses) / double(requests) : 0.0;
+                fprintf(out, "%u,%u,%u,%u,%u,%u,%u,%u,%.4f\n", blocksize, setCount, assoc, setCount * assoc * blocksize,
+                        histogram.reads, readMisses, histogram.writes, writeMisses, missRate);
+            }
+        }
+        fflush(out);
+    }
+};
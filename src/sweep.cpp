@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <vector>
+#include <atomic>
+#include <thread>
+
+// Design-space sweeps: many cache hierarchies simulated over a single pass
+// of the trace.
+//
+// A sweep spec lists configurations, one line per group, with the seven
+// fields of the command line in the same order and an optional replacement policy:
+//    BLOCKSIZE L1_SIZE L1_ASSOC L2_SIZE L2_ASSOC PREF_N PREF_M [POLICY]
+// Each numeric field is one of
+//    V            a single value
+//    A,B,C        a list of values
+//    LO..HI       LO, 2*LO, 4*LO, ... up to HI (power-of-two sizes and associativities)
+//    LO..HI+S     LO, LO+S, LO+2*S, ... up to HI
+//    full         (associativity fields only) fully associative for the level's size
+// POLICY is a policy name or a comma separated list of them (lru,plru,...);
+// without it the line uses the policy given with --policy (LRU by default).
+// A line stands for every combination of its fields. Text after '#' is
+// a comment. Combinations that do not describe a valid cache are skipped
+// with a warning. Every value must fit in 32 bits, a field may stand for at
+// most SWEEP_MAX_FIELD_VALUES values, and the spec for at most
+// SWEEP_MAX_CONFIGS configurations. For example
+//    32 1024..1048576 1,2,4,8,full 0 0 0 0
+// is the L1 size/associativity grid of experiments/experiment1_g1g2.py.
+// --victim-cache, --miss-cache and --inclusion apply to every configuration;
+// victim and miss cache hits show up as fewer misses in the result rows.
+// With --timing every row ends with the hit latencies, the cycles, the stall
+// cycles and the AMAT of its configuration; hit latencies that are not given
+// are derived from each configuration's sizes and associativities.
+// With --result-cache only the configurations whose results are not in the
+// cache are simulated (see src/resultcache.cpp).
+
+// Marks a "full" associativity until the level's size is known
+#define SWEEP_ASSOC_FULL 0xFFFFFFFFu
+#define SWEEP_MAX_FIELD_VALUES 4096
+#define SWEEP_MAX_CONFIGS 65536
+
+class Sweep {
+private:
+    // Parses a decimal number from 0 to UINT32_MAX at text and sets *end past it
+    // strtoull() alone would also take a sign or leading spaces
+    static bool parseNumber(const char* text, char** end, uint32_t* value) {
+        if (!isdigit((unsigned char) *text)) {
+            return false;
+        }
+        errno = 0;
+        unsigned long long parsed = strtoull(text, end, 10);
+        if (errno != 0 || parsed > UINT32_MAX) {
+            return false;
+        }
+        *value = uint32_t(parsed);
+        return true;
+    }
+
+    // Parses one field of a spec line into its list of values; returns an
+    // empty string, or the reason the field is not valid
+    static const char* parseField(const char* text, bool isAssoc, std::vector<uint32_t>* values) {
+        static const char* const malformed = "expected a value from 0 to 4294967295, a list or a range";
+        static const char* const tooMany = "a field stands for at most 4096 values (SWEEP_MAX_FIELD_VALUES)";
+        values->clear();
+        if (isAssoc && strcmp(text, "full") == 0) {
+            values->push_back(SWEEP_ASSOC_FULL);
+            return "";
+        }
+        const char* range = strstr(text, "..");
+        if (range != nullptr) {
+            char* end;
+            uint32_t lo, hi;
+            if (!parseNumber(text, &end, &lo) || end != range || !parseNumber(range + 2, &end, &hi)) {
+                return malformed;
+            }
+            uint32_t step = 0; // 0 means doubling
+            if (*end == '+' && (!parseNumber(end + 1, &end, &step) || step == 0)) {
+                return malformed;
+            }
+            if (*end != '\0' || lo > hi || (step == 0 && lo == 0)) {
+                return malformed;
+            }
+            if (step != 0 && (hi - lo) / step >= SWEEP_MAX_FIELD_VALUES) {
+                return tooMany;
+            }
+            for (uint64_t value = lo; value <= hi; value = (step == 0) ? value * 2 : value + step) {
+                values->push_back(uint32_t(value));
+            }
+            return "";
+        }
+        // Single value or comma separated list
+        const char* cursor = text;
+        while (true) {
+            char* end;
+            uint32_t value;
+            if (isAssoc && strncmp(cursor, "full", 4) == 0) {
+                value = SWEEP_ASSOC_FULL;
+                end = const_cast<char*>(cursor) + 4;
+            }
+            else if (!parseNumber(cursor, &end, &value)) {
+                return malformed;
+            }
+            if (values->size() == SWEEP_MAX_FIELD_VALUES) {
+                return tooMany;
+            }
+            values->push_back(value);
+            if (*end == '\0') {
+                return "";
+            }
+            if (*end != ',') {
+                return malformed;
+            }
+            cursor = end + 1;
+        }
+    }
+
+    // Parses the policy field of a spec line into its list of policies
+    static bool parsePolicyField(char* text, std::vector<uint32_t>* values) {
+        values->clear();
+        for (char* name = text; name != nullptr; ) {
+            char* comma = strchr(name, ',');
+            if (comma != nullptr) {
+                *comma = '\0';
+            }
+            uint32_t policy;
+            if (!parseReplacementPolicy(name, &policy)) {
+                return false;
+            }
+            values->push_back(policy);
+            name = (comma != nullptr) ? comma + 1 : nullptr;
+        }
+        return true;
+    }
+
+    static bool isPowerOfTwo(uint32_t value) {
+        return value != 0 && (value & (value - 1)) == 0;
+    }
+
+    // Checks that a level of the given size and associativity has a power-of-two number of sets
+    static bool isValidLevel(uint32_t size, uint32_t assoc, uint32_t blocksize) {
+        if (assoc == 0 || size % blocksize != 0 || (size / blocksize) % assoc != 0) {
+            return false;
+        }
+        return isPowerOfTwo(size / blocksize / assoc);
+    }
+
+public:
+    // Returns an empty string if the parameters describe a hierarchy sim can build,
+    // otherwise the reason they do not
+    static const char* validate(const cache_params_t& p) {
+        if (!isPowerOfTwo(p.BLOCKSIZE)) {
+            return "BLOCKSIZE must be a power of two";
+        }
+        if (p.L1_SIZE == 0) {
+            return "L1_SIZE must not be 0";
+        }
+        if (!isValidLevel(p.L1_SIZE, p.L1_ASSOC, p.BLOCKSIZE)) {
+            return "L1 must have a power-of-two number of sets";
+        }
+        if (p.L2_SIZE != 0 && !isValidLevel(p.L2_SIZE, p.L2_ASSOC, p.BLOCKSIZE)) {
+            return "L2 must have a power-of-two number of sets";
+        }
+        if ((p.PREF_N == 0) != (p.PREF_M == 0)) {
+            return "PREF_N and PREF_M must both be 0 or both be non-zero";
+        }
+        if (p.REPL_POLICY >= REPL_POLICY_COUNT) {
+            return "unknown replacement policy";
+        }
+        return "";
+    }
+
+    // Reads a sweep spec and appends every valid configuration it describes
+    // Lines without a policy field use defaultPolicy
+    // Returns false if the file cannot be read or a line is malformed
+    static bool parseSpec(const char* path, uint32_t defaultPolicy, std::vector<cache_params_t>* configs) {
+        FILE* fp = fopen(path, "r");
+        if (fp == (FILE *) NULL) {
+            printf("Error: Unable to open file %s\n", path);
+            return false;
+        }
+        char line[1024];
+        uint32_t lineNumber = 0;
+        bool ok = true;
+        while (ok && fgets(line, sizeof(line), fp) != NULL) {
+            lineNumber++;
+            char* comment = strchr(line, '#');
+            if (comment != nullptr) {
+                *comment = '\0';
+            }
+            std::vector<uint32_t> fields[8];
+            int fieldCount = 0;
+            for (char* token = strtok(line, " \t\r\n"); token != nullptr; token = strtok(nullptr, " \t\r\n")) {
+                bool isAssoc = (fieldCount == 2 || fieldCount == 4);
+                if (fieldCount < 7) {
+                    const char* problem = parseField(token, isAssoc, &fields[fieldCount]);
+                    if (problem[0] != '\0') {
+                        printf("Error: %s:%u: %s: %s\n", path, lineNumber, token, problem);
+                        ok = false;
+                        break;
+                    }
+                }
+                else if (fieldCount > 7 || !parsePolicyField(token, &fields[fieldCount])) {
+                    fieldCount = -1;
+                    break;
+                }
+                fieldCount++;
+            }
+            if (!ok) {
+                break;
+            }
+            if (fieldCount == 0) {
+                continue; // blank or comment line
+            }
+            if (fieldCount == 7) {
+                fields[7].assign(1, defaultPolicy);
+                fieldCount = 8;
+            }
+            if (fieldCount != 8) {
+                printf("Error: %s:%u: expected 7 or 8 fields: BLOCKSIZE L1_SIZE L1_ASSOC L2_SIZE L2_ASSOC PREF_N PREF_M [POLICY]\n", path, lineNumber);
+                ok = false;
+                break;
+            }
+            // Expand the line into every combination of its fields
+            size_t combinations = 1;
+            for (int f = 0; f < 8 && combinations <= SWEEP_MAX_CONFIGS; ++f) {
+                combinations *= fields[f].size();
+            }
+            if (combinations > SWEEP_MAX_CONFIGS - configs->size()) {
+                printf("Error: %s:%u: the spec stands for more than %u configurations\n", path, lineNumber, SWEEP_MAX_CONFIGS);
+                ok = false;
+                break;
+            }
+            for (size_t c = 0; c < combinations; ++c) {
+                uint32_t value[8];
+                size_t rest = c;
+                for (int f = 7; f >= 0; --f) {
+                    value[f] = fields[f][rest % fields[f].size()];
+                    rest /= fields[f].size();
+                }
+                cache_params_t params;
+                params.BLOCKSIZE = value[0];
+                params.L1_SIZE   = value[1];
+                params.L1_ASSOC  = value[2];
+                params.L2_SIZE   = value[3];
+                params.L2_ASSOC  = value[4];
+                params.PREF_N    = value[5];
+                params.PREF_M    = value[6];
+                params.REPL_POLICY = value[7];
+                if (params.BLOCKSIZE != 0 && params.L1_ASSOC == SWEEP_ASSOC_FULL) {
+                    params.L1_ASSOC = params.L1_SIZE / params.BLOCKSIZE;
+                }
+                if (params.BLOCKSIZE != 0 && params.L2_ASSOC == SWEEP_ASSOC_FULL) {
+                    params.L2_ASSOC = params.L2_SIZE / params.BLOCKSIZE;
+                }
+                if (params.L2_SIZE == 0) {
+                    params.L2_ASSOC = 0;
+                }
+                const char* problem = validate(params);
+                if (problem[0] != '\0') {
+                    fprintf(stderr, "Warning: %s:%u: skipping %u %u %u %u %u %u %u: %s\n", path, lineNumber,
+                            params.BLOCKSIZE, params.L1_SIZE, params.L1_ASSOC, params.L2_SIZE, params.L2_ASSOC,
+                            params.PREF_N, params.PREF_M, problem);
+                    continue;
+                }
+                configs->push_back(params);
+            }
+        }
+        fclose(fp);
+        return ok;
+    }
+
+    // Writes one result row per configuration, in the order they were given
+    static void printResults(FILE* out, const std::vector<sim_results_t>& results, bool timed) {
+        CacheHierarchy::printResultHeader(out, timed);
+        for (auto& result : results) {
+            CacheHierarchy::printResultRow(out, result, timed);
+        }
+        fflush(out);
+    }
+
+    // Simulates every configuration over one pass of the trace and sets
+    // results to their results, in the order they were given
+    // The trace is decoded a batch at a time (on the pipeline's decoder thread)
+    // and each batch is fed to every hierarchy in turn, so decoding is paid
+    // once however many configurations there are.
+    // With --restore every hierarchy starts from its state in the snapshot, and
+    // with --checkpoint the state of all of them is saved in one snapshot.
+    static void run(const std::vector<cache_params_t>& configs, TraceReader& trace, const sim_options_t& options, std::vector<sim_results_t>* results) {
+        std::vector<CacheHierarchy*> hierarchies;
+        hierarchies.reserve(configs.size());
+        for (auto& params : configs) {
+            hierarchies.push_back(CacheHierarchy::create(params));
+            hierarchies.back()->configure(options);
+        }
+        uint64_t restored = 0;
+        TraceDigest traceDigest;
+        if (options.restoreFile != nullptr) {
+            restored = CacheHierarchy::restoreSnapshot(options.restoreFile, hierarchies, trace, &traceDigest);
+        }
+        CheckpointRunner runner(hierarchies, options.checkpointFile, options.checkpointAt, restored, traceDigest);
+        TracePipeline pipeline(trace);
+        const TraceRecord* batch;
+        size_t count;
+        while ((batch = pipeline.next(&count)) != nullptr) {
+            runner.run(batch, count);
+        }
+        runner.finish();
+        results->clear();
+        for (auto& hierarchy : hierarchies) {
+            results->push_back(hierarchy->getResults());
+            delete hierarchy;
+        }
+    }
+
+    // Same as run() but spread over threadCount worker threads
+    // The whole trace is decoded up front into one buffer that workers only read.
+    // Workers take the next unsimulated configuration from a shared index, build
+    // its hierarchy themselves and keep its results locally until they are
+    // joined, so the index is the only memory written by more than one thread.
+    // Each hierarchy (and every counter in it, memory traffic included) is
+    // allocated and updated by a single worker; with per-thread malloc arenas
+    // this also keeps different workers' counters off the same cache lines.
+    // A snapshot to restore is mapped once and each worker restores its own
+    // hierarchies from it; checkpoints are only written by run().
+    static void runParallel(const std::vector<cache_params_t>& configs, TraceReader& trace, unsigned threadCount, const sim_options_t& options,
+                            std::vector<sim_results_t>* results) {
+        Snapshot snapshot;
+        if (options.restoreFile != nullptr) {
+            CacheHierarchy::openSnapshot(options.restoreFile, configs.size(), &snapshot);
+            TraceDigest traceDigest;
+            CacheHierarchy::skipRestoredRequests(trace, snapshot, &traceDigest);
+        }
+        std::vector<TraceRecord> records;
+        trace.readAll(&records);
+        const std::vector<TraceRecord>& sharedRecords = records;
+
+        std::atomic<size_t> nextConfig(0);
+        std::vector<std::vector<sim_results_t>> workerResults(threadCount);
+        std::vector<std::vector<size_t>> workerConfigs(threadCount);
+        std::vector<std::thread> workers;
+        workers.reserve(threadCount);
+        for (unsigned t = 0; t < threadCount; ++t) {
+            workers.emplace_back([&, t]() {
+                std::vector<sim_results_t>& results = workerResults[t];
+                std::vector<size_t>& done = workerConfigs[t];
+                size_t index;
+                while ((index = nextConfig.fetch_add(1)) < configs.size()) {
+                    CacheHierarchy* hierarchy = CacheHierarchy::create(configs[index]);
+                    hierarchy->configure(options);
+                    if (options.restoreFile != nullptr) {
+                        CacheHierarchy::restoreSnapshot(snapshot, uint32_t(index), hierarchy);
+                    }
+                    hierarchy->run(sharedRecords.data(), sharedRecords.size());
+                    hierarchy->drainWriteBuffers();
+                    results.push_back(hierarchy->getResults());
+                    delete hierarchy;
+                    done.push_back(index);
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        // Merge the workers' results back into spec order
+        results->resize(configs.size());
+        for (unsigned t = 0; t < threadCount; ++t) {
+            for (size_t i = 0; i < workerConfigs[t].size(); ++i) {
+                (*results)[workerConfigs[t][i]] = workerResults[t][i];
+            }
+        }
+    }
+};
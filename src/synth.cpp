@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <vector>
+
+// Synthetic access patterns for tracegen
+//
+// Every pattern picks units of `align` bytes out of a footprint of
+// `footprint` bytes starting at `base`; unit u is at address base + u * align:
+//    seq     `streams` interleaved sequential streams, each walking its own
+//            slice of the footprint one unit a request and wrapping around
+//    stride  the same with a step of `stride` bytes
+//    random  units drawn uniformly
+//    zipf    units drawn by a Zipf distribution over their popularity rank,
+//            P(rank k) ~ 1 / k^zipfExponent; the ranks are scattered over the
+//            footprint, so the hot units do not all share a few sets
+//    chase   a pointer chase: one random cycle through every unit (Sattolo's
+//            algorithm), so no request is near the one before it
+//    mix     `phaseRecords` requests of each pattern of `mix` in turn; each
+//            pattern carries on where its last phase stopped
+// Each request is a write with probability `writes`.
+//
+// Traces are generated in chunks of SYNTH_CHUNK_RECORDS requests. A chunk has
+// a random generator of its own, seeded from the seed and the chunk number,
+// and the position of the sequential patterns follows from the number of the
+// request, so chunks can be generated on any number of threads and the trace
+// depends only on the options. A pointer chase starts every chunk at a random
+// unit.
+
+enum SynthPattern {SYNTH_SEQ=0, SYNTH_STRIDE, SYNTH_RANDOM, SYNTH_ZIPF, SYNTH_CHASE, SYNTH_MIX, SYNTH_PATTERN_COUNT};
+
+static const char* const synthPatternNames[SYNTH_PATTERN_COUNT] = {"seq", "stride", "random", "zipf", "chase", "mix"};
+
+#define SYNTH_CHUNK_RECORDS (1 << 18)
+// Units of a pointer chase; its cycle takes 4 bytes a unit
+#define SYNTH_MAX_CHASE_UNITS (1u << 28)
+// Prime multiplier that scatters Zipf ranks over the units
+#define SYNTH_SCATTER 2654435761u
+
+// Parameters of a synthetic trace
+typedef
+struct {
+   uint32_t pattern;		// a SynthPattern
+   uint64_t seed;
+   uint32_t base;		// first address of the footprint
+   uint64_t footprint;		// bytes
+   uint32_t align;		// bytes a request covers; addresses are multiples of it from base
+   double writes;		// fraction of requests that are writes
+   uint32_t streams;		// seq and stride: interleaved streams
+   uint32_t stride;		// stride: bytes between the requests of a stream
+   double zipfExponent;
+   uint32_t mix[SYNTH_MIX];	// mix: the patterns taking turns...
+   uint32_t mixCount;		// ...and how many there are
+   uint64_t phaseRecords;	// mix: requests of a phase
+} synth_params_t;
+
+// SplitMix64; one generator per chunk
+class SplitMix64 {
+private:
+    uint64_t state;
+
+public:
+    SplitMix64(uint64_t seed) : state(seed) {
+    }
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, n)
+    uint32_t below(uint32_t n) {
+        return uint32_t(((this->next() >> 32) * n) >> 32);
+    }
+
+    // Uniform in [0, 1)
+    double uniform() {
+        return double(this->next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+// Draws ranks 1 to n with P(k) ~ 1 / k^s in constant time and no tables, by
+// rejection-inversion (Hormann and Derflinger, 1996)
+class ZipfSampler {
+private:
+    uint32_t n;
+    double s;
+    double hIntegralX1;
+    double hIntegralN;
+    double squeeze;
+
+    // log1p(x) / x and expm1(x) / x, accurate near 0
+    static double helper1(double x) {
+        return (fabs(x) > 1e-8) ? log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    static double helper2(double x) {
+        return (fabs(x) > 1e-8) ? expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+    }
+
+    double h(double x) const {
+        return exp(-s * log(x));
+    }
+
+    double hIntegral(double x) const {
+        double logX = log(x);
+        return helper2((1.0 - s) * logX) * logX;
+    }
+
+    double hIntegralInverse(double x) const {
+        double t = x * (1.0 - s);
+        t = (t < -1.0) ? -1.0 : t;
+        return exp(helper1(t) * x);
+    }
+
+public:
+    ZipfSampler() : n(1), s(1.0), hIntegralX1(0), hIntegralN(0), squeeze(0) {
+    }
+
+    ZipfSampler(uint32_t n, double s) : n(n), s(s) {
+        hIntegralX1 = this->hIntegral(1.5) - 1.0;
+        hIntegralN = this->hIntegral(n + 0.5);
+        squeeze = 2.0 - this->hIntegralInverse(this->hIntegral(2.5) - this->h(2.0));
+    }
+
+    uint32_t sample(SplitMix64& random) const {
+        while (true) {
+            double u = hIntegralN + random.uniform() * (hIntegralX1 - hIntegralN);
+            double x = this->hIntegralInverse(u);
+            double k = floor(x + 0.5);
+            k = (k < 1.0) ? 1.0 : ((k > n) ? double(n) : k);
+            if (k - x <= squeeze || u >= this->hIntegral(k + 0.5) - this->h(k)) {
+                return uint32_t(k);
+            }
+        }
+    }
+};
+
+class TraceSynthesizer {
+private:
+    synth_params_t params;
+    uint32_t units;
+    uint32_t sliceUnits; // seq and stride: units each stream walks
+    uint64_t writeThreshold; // a request is a write if 32 random bits fall below this
+    ZipfSampler zipf;
+    std::vector<uint32_t> chase; // unit following each unit in the pointer chase
+
+    // Generates count requests of pattern, starting at its request number
+    // first; *chaseUnit is the last unit of the pointer chase
+    // The generator and the parameters are copied into locals: the records
+    // are stored through a char, which the compiler must assume aliases them.
+    void generateRun(uint32_t pattern, uint64_t first, size_t count, SplitMix64* generator, uint32_t* chaseUnit, TraceRecord* records) const {
+        SplitMix64 random = *generator;
+        uint32_t base = params.base;
+        uint32_t align = params.align;
+        uint64_t threshold = writeThreshold;
+        uint32_t units = this->units;
+        auto emit = [&](size_t i, uint32_t unit) {
+            TraceRecord record;
+            record.addr = base + unit * align;
+            record.rw = ((random.next() >> 32) < threshold) ? 'w' : 'r';
+            record.core = 0;
+            records[i] = record;
+        };
+        if (pattern == SYNTH_SEQ || pattern == SYNTH_STRIDE) {
+            // The streams take turns and all stand at the same offset in their slices
+            uint32_t streams = params.streams;
+            uint32_t slice = sliceUnits;
+            uint32_t step = (pattern == SYNTH_STRIDE) ? params.stride / align : 1;
+            uint32_t stream = uint32_t(first % streams);
+            uint64_t offset = (first / streams) % slice * step % slice;
+            step %= slice;
+            for (size_t i = 0; i < count; ++i) {
+                emit(i, stream * slice + uint32_t(offset));
+                if (++stream == streams) {
+                    stream = 0;
+                    offset += step;
+                    offset -= (offset >= slice) ? slice : 0;
+                }
+            }
+        }
+        else if (pattern == SYNTH_RANDOM) {
+            for (size_t i = 0; i < count; ++i) {
+                emit(i, random.below(units));
+            }
+        }
+        else if (pattern == SYNTH_ZIPF) {
+            for (size_t i = 0; i < count; ++i) {
+                emit(i, uint32_t((uint64_t(zipf.sample(random) - 1) * SYNTH_SCATTER) % units));
+            }
+        }
+        else {
+            const uint32_t* next = chase.data();
+            uint32_t unit = *chaseUnit;
+            for (size_t i = 0; i < count; ++i) {
+                unit = next[unit];
+                emit(i, unit);
+            }
+            *chaseUnit = unit;
+        }
+        *generator = random;
+    }
+
+public:
+    // Returns true if the trace has requests of pattern
+    static bool uses(const synth_params_t& params, uint32_t pattern) {
+        if (params.pattern != SYNTH_MIX) {
+            return params.pattern == pattern;
+        }
+        for (uint32_t i = 0; i < params.mixCount; ++i) {
+            if (params.mix[i] == pattern) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The parameters must have been checked (see tracegen.cc)
+    TraceSynthesizer(const synth_params_t& params) : params(params) {
+        units = uint32_t(params.footprint / params.align);
+        sliceUnits = units / params.streams;
+        writeThreshold = uint64_t(params.writes * 4294967296.0);
+        if (uses(params, SYNTH_ZIPF)) {
+            zipf = ZipfSampler(units, params.zipfExponent);
+        }
+        if (uses(params, SYNTH_CHASE)) {
+            // Sattolo's algorithm: a random permutation that is a single cycle
+            chase.resize(units);
+            for (uint32_t u = 0; u < units; ++u) {
+                chase[u] = u;
+            }
+            SplitMix64 random(params.seed ^ 0xC4A5E0000000000Full);
+            for (uint32_t u = units - 1; u > 0; --u) {
+                uint32_t v = random.below(u);
+                uint32_t held = chase[u];
+                chase[u] = chase[v];
+                chase[v] = held;
+            }
+        }
+    }
+
+    // Generates the requests of chunk, count of them (SYNTH_CHUNK_RECORDS
+    // except in the last chunk); safe to call from several threads at once
+    void generate(uint64_t chunk, size_t count, TraceRecord* records) const {
+        SplitMix64 random(params.seed * 0x9E3779B97F4A7C15ull + chunk);
+        random.next();
+        uint32_t chaseUnit = random.below(units);
+        uint64_t first = chunk * SYNTH_CHUNK_RECORDS;
+        if (params.pattern != SYNTH_MIX) {
+            this->generateRun(params.pattern, first, count, &random, &chaseUnit, records);
+            return;
+        }
+        // Split the chunk at the phase boundaries
+        size_t done = 0;
+        while (done < count) {
+            uint64_t request = first + done;
+            uint64_t phase = request / params.phaseRecords;
+            uint64_t offset = request % params.phaseRecords;
+            size_t length = size_t(params.phaseRecords - offset);
+            length = (length > count - done) ? count - done : length;
+            // Request number within the pattern, counting its earlier phases only
+            uint64_t patternRequest = (phase / params.mixCount) * params.phaseRecords + offset;
+            this->generateRun(params.mix[phase % params.mixCount], patternRequest, length, &random, &chaseUnit, records + done);
+            done += length;
+        }
+    }
+};
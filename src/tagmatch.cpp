@@ -0,0 +1,82 @@
+#include <inttypes.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TAG_MATCH_X86 1
+#else
+#define TAG_MATCH_X86 0
+#endif
+
+// Tag match kernels
+//
+// findTag() compares a tag against the packed tag row of one set (the
+// TagStore keeps a set's tags contiguous) and returns the index of the first
+// way holding it, or count if none does. The SSE2 and AVX2 kernels compare 4
+// and 8 ways per instruction and finish any remainder with the narrower
+// kernels, so they never read past the end of the row. The widest kernel the
+// CPU supports is picked once at startup; rows shorter than a vector skip the
+// kernels entirely.
+
+typedef uint32_t (*tag_match_fn_t)(const uint32_t* tags, uint32_t count, uint32_t tag);
+
+static uint32_t findTagScalar(const uint32_t* tags, uint32_t count, uint32_t tag) {
+    for (uint32_t way = 0; way < count; ++way) {
+        if (tags[way] == tag) {
+            return way;
+        }
+    }
+    return count;
+}
+
+#if TAG_MATCH_X86
+__attribute__((target("sse2")))
+static uint32_t findTagSSE2(const uint32_t* tags, uint32_t count, uint32_t tag) {
+    const __m128i needle = _mm_set1_epi32(int(tag));
+    uint32_t way = 0;
+    for (; way + 4 <= count; way += 4) {
+        __m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tags + way));
+        int hits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(row, needle)));
+        if (hits != 0) {
+            return way + __builtin_ctz(hits);
+        }
+    }
+    return way + findTagScalar(tags + way, count - way, tag);
+}
+
+__attribute__((target("avx2")))
+static uint32_t findTagAVX2(const uint32_t* tags, uint32_t count, uint32_t tag) {
+    const __m256i needle = _mm256_set1_epi32(int(tag));
+    uint32_t way = 0;
+    for (; way + 8 <= count; way += 8) {
+        __m256i row = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tags + way));
+        int hits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(row, needle)));
+        if (hits != 0) {
+            return way + __builtin_ctz(hits);
+        }
+    }
+    return way + findTagSSE2(tags + way, count - way, tag);
+}
+#endif
+
+// Picks the widest kernel this CPU supports
+static tag_match_fn_t selectTagMatch() {
+#if TAG_MATCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return findTagAVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return findTagSSE2;
+    }
+#endif
+    return findTagScalar;
+}
+
+static const tag_match_fn_t tagMatchKernel = selectTagMatch();
+
+// Index of the first of count tags equal to tag, or count if there is none
+static inline uint32_t findTag(const uint32_t* tags, uint32_t count, uint32_t tag) {
+    if (count < 4) {
+        return findTagScalar(tags, count, tag);
+    }
+    return tagMatchKernel(tags, count, tag);
+}
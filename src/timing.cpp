@@ -0,0 +1,405 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+
+// Timing model: hit latencies, MSHRs and the memory latency
+//
+// The cache levels are functional: a request changes their contents at once.
+// The timing model follows each request of the trace after the levels have
+// served it and works out when it would have completed on a core that issues
+// one request per cycle, in order, without waiting for earlier ones to
+// complete (non-blocking caches):
+//    an L1 hit completes after the L1 hit latency
+//    an L1 miss takes an L1 MSHR (miss status holding register) until its
+//    block arrives: after the L2 hit latency if L2 holds it, and after the
+//    memory latency on top of that if L2 misses too, which also takes an L2
+//    MSHR; without an L2 the block comes from memory after the L1 hit latency
+//    a request for a block an MSHR is still fetching is a secondary miss: it
+//    merges into that MSHR and completes when the block arrives, although
+//    the functional level already holds the block
+//    a primary miss that finds every L1 MSHR busy stalls the core until one
+//    frees; one that finds every L2 MSHR busy waits for it while the core
+//    carries on
+// A request's access time runs from the cycle the core first tried to issue
+// it to the cycle it completed, so it includes any stall for an L1 MSHR; the
+// average memory access time (AMAT) is their mean. Writebacks, writes passed
+// through or around a level and prefetches are off the critical path and take
+// no time, so a write L1 does not allocate completes like a hit. Hits in the
+// stream buffers and the victim and miss caches count as hits of their level.
+//
+// A hit latency of 0 is derived from the size and associativity of the level
+// with hitLatencyTable, rough figures for a core at about 3 GHz in the spirit
+// of CACTI: larger and more associative caches take longer to hit.
+//
+// With a DramController (dram.cpp) a block comes from memory when the
+// controller has served its read instead of after the memory latency, and the
+// controller also sees the writes and prefetches the last level sends it.
+
+#define TIMING_MAX_MSHRS 64
+#define TIMING_MAX_LATENCY 100000
+#define TIMING_L1_MSHRS 8 // MSHRs of L1 and L2 unless given
+#define TIMING_L2_MSHRS 16
+#define TIMING_MEMORY_LATENCY 100 // cycles from an L2 miss (or an L1 miss without L2) to its block, unless given
+
+// Hit latency in cycles of a 1 KB, 2 KB, 4 KB, ... cache with up to 2 ways;
+// each doubling past the end adds 5 cycles
+static const uint32_t hitLatencyTable[] = {1, 1, 2, 2, 3, 4, 5, 7, 9, 11, 13, 16, 20, 24, 28, 33};
+
+#define HIT_LATENCY_TABLE_SIZE (sizeof(hitLatencyTable) / sizeof(hitLatencyTable[0]))
+
+// Hit latency of a cache of size bytes and assoc ways from hitLatencyTable
+static uint32_t deriveHitLatency(uint32_t size, uint32_t assoc) {
+    uint32_t index = 0;
+    while ((2048u << index) <= size && index < 31) {
+        index++;
+    }
+    uint32_t latency;
+    if (index < HIT_LATENCY_TABLE_SIZE) {
+        latency = hitLatencyTable[index];
+    }
+    else {
+        latency = hitLatencyTable[HIT_LATENCY_TABLE_SIZE - 1] + 5 * uint32_t(index + 1 - HIT_LATENCY_TABLE_SIZE);
+    }
+    // Wider sets compare more tags on every lookup
+    if (assoc > 32) {
+        latency += 3;
+    }
+    else if (assoc > 8) {
+        latency += 2;
+    }
+    else if (assoc > 2) {
+        latency += 1;
+    }
+    return latency;
+}
+
+// Counters of the MSHRs of one level
+typedef
+struct {
+   uint64_t primary;	// misses that took an MSHR
+   uint64_t secondary;	// misses merged into the MSHR already fetching their block
+   uint64_t fullStalls;	// primary misses that found every MSHR busy...
+   uint64_t stallCycles;	// ...and the cycles they waited for one
+} mshr_counters_t;
+
+// The MSHRs of one level
+class MshrFile {
+private:
+    std::vector<uint32_t> blocks; // block number (tag and index) each MSHR fetches
+    std::vector<uint64_t> ready; // cycle its block arrives; the MSHR is busy until then
+    uint64_t accounted; // cycle up to which the occupancy histogram is complete
+
+public:
+    static const uint32_t NO_MSHR = 0xFFFFFFFFu;
+
+    mshr_counters_t counters;
+    std::vector<uint64_t> occupancy; // cycles during which 0, 1, ... MSHRs were busy
+
+    MshrFile(uint32_t count) : blocks(count, 0), ready(count, 0), accounted(0), occupancy(count + 1, 0) {
+        memset(&counters, 0, sizeof(counters));
+    }
+
+    uint32_t getCount() const {
+        return uint32_t(blocks.size());
+    }
+
+    // Adds the cycles up to now to the occupancy histogram
+    void advance(uint64_t now) {
+        while (accounted < now) {
+            uint32_t busy = 0;
+            uint64_t next = now;
+            for (uint32_t i = 0; i < ready.size(); ++i) {
+                if (ready[i] > accounted) {
+                    busy++;
+                    next = (ready[i] < next) ? ready[i] : next;
+                }
+            }
+            occupancy[busy] += next - accounted;
+            accounted = next;
+        }
+    }
+
+    // The MSHR fetching block at cycle now, or NO_MSHR
+    uint32_t find(uint32_t block, uint64_t now) const {
+        for (uint32_t i = 0; i < blocks.size(); ++i) {
+            if (ready[i] > now && blocks[i] == block) {
+                return i;
+            }
+        }
+        return NO_MSHR;
+    }
+
+    uint64_t getReady(uint32_t mshr) const {
+        return ready[mshr];
+    }
+
+    // Takes an MSHR at cycle now or, if every one is busy, when the first
+    // frees; sets *start to that cycle. The caller hands it a block with hold().
+    uint32_t acquire(uint64_t now, uint64_t* start) {
+        uint32_t first = 0;
+        for (uint32_t i = 1; i < ready.size(); ++i) {
+            first = (ready[i] < ready[first]) ? i : first;
+        }
+        *start = now;
+        if (ready[first] > now) {
+            *start = ready[first];
+            counters.fullStalls++;
+            counters.stallCycles += *start - now;
+        }
+        this->advance(*start);
+        counters.primary++;
+        return first;
+    }
+
+    // Keeps mshr busy fetching block until cycle arrival
+    void hold(uint32_t mshr, uint32_t block, uint64_t arrival) {
+        blocks[mshr] = block;
+        ready[mshr] = arrival;
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.putVector(blocks);
+        out.putVector(ready);
+        out.putVector(occupancy);
+        out.put(accounted);
+        out.put(counters);
+    }
+
+    void restore(SnapshotReader& in) {
+        in.getVector(&blocks);
+        in.getVector(&ready);
+        in.getVector(&occupancy);
+        in.get(&accounted);
+        in.get(&counters);
+    }
+};
+
+// Times the requests of one single-core hierarchy
+class TimingModel {
+private:
+    uint32_t hitLatency[2]; // cycles; the one of L2 is 0 without an L2
+    bool derived[2]; // true if the hit latency comes from hitLatencyTable
+    uint32_t memoryLatency;
+    uint32_t blockBits; // log2 of the block size
+    MshrFile l1Mshrs;
+    MshrFile l2Mshrs; // unused without an L2
+    bool hasL2;
+    uint64_t clock; // cycle at which the next request can issue
+    uint64_t requests;
+    uint64_t accessCycles; // access times of every request, added up
+    uint64_t finish; // cycle at which the last request completes
+    DramController* dram; // times memory, or nullptr for the fixed memory latency
+    bool demandLogged; // the memory log of the current request holds the read of its block, not yet sent to dram
+
+    // Cycle at which a block the last level misses on at cycle at arrives from memory
+    uint64_t readMemory(uint32_t block, uint64_t at) {
+        if (dram == nullptr) {
+            return at + memoryLatency;
+        }
+        demandLogged = false;
+        return dram->read(block, at);
+    }
+
+    // Cycle at which the block an L1 miss fetches from cycle at arrives
+    uint64_t fetch(uint32_t block, uint64_t at, bool l2Miss) {
+        if (!hasL2) {
+            return this->readMemory(block, at);
+        }
+        uint64_t arrival = at + hitLatency[1];
+        uint32_t mshr = l2Mshrs.find(block, at);
+        if (mshr != MshrFile::NO_MSHR) {
+            l2Mshrs.counters.secondary++;
+            return (l2Mshrs.getReady(mshr) > arrival) ? l2Mshrs.getReady(mshr) : arrival;
+        }
+        if (!l2Miss) {
+            return arrival;
+        }
+        uint64_t start;
+        mshr = l2Mshrs.acquire(at, &start);
+        arrival = this->readMemory(block, start + hitLatency[1]);
+        l2Mshrs.hold(mshr, block, arrival);
+        return arrival;
+    }
+
+public:
+    // hitLatency of 0 derives a level's latency from its size and associativity; dramParams is nullptr for the fixed memory latency
+    TimingModel(const cache_params_t& params, const uint32_t latencies[2], uint32_t memoryLatency, const uint32_t mshrs[2], const dram_params_t* dramParams)
+        : memoryLatency(memoryLatency), blockBits(uint32_t(log2(params.BLOCKSIZE))), l1Mshrs(mshrs[0]),
+          l2Mshrs(mshrs[1]), hasL2(params.L2_SIZE != 0), clock(0), requests(0), accessCycles(0), finish(0),
+          dram(nullptr), demandLogged(false) {
+        if (dramParams != nullptr) {
+            dram = new DramController(*dramParams, params.BLOCKSIZE);
+        }
+        uint32_t sizes[2] = {params.L1_SIZE, params.L2_SIZE};
+        uint32_t assocs[2] = {params.L1_ASSOC, params.L2_ASSOC};
+        for (uint32_t level = 0; level < 2; ++level) {
+            derived[level] = latencies[level] == 0;
+            hitLatency[level] = derived[level] ? deriveHitLatency(sizes[level], assocs[level]) : latencies[level];
+        }
+        if (!hasL2) {
+            hitLatency[1] = 0;
+        }
+    }
+
+    ~TimingModel() {
+        delete dram;
+    }
+
+    // The model owns its DRAM controller; copying it would free it twice
+    TimingModel(const TimingModel&) = delete;
+    TimingModel& operator=(const TimingModel&) = delete;
+
+    // Times one request the levels have served; l1Miss and l2Miss tell
+    // whether it missed in L1, and whether the read L1 sent L2 missed there,
+    // and allocate whether an L1 miss fetches its block. log holds the blocks
+    // the last level read from and wrote to memory meanwhile; nullptr without dram.
+    void request(uint32_t addr, bool l1Miss, bool allocate, bool l2Miss, const MemoryLog* log) {
+        uint32_t block = addr >> blockBits;
+        uint64_t issue = clock;
+        if (log != nullptr) {
+            this->submitLogged(block, *log, issue);
+        }
+        uint64_t completion = issue + hitLatency[0];
+        uint32_t mshr = l1Mshrs.find(block, issue);
+        if (mshr != MshrFile::NO_MSHR) {
+            l1Mshrs.counters.secondary++;
+            completion = (l1Mshrs.getReady(mshr) > completion) ? l1Mshrs.getReady(mshr) : completion;
+        }
+        else if (l1Miss && allocate) {
+            // The core stalls until it has an MSHR, and issues the request then
+            mshr = l1Mshrs.acquire(clock, &issue);
+            completion = this->fetch(block, issue + hitLatency[0], l2Miss);
+            l1Mshrs.hold(mshr, block, completion);
+        }
+        // A read of the block the timing model merged into an MSHR still reaches memory
+        if (demandLogged) {
+            dram->submit(block, DRAM_READ, issue);
+            demandLogged = false;
+        }
+        requests++;
+        accessCycles += completion - clock;
+        finish = (completion > finish) ? completion : finish;
+        clock = issue + 1;
+    }
+
+    // Queues the memory requests of log that the core does not wait for at
+    // cycle at; the read of block, if there is one, is left for readMemory()
+    void submitLogged(uint32_t block, const MemoryLog& log, uint64_t at) {
+        demandLogged = false;
+        for (size_t i = 0; i < log.blocks.size(); ++i) {
+            if (log.writes[i] != 0) {
+                dram->submit(log.blocks[i], DRAM_WRITE, at);
+            }
+            else if (log.blocks[i] == block && !demandLogged) {
+                demandLogged = true;
+            }
+            else {
+                dram->submit(log.blocks[i], DRAM_PREFETCH, at);
+            }
+        }
+    }
+
+    // Completes the occupancy histograms up to the last request, and serves what the DRAM controller still holds
+    void settle() {
+        l1Mshrs.advance(finish);
+        l2Mshrs.advance(hasL2 ? finish : 0);
+        if (dram != nullptr) {
+            dram->drain();
+        }
+    }
+
+    // The DRAM controller, or nullptr if memory has a fixed latency
+    const DramController* getDram() const {
+        return dram;
+    }
+
+    uint32_t getHitLatency(uint32_t level) const {
+        return hitLatency[level - 1];
+    }
+
+    // True if the hit latency of level comes from its size and associativity
+    bool isDerived(uint32_t level) const {
+        return derived[level - 1];
+    }
+
+    uint32_t getMemoryLatency() const {
+        return memoryLatency;
+    }
+
+    const MshrFile& getMshrs(uint32_t level) const {
+        return (level == 1) ? l1Mshrs : l2Mshrs;
+    }
+
+    uint64_t getRequests() const {
+        return requests;
+    }
+
+    // Cycle at which the last request completed
+    uint64_t getCycles() const {
+        return finish;
+    }
+
+    // Cycles the core stalled for an L1 MSHR
+    uint64_t getStallCycles() const {
+        return l1Mshrs.counters.stallCycles;
+    }
+
+    double getAverageAccessTime() const {
+        return (requests != 0) ? double(accessCycles) / double(requests) : 0.0;
+    }
+
+    // AMAT from the miss rates alone, without MSHR limits or merging:
+    // L1 hit latency + L1 miss rate * (L2 hit latency + L2 miss rate * memory latency)
+    // With dram the memory latency is the mean latency of its demand reads
+    double getMissRateAccessTime(double l1MissRate, double l2MissRate) const {
+        double memory = memoryLatency;
+        if (dram != nullptr && dram->counters[DRAM_READ].requests != 0) {
+            memory = double(dram->counters[DRAM_READ].latency) / dram->counters[DRAM_READ].requests;
+        }
+        double belowL1 = hasL2 ? hitLatency[1] + l2MissRate * memory : memory;
+        return hitLatency[0] + l1MissRate * belowL1;
+    }
+
+    void save(SnapshotWriter& out) const {
+        uint32_t config[5] = {hitLatency[0], hitLatency[1], memoryLatency, l1Mshrs.getCount(), l2Mshrs.getCount()};
+        out.put(config);
+        l1Mshrs.save(out);
+        l2Mshrs.save(out);
+        out.put(clock);
+        out.put(requests);
+        out.put(accessCycles);
+        out.put(finish);
+        uint32_t hasDram = (dram != nullptr) ? 1 : 0;
+        out.put(hasDram);
+        if (dram != nullptr) {
+            dram->save(out);
+        }
+    }
+
+    void restore(SnapshotReader& in) {
+        uint32_t config[5];
+        in.get(&config);
+        if (config[0] != hitLatency[0] || config[1] != hitLatency[1] || config[2] != memoryLatency
+            || config[3] != l1Mshrs.getCount() || config[4] != l2Mshrs.getCount()) {
+            printf("Error: Snapshot was taken with a different timing configuration.\n");
+            exit(EXIT_FAILURE);
+        }
+        l1Mshrs.restore(in);
+        l2Mshrs.restore(in);
+        in.get(&clock);
+        in.get(&requests);
+        in.get(&accessCycles);
+        in.get(&finish);
+        uint32_t hasDram;
+        in.get(&hasDram);
+        if (hasDram != ((dram != nullptr) ? 1u : 0u)) {
+            printf("Error: Snapshot was taken with a different DRAM configuration.\n");
+            exit(EXIT_FAILURE);
+        }
+        if (dram != nullptr) {
+            dram->restore(in);
+        }
+    }
+};
@@ -0,0 +1,755 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <ctype.h>
+#include <algorithm>
+#include <vector>
+
+// Binary trace format
+//
+// Header (16 bytes, little endian):
+//    bytes 0-3    magic "CTRC"
+//    bytes 4-5    format version
+//    bytes 6-7    flags; TRACE_FLAG_DELTA selects the delta encoded record layout,
+//                 TRACE_FLAG_CORES marks records that carry the ID of the issuing core
+//    bytes 8-15   number of records
+//
+// Records, plain layout (5 bytes each):
+//    byte 0       bit 0 is the request type: 0 for r, 1 for w; bits 1-7 are
+//                 the core ID with TRACE_FLAG_CORES and zero otherwise
+//    bytes 1-4    address
+//
+// Records, delta layout (1 to 5 bytes each):
+//    LEB128 varint of (zigzag(addr - previous addr) << 1) | (1 if w else 0)
+//    The previous address of the first record is 0. With TRACE_FLAG_CORES
+//    each varint is followed by one byte holding the core ID.
+//
+// Text traces have one request per line, "r 7b0335b8", or with the ID of
+// the issuing core in front, "3 r 7b0335b8"; a trace uses one form throughout.
+#define TRACE_MAGIC "CTRC"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 16
+#define TRACE_PLAIN_RECORD_SIZE 5
+#define TRACE_FLAG_DELTA 0x1
+#define TRACE_FLAG_CORES 0x2
+// Core IDs are 0 to TRACE_MAX_CORES - 1
+#define TRACE_MAX_CORES 128
+
+// One decoded request of a trace
+struct TraceRecord {
+    uint32_t addr;
+    char rw;
+    uint8_t core; // core that issued the request; 0 in traces without core IDs
+};
+
+// Size of the read buffer for traces that are streamed rather than mapped
+#define TRACE_STREAM_BUFFER_SIZE (1 << 18)
+
+// Reads a trace request by request
+// Binary trace files are memory-mapped and decoded in place without copying.
+// Everything else is streamed through a read buffer: text trace files
+// ("r 7b0335b8" per line), standard input ("-"), pipes, and gzip or zstd
+// compressed input, which is decompressed by a gzip/zstd child process as
+// it is read. The format (text or binary, compressed or not) is detected
+// from the first bytes of the input; compressed standard input is fed to the
+// decompressor by a second child process, starting with the bytes already
+// read to detect it.
+class TraceReader {
+private:
+    FILE* fp; // streamed input
+    pid_t decompressor; // child process decompressing the trace into fp, 0 if none
+    pid_t feeder; // child process copying standard input to the decompressor, 0 if none
+    const uint8_t* map; // binary trace files: the whole file mapped read only
+    size_t mapSize;
+    const uint8_t* cursor; // next record to decode
+    const uint8_t* end; // one past the last record
+    std::vector<uint8_t> buffer; // streamed input: bytes read from fp
+    size_t bufferPos; // next unread byte in buffer
+    size_t bufferLength; // valid bytes in buffer
+    bool streamBinary; // streamed input is a binary trace
+    uint64_t recordCount; // records announced by the binary header
+    uint64_t recordsRead;
+    bool delta;
+    bool cores; // binary records carry core IDs
+    int textCores; // text traces: -1 before the first line, then 1 if it starts with a core ID and 0 if not
+    uint32_t prevAddr; // last decoded address for delta encoded traces
+    const char* error; // why reading stopped early, nullptr if it did not
+
+    // Stops reading with an error; next() then returns false
+    bool fail(const char* message) {
+        error = message;
+        return false;
+    }
+
+    // Checks the header of a binary trace and sets up decoding its records
+    bool parseHeader(const uint8_t* header) {
+        uint32_t version = header[4] | (header[5] << 8);
+        uint32_t flags = header[6] | (header[7] << 8);
+        recordCount = 0;
+        for (int i = 7; i >= 0; --i) {
+            recordCount = (recordCount << 8) | header[8 + i];
+        }
+        if (version != TRACE_VERSION) {
+            printf("Error: Unsupported binary trace version %u.\n", version);
+            exit(EXIT_FAILURE);
+        }
+        delta = (flags & TRACE_FLAG_DELTA) != 0;
+        cores = (flags & TRACE_FLAG_CORES) != 0;
+        return true;
+    }
+
+    // Program that decompresses data starting with these 4 bytes, or nullptr if it is not compressed
+    static const char* isCompressed(const uint8_t* magic) {
+        if (magic[0] == 0x1F && magic[1] == 0x8B) {
+            return "gzip";
+        }
+        if (magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD) {
+            return "zstd";
+        }
+        return nullptr;
+    }
+
+    // Opens a binary trace file whose header has already been recognised
+    bool openBinary(int fd, size_t size) {
+        void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        map = static_cast<const uint8_t*>(mapped);
+        mapSize = size;
+        this->parseHeader(map);
+        cursor = map + TRACE_HEADER_SIZE;
+        end = map + mapSize;
+        if (!delta && uint64_t(end - cursor) != recordCount * TRACE_PLAIN_RECORD_SIZE) {
+            printf("Error: Binary trace is truncated or corrupt.\n");
+            exit(EXIT_FAILURE);
+        }
+        return true;
+    }
+
+    // Starts "program -dc path" and streams its output; with no path the
+    // program decompresses what it reads from the file descriptor input
+    bool openDecompressor(const char* program, const char* path, int input = -1) {
+        int pipeFds[2];
+        if (pipe(pipeFds) != 0) {
+            return false;
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            ::close(pipeFds[0]);
+            ::close(pipeFds[1]);
+            return false;
+        }
+        if (pid == 0) {
+            dup2(pipeFds[1], STDOUT_FILENO);
+            ::close(pipeFds[0]);
+            ::close(pipeFds[1]);
+            if (path == nullptr) {
+                dup2(input, STDIN_FILENO);
+                ::close(input);
+                execlp(program, program, "-dc", (char*) NULL);
+            }
+            else {
+                execlp(program, program, "-dc", "--", path, (char*) NULL);
+            }
+            _exit(127);
+        }
+        ::close(pipeFds[1]);
+        decompressor = pid;
+        fp = fdopen(pipeFds[0], "rb");
+        return fp != (FILE *) NULL;
+    }
+
+    // Writes all of length bytes to fd; returns false if it cannot
+    static bool writeAll(int fd, const uint8_t* bytes, size_t length) {
+        while (length > 0) {
+            ssize_t count = write(fd, bytes, length);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return false;
+            }
+            bytes += count;
+            length -= size_t(count);
+        }
+        return true;
+    }
+
+    // Starts "program -dc" on standard input and streams its output instead
+    // A feeder process hands the decompressor the bytes of standard input
+    // already in the buffer and then copies the rest of it.
+    bool openStdinDecompressor(const char* program) {
+        int pipeFds[2];
+        if (pipe(pipeFds) != 0) {
+            return false;
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            ::close(pipeFds[0]);
+            ::close(pipeFds[1]);
+            return false;
+        }
+        if (pid == 0) {
+            ::close(pipeFds[0]);
+            bool written = writeAll(pipeFds[1], buffer.data() + bufferPos, bufferLength - bufferPos);
+            size_t count;
+            while (written && (count = fread(buffer.data(), 1, buffer.size(), stdin)) > 0) {
+                written = writeAll(pipeFds[1], buffer.data(), count);
+            }
+            _exit(written ? 0 : 1);
+        }
+        ::close(pipeFds[1]);
+        feeder = pid;
+        bool opened = this->openDecompressor(program, nullptr, pipeFds[0]);
+        ::close(pipeFds[0]);
+        return opened;
+    }
+
+    // Reaps the decompressor; returns false if it did not succeed
+    bool closeDecompressor() {
+        if (decompressor == 0) {
+            return true;
+        }
+        int status = 0;
+        waitpid(decompressor, &status, 0);
+        decompressor = 0;
+        if (feeder != 0) {
+            // Once the decompressor is gone the feeder has nothing left to do,
+            // and it may be waiting for standard input
+            kill(feeder, SIGKILL);
+            waitpid(feeder, NULL, 0);
+            feeder = 0;
+        }
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    // Reads more of a streamed input into the buffer; returns false at the end of the input
+    bool refill() {
+        if (bufferPos < bufferLength) {
+            memmove(buffer.data(), buffer.data() + bufferPos, bufferLength - bufferPos);
+        }
+        bufferLength -= bufferPos;
+        bufferPos = 0;
+        size_t count = fread(buffer.data() + bufferLength, 1, buffer.size() - bufferLength, fp);
+        bufferLength += count;
+        if (count == 0 && !this->closeDecompressor()) {
+            return this->fail("Unable to decompress the trace.");
+        }
+        return count != 0;
+    }
+
+    // Makes at least n bytes of a streamed input available unless it ends first;
+    // returns the number of bytes available, at most n
+    size_t ensure(size_t n) {
+        while (bufferLength - bufferPos < n && this->refill()) {
+        }
+        return std::min(bufferLength - bufferPos, n);
+    }
+
+    // Next byte of a streamed input without consuming it, or -1 at the end
+    int peekByte() {
+        if (bufferPos == bufferLength && !this->refill()) {
+            return -1;
+        }
+        return buffer[bufferPos];
+    }
+
+    // Parses one "%c %x" text request from a streamed input, the way fscanf() did,
+    // after the decimal core ID in front of it if there is one
+    bool nextText(char* rw, uint32_t* addr, uint8_t* core) {
+        int c = this->peekByte();
+        if (c < 0) {
+            return false;
+        }
+        int digit;
+        int tagged = isdigit(c) ? 1 : 0;
+        uint32_t coreId = 0;
+        if (tagged) {
+            while ((digit = this->peekByte()) >= 0 && isdigit(digit)) {
+                coreId = coreId * 10 + uint32_t(digit - '0');
+                if (coreId >= TRACE_MAX_CORES) {
+                    return this->fail("Core ID in the trace is too large.");
+                }
+                bufferPos++;
+            }
+            while ((digit = this->peekByte()) >= 0 && isspace(digit)) {
+                bufferPos++;
+            }
+            if ((c = this->peekByte()) < 0) {
+                return false;
+            }
+        }
+        if (textCores < 0) {
+            textCores = tagged;
+        }
+        else if (textCores != tagged) {
+            return this->fail("Text trace mixes requests with and without core IDs.");
+        }
+        bufferPos++;
+        while ((digit = this->peekByte()) >= 0 && isspace(digit)) {
+            bufferPos++;
+        }
+        // %x also accepts a 0x prefix
+        if (this->ensure(2) == 2 && buffer[bufferPos] == '0' && tolower(buffer[bufferPos + 1]) == 'x') {
+            bufferPos += 2;
+        }
+        uint32_t value = 0;
+        bool anyDigit = false;
+        while ((digit = this->peekByte()) >= 0 && isxdigit(digit)) {
+            value = (value << 4) | uint32_t(isdigit(digit) ? digit - '0' : (tolower(digit) - 'a' + 10));
+            anyDigit = true;
+            bufferPos++;
+        }
+        if (!anyDigit) {
+            return false;
+        }
+        while ((digit = this->peekByte()) >= 0 && isspace(digit)) {
+            bufferPos++;
+        }
+        *rw = char(c);
+        *addr = value;
+        *core = uint8_t(coreId);
+        return true;
+    }
+
+    // Decodes one binary record starting at bytes; returns its length, 0 if it is truncated
+    size_t decodeRecord(const uint8_t* bytes, size_t available, char* rw, uint32_t* addr, uint8_t* core) {
+        if (!delta) {
+            if (available < TRACE_PLAIN_RECORD_SIZE) {
+                return 0;
+            }
+            *rw = (bytes[0] & 1) ? 'w' : 'r';
+            *core = cores ? uint8_t(bytes[0] >> 1) : 0;
+            *addr = uint32_t(bytes[1]) | (uint32_t(bytes[2]) << 8) | (uint32_t(bytes[3]) << 16) | (uint32_t(bytes[4]) << 24);
+            return TRACE_PLAIN_RECORD_SIZE;
+        }
+        uint64_t value = 0;
+        uint32_t shift = 0;
+        size_t length = 0;
+        do {
+            // A record is at most 5 bytes, and its value at most 33 bits
+            if (length == available || shift >= 35) {
+                return 0;
+            }
+            value |= uint64_t(bytes[length] & 0x7F) << shift;
+            shift += 7;
+        } while (bytes[length++] & 0x80);
+        if ((value >> 33) != 0) {
+            return 0;
+        }
+        *core = 0;
+        if (cores) {
+            if (length == available || bytes[length] >= TRACE_MAX_CORES) {
+                return 0;
+            }
+            *core = bytes[length++];
+        }
+        *rw = (value & 1) ? 'w' : 'r';
+        uint32_t zigzag = uint32_t(value >> 1);
+        uint32_t diff = (zigzag >> 1) ^ (0u - (zigzag & 1));
+        prevAddr += diff;
+        *addr = prevAddr;
+        return length;
+    }
+
+    // Sets up a streamed input, detecting a binary header in its first bytes
+    bool openStream() {
+        buffer.resize(TRACE_STREAM_BUFFER_SIZE);
+        bufferPos = 0;
+        bufferLength = 0;
+        size_t available = this->ensure(TRACE_HEADER_SIZE);
+        if (available == TRACE_HEADER_SIZE && memcmp(buffer.data(), TRACE_MAGIC, 4) == 0) {
+            streamBinary = true;
+            this->parseHeader(buffer.data());
+            bufferPos = TRACE_HEADER_SIZE;
+        }
+        // Compressed files already stream through a decompressor; compressed
+        // standard input is detected here and restarted through one
+        else if (available >= 4 && decompressor == 0 && this->isCompressed(buffer.data()) != nullptr) {
+            if (!this->openStdinDecompressor(this->isCompressed(buffer.data()))) {
+                return this->fail("Unable to decompress the trace.");
+            }
+            return this->openStream();
+        }
+        return error == nullptr;
+    }
+
+public:
+    TraceReader() : fp(nullptr), decompressor(0), feeder(0), map(nullptr), mapSize(0), cursor(nullptr), end(nullptr), bufferPos(0), bufferLength(0),
+                    streamBinary(false), recordCount(0), recordsRead(0), delta(false), cores(false), textCores(-1), prevAddr(0), error(nullptr) {
+    }
+
+    ~TraceReader() {
+        this->close();
+    }
+
+    // Opens a trace in any of the supported forms; "-" is standard input
+    // Returns false if it cannot be opened
+    bool open(const char* path) {
+        this->close();
+        if (strcmp(path, "-") == 0) {
+            fp = stdin;
+            return this->openStream();
+        }
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        uint8_t magic[4] = {0, 0, 0, 0};
+        bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+        bool hasMagic = regular && pread(fd, magic, 4, 0) == 4;
+        if (hasMagic && st.st_size >= TRACE_HEADER_SIZE && memcmp(magic, TRACE_MAGIC, 4) == 0) {
+            bool opened = this->openBinary(fd, size_t(st.st_size));
+            ::close(fd);
+            return opened;
+        }
+        const char* decompressorProgram = hasMagic ? this->isCompressed(magic) : nullptr;
+        if (decompressorProgram != nullptr) {
+            ::close(fd);
+            if (!this->openDecompressor(decompressorProgram, path)) {
+                return false;
+            }
+        }
+        else {
+            fp = fdopen(fd, "rb");
+            if (fp == (FILE *) NULL) {
+                ::close(fd);
+                return false;
+            }
+        }
+        return this->openStream();
+    }
+
+    bool isBinary() const {
+        return map != nullptr || streamBinary;
+    }
+
+    // Returns true if the requests carry the ID of the core that issued them;
+    // for a text trace this is known once its first request has been read
+    bool hasCores() const {
+        return this->isBinary() ? cores : textCores == 1;
+    }
+
+    // Why reading stopped before the end of the trace, or nullptr if it did not
+    const char* getError() const {
+        return error;
+    }
+
+    // Fetches the next request and the core that issued it; returns false at
+    // the end of the trace or on an error
+    bool next(char* rw, uint32_t* addr, uint8_t* core) {
+        if (map != nullptr || streamBinary) {
+            if (recordsRead == recordCount) {
+                return false;
+            }
+            size_t length;
+            if (map != nullptr) {
+                length = this->decodeRecord(cursor, size_t(end - cursor), rw, addr, core);
+                cursor += length;
+            }
+            else {
+                length = this->decodeRecord(buffer.data() + bufferPos, this->ensure(TRACE_PLAIN_RECORD_SIZE + 1), rw, addr, core);
+                bufferPos += length;
+            }
+            if (length == 0) {
+                return this->fail("Binary trace is truncated or corrupt.");
+            }
+            recordsRead++;
+            return true;
+        }
+        if (fp != nullptr && this->nextText(rw, addr, core)) {
+            recordsRead++;
+            return true;
+        }
+        return false;
+    }
+
+    // Decodes up to maxRecords requests into records; returns how many were decoded
+    // Stops early at a request type other than r or w and stores it in badType
+    // (0 if there was none); records before it are returned as usual
+    size_t readValid(TraceRecord* records, size_t maxRecords, char* badType) {
+        size_t count = 0;
+        *badType = 0;
+        while (count < maxRecords && this->next(&records[count].rw, &records[count].addr, &records[count].core)) {
+            if (records[count].rw != 'r' && records[count].rw != 'w') {
+                *badType = records[count].rw;
+                break;
+            }
+            count++;
+        }
+        return count;
+    }
+
+    // Decodes up to maxRecords requests into records; returns how many were decoded
+    // Exits with an error on a request type other than r or w or an unreadable trace
+    size_t read(TraceRecord* records, size_t maxRecords) {
+        char badType;
+        size_t count = this->readValid(records, maxRecords, &badType);
+        if (badType != 0) {
+            printf("Error: Unknown request type %c.\n", badType);
+            exit(EXIT_FAILURE);
+        }
+        if (count < maxRecords && error != nullptr) {
+            printf("Error: %s\n", error);
+            exit(EXIT_FAILURE);
+        }
+        return count;
+    }
+
+    // Decodes every remaining request of the trace into records
+    void readAll(std::vector<TraceRecord>* records) {
+        const size_t chunkRecords = 1 << 16;
+        if (map != nullptr) {
+            records->reserve(records->size() + size_t(recordCount - recordsRead));
+        }
+        size_t count;
+        do {
+            size_t start = records->size();
+            records->resize(start + chunkRecords);
+            count = this->read(records->data() + start, chunkRecords);
+            records->resize(start + count);
+        } while (count == chunkRecords);
+    }
+
+    void close() {
+        if (map != nullptr) {
+            munmap(const_cast<uint8_t*>(map), mapSize);
+            map = nullptr;
+        }
+        if (fp != nullptr) {
+            if (fp != stdin) {
+                fclose(fp);
+            }
+            fp = nullptr;
+        }
+        this->closeDecompressor();
+        streamBinary = false;
+        bufferPos = 0;
+        bufferLength = 0;
+        recordsRead = 0;
+        cores = false;
+        textCores = -1;
+        prevAddr = 0;
+        error = nullptr;
+    }
+};
+
+// Size of the write buffer of the trace writers
+#define TRACE_WRITE_BUFFER_SIZE (1 << 20)
+
+// Writes a binary trace
+// Records are encoded into a write buffer; the record count in the header is
+// patched in when the writer is closed
+class TraceWriter {
+private:
+    FILE* fp;
+    bool delta;
+    bool cores;
+    uint32_t prevAddr;
+    uint64_t recordCount;
+    std::vector<uint8_t> buffer;
+    size_t buffered; // bytes in buffer not written yet
+
+    void writeHeader() {
+        uint8_t header[TRACE_HEADER_SIZE];
+        memcpy(header, TRACE_MAGIC, 4);
+        uint32_t flags = (delta ? TRACE_FLAG_DELTA : 0) | (cores ? TRACE_FLAG_CORES : 0);
+        header[4] = TRACE_VERSION & 0xFF;
+        header[5] = (TRACE_VERSION >> 8) & 0xFF;
+        header[6] = flags & 0xFF;
+        header[7] = (flags >> 8) & 0xFF;
+        for (int i = 0; i < 8; ++i) {
+            header[8 + i] = uint8_t(recordCount >> (8 * i));
+        }
+        fwrite(header, 1, TRACE_HEADER_SIZE, fp);
+    }
+
+    void flush() {
+        fwrite(buffer.data(), 1, buffered, fp);
+        buffered = 0;
+    }
+
+public:
+    TraceWriter() : fp(nullptr), delta(false), cores(false), prevAddr(0), recordCount(0), buffered(0) {
+    }
+
+    ~TraceWriter() {
+        this->close();
+    }
+
+    // withCores: records carry the ID of the core that issued them
+    bool open(const char* path, bool deltaEncoded, bool withCores) {
+        fp = fopen(path, "wb");
+        if (fp == (FILE *) NULL) {
+            return false;
+        }
+        delta = deltaEncoded;
+        cores = withCores;
+        prevAddr = 0;
+        recordCount = 0;
+        buffer.resize(TRACE_WRITE_BUFFER_SIZE);
+        buffered = 0;
+        this->writeHeader();
+        return true;
+    }
+
+    // core must be below TRACE_MAX_CORES, and 0 unless the writer was opened withCores
+    void write(char rw, uint32_t addr, uint8_t core) {
+        if (buffered + TRACE_PLAIN_RECORD_SIZE + 1 > buffer.size()) {
+            this->flush();
+        }
+        uint8_t* record = buffer.data() + buffered;
+        size_t length = 0;
+        if (!delta) {
+            record[0] = uint8_t(((rw == 'w') ? 1 : 0) | (core << 1));
+            record[1] = addr & 0xFF;
+            record[2] = (addr >> 8) & 0xFF;
+            record[3] = (addr >> 16) & 0xFF;
+            record[4] = (addr >> 24) & 0xFF;
+            length = TRACE_PLAIN_RECORD_SIZE;
+        }
+        else {
+            uint32_t diff = addr - prevAddr;
+            uint32_t zigzag = (diff << 1) ^ (0u - (diff >> 31));
+            uint64_t value = (uint64_t(zigzag) << 1) | ((rw == 'w') ? 1 : 0);
+            do {
+                uint8_t byte = value & 0x7F;
+                value >>= 7;
+                record[length++] = byte | (value != 0 ? 0x80 : 0);
+            } while (value != 0);
+            if (cores) {
+                record[length++] = core;
+            }
+            prevAddr = addr;
+        }
+        buffered += length;
+        recordCount++;
+    }
+
+    // Writes count records; the core IDs are written only if the writer was opened withCores
+    void write(const TraceRecord* records, size_t count) {
+        if (delta) {
+            for (size_t i = 0; i < count; ++i) {
+                this->write(records[i].rw, records[i].addr, cores ? records[i].core : 0);
+            }
+            return;
+        }
+        while (count != 0) {
+            size_t room = (buffer.size() - buffered) / TRACE_PLAIN_RECORD_SIZE;
+            if (room == 0) {
+                this->flush();
+                continue;
+            }
+            room = (room < count) ? room : count;
+            uint8_t* record = buffer.data() + buffered;
+            for (size_t i = 0; i < room; ++i, record += TRACE_PLAIN_RECORD_SIZE) {
+                uint32_t addr = records[i].addr;
+                record[0] = uint8_t(((records[i].rw == 'w') ? 1 : 0) | (cores ? records[i].core << 1 : 0));
+                record[1] = addr & 0xFF;
+                record[2] = (addr >> 8) & 0xFF;
+                record[3] = (addr >> 16) & 0xFF;
+                record[4] = (addr >> 24) & 0xFF;
+            }
+            buffered += room * TRACE_PLAIN_RECORD_SIZE;
+            recordCount += room;
+            records += room;
+            count -= room;
+        }
+    }
+
+    uint64_t getRecordCount() const {
+        return recordCount;
+    }
+
+    // Finalises the header and closes the file; returns false on a write error
+    bool close() {
+        if (fp == nullptr) {
+            return true;
+        }
+        this->flush();
+        fseek(fp, 0, SEEK_SET);
+        this->writeHeader();
+        bool ok = (ferror(fp) == 0);
+        ok = (fclose(fp) == 0) && ok;
+        fp = nullptr;
+        return ok;
+    }
+};
+
+// Writes a text trace, "r 7b0335b8" per line, to a file or to standard output ("-")
+class TextTraceWriter {
+private:
+    FILE* fp;
+    uint64_t recordCount;
+    std::vector<char> buffer;
+    size_t buffered; // bytes in buffer not written yet
+
+    void flush() {
+        fwrite(buffer.data(), 1, buffered, fp);
+        buffered = 0;
+    }
+
+public:
+    TextTraceWriter() : fp(nullptr), recordCount(0), buffered(0) {
+    }
+
+    ~TextTraceWriter() {
+        this->close();
+    }
+
+    bool open(const char* path) {
+        fp = (strcmp(path, "-") == 0) ? stdout : fopen(path, "w");
+        if (fp == (FILE *) NULL) {
+            return false;
+        }
+        recordCount = 0;
+        buffer.resize(TRACE_WRITE_BUFFER_SIZE);
+        buffered = 0;
+        return true;
+    }
+
+    // The address is written in lowercase hex without leading zeros, as in the SPEC traces
+    void write(char rw, uint32_t addr) {
+        static const char digits[] = "0123456789abcdef";
+        if (buffered + 16 > buffer.size()) {
+            this->flush();
+        }
+        char* line = buffer.data() + buffered;
+        uint32_t length = (35 - uint32_t(__builtin_clz(addr | 1))) / 4;
+        line[0] = rw;
+        line[1] = ' ';
+        for (uint32_t i = 0; i < length; ++i) {
+            line[1 + length - i] = digits[(addr >> (4 * i)) & 0xF];
+        }
+        line[2 + length] = '\n';
+        buffered += 3 + length;
+        recordCount++;
+    }
+
+    uint64_t getRecordCount() const {
+        return recordCount;
+    }
+
+    // Returns false on a write error
+    bool close() {
+        if (fp == nullptr) {
+            return true;
+        }
+        this->flush();
+        bool ok = (ferror(fp) == 0);
+        ok = ((fp == stdout) ? fflush(fp) : fclose(fp)) == 0 && ok;
+        fp = nullptr;
+        return ok;
+    }
+};
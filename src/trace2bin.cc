@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "trace.cpp"
+
+/*  Converts a text trace into the binary trace format read by sim.
+    The input may be gzip or zstd compressed, or "-" for standard input.
+    Core IDs in front of the requests ("3 r 7b0335b8") are kept.
+
+    Example:
+    ./trace2bin spec/traces/gcc_trace.txt gcc_trace.bin
+    ./trace2bin --delta spec/traces/gcc_trace.txt gcc_trace.bin
+
+    --delta stores each address as a varint delta from the previous one,
+    which is considerably smaller for traces with spatial locality.
+*/
+int main (int argc, char *argv[]) {
+   bool delta = false;
+   int argIndex = 1;
+   if (argIndex < argc && strcmp(argv[argIndex], "--delta") == 0) {
+      delta = true;
+      argIndex++;
+   }
+   if (argc - argIndex != 2) {
+      printf("Usage: %s [--delta] <text trace> <binary trace>\n", argv[0]);
+      exit(EXIT_FAILURE);
+   }
+   const char* inFile = argv[argIndex];
+   const char* outFile = argv[argIndex + 1];
+
+   TraceReader reader;
+   if (!reader.open(inFile)) {
+      printf("Error: Unable to open file %s\n", inFile);
+      exit(EXIT_FAILURE);
+   }
+   // Whether the requests carry core IDs is known once the first one is read
+   char rw;
+   uint32_t addr;
+   uint8_t core;
+   bool more = reader.next(&rw, &addr, &core);
+   TraceWriter writer;
+   if (!writer.open(outFile, delta, reader.hasCores())) {
+      printf("Error: Unable to open file %s\n", outFile);
+      exit(EXIT_FAILURE);
+   }
+   for (; more; more = reader.next(&rw, &addr, &core)) {
+      if (rw != 'r' && rw != 'w') {
+         printf("Error: Unknown request type %c.\n", rw);
+         exit(EXIT_FAILURE);
+      }
+      writer.write(rw, addr, core);
+   }
+   if (reader.getError() != nullptr) {
+      printf("Error: %s\n", reader.getError());
+      exit(EXIT_FAILURE);
+   }
+   uint64_t records = writer.getRecordCount();
+   if (!writer.close()) {
+      printf("Error: Unable to write file %s\n", outFile);
+      exit(EXIT_FAILURE);
+   }
+   printf("%s: %" PRIu64 " records written to %s\n", inFile, records, outFile);
+   return(0);
+}
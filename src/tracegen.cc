@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <thread>
+#include <vector>
+#include "trace.cpp"
+#include "synth.cpp"
+
+/*  Writes a deterministic synthetic trace, binary or text, for profiling
+    and stress testing the simulator with traces of any length.
+    The patterns are described at the top of src/synth.cpp.
+
+    Example:
+    ./tracegen --footprint=256M zipf 1G zipf.bin
+    ./tracegen --streams=4 --writes=0.1 seq 100M streams.bin
+    ./tracegen --text --mix=seq,chase --phase=50000 mix 1M - | ./sim 32 8192 4 262144 8 0 0 -
+
+    The same options and seed always give the same trace, whatever the
+    number of threads.
+*/
+static void printUsage(const char* program) {
+   printf("Usage: %s [options] <pattern> <requests> <trace file>\n", program);
+   printf("  pattern                seq, stride, random, zipf, chase or mix\n");
+   printf("  requests               number of requests; K, M and G multiply by 10^3, 10^6 and 10^9\n");
+   printf("  trace file             binary trace, or with --text a text trace (\"-\" for standard output)\n");
+   printf("Options:\n");
+   printf("  --seed=N               random seed (default 1)\n");
+   printf("  --footprint=B          bytes the requests cover; K, M and G multiply by 2^10, 2^20 and 2^30\n");
+   printf("                         (default 64M)\n");
+   printf("  --base=ADDR            first address of the footprint, in hex (default 10000000)\n");
+   printf("  --align=B              bytes a request covers; addresses are multiples of it (default 4)\n");
+   printf("  --writes=F             fraction of requests that are writes (default 0.3)\n");
+   printf("  --streams=N            seq and stride: interleaved streams (default 1)\n");
+   printf("  --stride=B             stride: bytes between the requests of a stream (default 256)\n");
+   printf("  --zipf=S               zipf: exponent (default 0.99)\n");
+   printf("  --mix=P,P,...          mix: patterns taking turns (default seq,stride,random,zipf,chase)\n");
+   printf("  --phase=N              mix: requests of each phase (default 1M)\n");
+   printf("  --text                 write a text trace\n");
+   printf("  --delta                write a delta encoded binary trace\n");
+   printf("  --threads=N            generate on N threads (default 0: one per hardware thread)\n");
+}
+
+// Parses a count with an optional K, M or G suffix multiplying by unit, unit^2 or unit^3;
+// returns false if it is not one
+static bool parseCount(const char* text, uint64_t unit, uint64_t* value) {
+   char* end;
+   unsigned long long count = strtoull(text, &end, 10);
+   if (end == text || text[0] == '-') {
+      return false;
+   }
+   uint64_t multiplier = 1;
+   switch (*end) {
+   case 'g': case 'G': multiplier *= unit;   // fall through
+   case 'm': case 'M': multiplier *= unit;   // fall through
+   case 'k': case 'K': multiplier *= unit;
+      end++;
+      break;
+   default:
+      break;
+   }
+   if (*end != '\0' || (count != 0 && multiplier > UINT64_MAX / count)) {
+      return false;
+   }
+   *value = uint64_t(count) * multiplier;
+   return true;
+}
+
+// Index of a pattern name in synthPatternNames, or SYNTH_PATTERN_COUNT if there is none
+static uint32_t findPattern(const char* name, size_t length) {
+   for (uint32_t p = 0; p < SYNTH_PATTERN_COUNT; ++p) {
+      if (strlen(synthPatternNames[p]) == length && strncmp(name, synthPatternNames[p], length) == 0) {
+         return p;
+      }
+   }
+   return SYNTH_PATTERN_COUNT;
+}
+
+static void badOption(const char* option) {
+   printf("Error: Invalid option %s.\n", option);
+   exit(EXIT_FAILURE);
+}
+
+// Generates chunks first to first + count - 1 into buffers on threads threads
+static void generateChunks(const TraceSynthesizer* synthesizer, uint64_t first, uint64_t count, uint64_t requests,
+                           std::vector<std::vector<TraceRecord>>* buffers, unsigned threads) {
+   std::vector<std::thread> workers;
+   for (unsigned t = 0; t < threads && t < count; ++t) {
+      workers.push_back(std::thread([=]() {
+         for (uint64_t c = t; c < count; c += threads) {
+            uint64_t start = (first + c) * SYNTH_CHUNK_RECORDS;
+            uint64_t length = (requests - start < SYNTH_CHUNK_RECORDS) ? requests - start : SYNTH_CHUNK_RECORDS;
+            (*buffers)[c].resize(size_t(length));
+            synthesizer->generate(first + c, size_t(length), (*buffers)[c].data());
+         }
+      }));
+   }
+   for (auto& worker : workers) {
+      worker.join();
+   }
+}
+
+int main (int argc, char *argv[]) {
+   synth_params_t params;
+   params.seed = 1;
+   params.base = 0x10000000;
+   params.footprint = 64ull << 20;
+   params.align = 4;
+   params.writes = 0.3;
+   params.streams = 1;
+   params.stride = 256;
+   params.zipfExponent = 0.99;
+   params.mixCount = 0;
+   for (uint32_t p = 0; p < SYNTH_MIX; ++p) {
+      params.mix[params.mixCount++] = p;
+   }
+   params.phaseRecords = 1000000;
+   bool text = false;
+   bool delta = false;
+   unsigned threads = 0;
+
+   int argIndex = 1;
+   for (; argIndex < argc && strncmp(argv[argIndex], "--", 2) == 0; ++argIndex) {
+      const char* option = argv[argIndex];
+      const char* value = strchr(option, '=');
+      value = (value != nullptr) ? value + 1 : "";
+      uint64_t number;
+      char* end;
+      if (strncmp(option, "--seed=", 7) == 0) {
+         params.seed = strtoull(value, &end, 10);
+         if (end == value || *end != '\0') {
+            badOption(option);
+         }
+      }
+      else if (strncmp(option, "--footprint=", 12) == 0) {
+         if (!parseCount(value, 1024, &params.footprint)) {
+            badOption(option);
+         }
+      }
+      else if (strncmp(option, "--base=", 7) == 0) {
+         number = strtoull(value, &end, 16);
+         if (end == value || *end != '\0' || number > UINT32_MAX) {
+            badOption(option);
+         }
+         params.base = uint32_t(number);
+      }
+      else if (strncmp(option, "--align=", 8) == 0) {
+         if (!parseCount(value, 1024, &number) || number == 0 || number > UINT32_MAX) {
+            badOption(option);
+         }
+         params.align = uint32_t(number);
+      }
+      else if (strncmp(option, "--writes=", 9) == 0) {
+         params.writes = strtod(value, &end);
+         if (end == value || *end != '\0' || !(params.writes >= 0.0 && params.writes <= 1.0)) {
+            badOption(option);
+         }
+      }
+      else if (strncmp(option, "--streams=", 10) == 0) {
+         if (!parseCount(value, 1000, &number) || number == 0 || number > UINT32_MAX) {
+            badOption(option);
+         }
+         params.streams = uint32_t(number);
+      }
+      else if (strncmp(option, "--stride=", 9) == 0) {
+         if (!parseCount(value, 1024, &number) || number == 0 || number > UINT32_MAX) {
+            badOption(option);
+         }
+         params.stride = uint32_t(number);
+      }
+      else if (strncmp(option, "--zipf=", 7) == 0) {
+         params.zipfExponent = strtod(value, &end);
+         if (end == value || *end != '\0' || !(params.zipfExponent > 0.0 && params.zipfExponent <= 10.0)) {
+            badOption(option);
+         }
+      }
+      else if (strncmp(option, "--mix=", 6) == 0) {
+         params.mixCount = 0;
+         const char* name = value;
+         while (true) {
+            const char* comma = strchr(name, ',');
+            size_t length = (comma != nullptr) ? size_t(comma - name) : strlen(name);
+            uint32_t pattern = findPattern(name, length);
+            if (pattern >= SYNTH_MIX || params.mixCount == SYNTH_MIX) {
+               badOption(option);
+            }
+            params.mix[params.mixCount++] = pattern;
+            if (comma == nullptr) {
+               break;
+            }
+            name = comma + 1;
+         }
+      }
+      else if (strncmp(option, "--phase=", 8) == 0) {
+         if (!parseCount(value, 1000, &params.phaseRecords) || params.phaseRecords == 0) {
+            badOption(option);
+         }
+      }
+      else if (strncmp(option, "--threads=", 10) == 0) {
+         if (!parseCount(value, 1000, &number) || number > 1024) {
+            badOption(option);
+         }
+         threads = unsigned(number);
+      }
+      else if (strcmp(option, "--text") == 0) {
+         text = true;
+      }
+      else if (strcmp(option, "--delta") == 0) {
+         delta = true;
+      }
+      else {
+         badOption(option);
+      }
+   }
+   if (argc - argIndex != 3) {
+      printUsage(argv[0]);
+      exit(EXIT_FAILURE);
+   }
+   params.pattern = findPattern(argv[argIndex], strlen(argv[argIndex]));
+   if (params.pattern == SYNTH_PATTERN_COUNT) {
+      printf("Error: Unknown pattern %s.\n", argv[argIndex]);
+      exit(EXIT_FAILURE);
+   }
+   uint64_t requests;
+   if (!parseCount(argv[argIndex + 1], 1000, &requests)) {
+      printf("Error: Invalid number of requests %s.\n", argv[argIndex + 1]);
+      exit(EXIT_FAILURE);
+   }
+   const char* outFile = argv[argIndex + 2];
+
+   // The footprint must hold at least one unit per stream and end within the 32-bit address space
+   uint64_t units = params.footprint / params.align;
+   if (params.footprint % params.align != 0 || units == 0 || units > UINT32_MAX || units < params.streams || params.base % params.align != 0
+       || uint64_t(params.base) + params.footprint > (1ull << 32)) {
+      printf("Error: The footprint must be a multiple of the alignment, aligned, fit below 4 GB and hold a unit for each stream.\n");
+      exit(EXIT_FAILURE);
+   }
+   if (TraceSynthesizer::uses(params, SYNTH_STRIDE) && params.stride % params.align != 0) {
+      printf("Error: The stride must be a multiple of the alignment.\n");
+      exit(EXIT_FAILURE);
+   }
+   if (TraceSynthesizer::uses(params, SYNTH_CHASE) && units > SYNTH_MAX_CHASE_UNITS) {
+      printf("Error: A pointer chase covers at most %u units; use a smaller footprint or a larger alignment.\n", SYNTH_MAX_CHASE_UNITS);
+      exit(EXIT_FAILURE);
+   }
+   if (text && delta) {
+      fprintf(stderr, "Warning: --delta only applies to binary traces; ignored\n");
+   }
+   if (!text && strcmp(outFile, "-") == 0) {
+      printf("Error: Binary traces are written to a file; use --text for standard output.\n");
+      exit(EXIT_FAILURE);
+   }
+   if (threads == 0) {
+      threads = std::thread::hardware_concurrency();
+      threads = (threads == 0) ? 1 : threads;
+   }
+
+   TraceWriter writer;
+   TextTraceWriter textWriter;
+   if (text ? !textWriter.open(outFile) : !writer.open(outFile, delta, false)) {
+      printf("Error: Unable to open file %s\n", outFile);
+      exit(EXIT_FAILURE);
+   }
+   TraceSynthesizer synthesizer(params);
+
+   // A batch of chunks is generated while the one before it is written
+   uint64_t chunks = (requests + SYNTH_CHUNK_RECORDS - 1) / SYNTH_CHUNK_RECORDS;
+   uint64_t batchChunks = uint64_t(threads) * 2;
+   std::vector<std::vector<TraceRecord>> batches[2];
+   batches[0].resize(size_t(batchChunks));
+   batches[1].resize(size_t(batchChunks));
+   uint64_t count = (chunks < batchChunks) ? chunks : batchChunks;
+   generateChunks(&synthesizer, 0, count, requests, &batches[0], threads);
+   for (uint64_t first = 0, current = 0; first < chunks; first += batchChunks, current ^= 1) {
+      uint64_t next = first + batchChunks;
+      std::thread producer;
+      if (next < chunks) {
+         count = (chunks - next < batchChunks) ? chunks - next : batchChunks;
+         producer = std::thread(generateChunks, &synthesizer, next, count, requests, &batches[current ^ 1], threads);
+      }
+      for (uint64_t c = 0; c < batchChunks && first + c < chunks; ++c) {
+         const std::vector<TraceRecord>& records = batches[current][c];
+         if (text) {
+            for (const TraceRecord& record : records) {
+               textWriter.write(record.rw, record.addr);
+            }
+         }
+         else {
+            writer.write(records.data(), records.size());
+         }
+      }
+      if (producer.joinable()) {
+         producer.join();
+      }
+   }
+   if (!(text ? textWriter.close() : writer.close())) {
+      printf("Error: Unable to write file %s\n", outFile);
+      exit(EXIT_FAILURE);
+   }
+   // Keep standard output for the trace itself
+   fprintf(stderr, "%s: %" PRIu64 " requests written to %s\n", synthPatternNames[params.pattern], requests, outFile);
+   return(0);
+}
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+
+// Write policies and write buffers
+//
+// The write policy of a level decides what a write does there:
+//    wbwa  write-back, write-allocate (the default): a write hit sets the dirty
+//          bit, a write miss fetches the block first; dirty blocks are written
+//          back when they are evicted
+//    wbna  write-back, no-write-allocate: as wbwa, but a write miss leaves the
+//          level as it was and passes the write on to the next level
+//    wtwa  write-through, write-allocate: every write is passed on at once, so
+//          blocks are never dirty; a write miss still fetches the block
+//    wtna  write-through, no-write-allocate: every write is passed on at once
+//          and a write miss does not fetch the block
+// A write miss that a stream buffer or a victim or miss cache can serve is
+// not a miss, so it allocates under every policy.
+//
+// A write buffer sits below a level and holds the writes the level passes on,
+// written through, around or back, one entry per block. A write to a block
+// already buffered merges into its entry. The simulator has no clock but the
+// trace, so the buffer drains its oldest entry to the next level every
+// `interval` requests of the trace. A write that finds the buffer full stalls
+// until the oldest entry has drained, and a miss of the level for a block
+// still in the buffer stalls until that entry and everything before it has
+// drained, so the next level sees the write before the read. Entries drain
+// lazily, whenever the level next uses its buffer; nothing else reaches the
+// next level in between, so it sees the writes in the same order. At the end
+// of the trace every entry left drains, so the measurements count every write.
+
+enum WritePolicy {WRITE_WBWA=0, WRITE_WBNA, WRITE_WTWA, WRITE_WTNA, WRITE_POLICY_COUNT};
+
+static const char* const writePolicyNames[WRITE_POLICY_COUNT] = {"wbwa", "wbna", "wtwa", "wtna"};
+
+#define WRITE_BUFFER_MAX_ENTRIES 1024
+#define WRITE_BUFFER_DRAIN_INTERVAL 4 // requests of the trace per drained entry unless given
+
+static inline bool isWriteThrough(uint32_t policy) {
+    return policy == WRITE_WTWA || policy == WRITE_WTNA;
+}
+
+static inline bool isWriteAllocate(uint32_t policy) {
+    return policy == WRITE_WBWA || policy == WRITE_WTWA;
+}
+
+// Counters of one write buffer
+typedef
+struct {
+   uint64_t writes;	// writes that entered the buffer
+   uint64_t merges;	// ...of which merged into the entry of a block already buffered
+   uint64_t drains;	// entries written to the next level: the traffic the buffer sends down
+   uint64_t fullStalls;	// writes that found the buffer full
+   uint64_t readStalls;	// misses that waited for a buffered write to the block they fetch
+   uint32_t peak;	// most entries in use at once
+} write_buffer_counters_t;
+
+class WriteBuffer {
+private:
+    const uint64_t* clock; // requests of the trace issued so far
+    uint32_t interval; // requests of the trace per drained entry
+    uint32_t count; // entries in use, the first count of blocks
+    uint32_t nextDrain; // low 32 bits of the clock at which the oldest entry drains
+    std::vector<uint32_t> blocks; // block numbers (tag and index), oldest first
+    uint64_t endDrains; // entries drained at the end of the trace
+
+    // Drops the oldest entry; the next one drains interval requests from now
+    uint32_t pop() {
+        uint32_t block = blocks[0];
+        count--;
+        memmove(blocks.data(), blocks.data() + 1, count * sizeof(uint32_t));
+        nextDrain = uint32_t(*clock) + interval;
+        counters.drains++;
+        return block;
+    }
+
+public:
+    write_buffer_counters_t counters;
+
+    WriteBuffer(uint32_t entries, uint32_t interval, const uint64_t* clock)
+        : clock(clock), interval(interval), count(0), nextDrain(0), blocks(entries, 0), endDrains(0) {
+        memset(&counters, 0, sizeof(counters));
+    }
+
+    uint32_t getEntryCount() const {
+        return uint32_t(blocks.size());
+    }
+
+    uint32_t getInterval() const {
+        return interval;
+    }
+
+    uint64_t getEndDrains() const {
+        return endDrains;
+    }
+
+    // Removes the oldest entry if its time has come; returns true and sets *block to it
+    bool drainDue(uint32_t* block) {
+        if (count == 0 || int32_t(uint32_t(*clock) - nextDrain) < 0) {
+            return false;
+        }
+        // Entries after the first drain interval requests apart, from when the one before them was due
+        uint32_t due = nextDrain;
+        *block = this->pop();
+        nextDrain = due + interval;
+        return true;
+    }
+
+    // Removes the oldest entry, due or not, at the end of the trace; returns
+    // true and sets *block to it, or false if the buffer is empty
+    bool drainAtEnd(uint32_t* block) {
+        if (count == 0) {
+            return false;
+        }
+        *block = this->pop();
+        endDrains++;
+        return true;
+    }
+
+    // Removes the oldest entry if block is still buffered, after which the
+    // level may fetch it; returns true and sets *drained to the entry removed
+    bool drainFor(uint32_t block, uint32_t* drained) {
+        if (findTag(blocks.data(), count, block) == count) {
+            return false;
+        }
+        *drained = this->pop();
+        if (*drained == block) {
+            counters.readStalls++;
+        }
+        return true;
+    }
+
+    // Removes the oldest entry if there is no room for another; returns true and sets *drained to it
+    bool drainForRoom(uint32_t block, uint32_t* drained) {
+        if (count < blocks.size() || findTag(blocks.data(), count, block) != count) {
+            return false;
+        }
+        counters.fullStalls++;
+        *drained = this->pop();
+        return true;
+    }
+
+    // Buffers a write of block, merging it into an entry of the same block;
+    // the caller has made room with drainDue() and drainForRoom()
+    void write(uint32_t block) {
+        counters.writes++;
+        if (findTag(blocks.data(), count, block) != count) {
+            counters.merges++;
+            return;
+        }
+        if (count == 0) {
+            nextDrain = uint32_t(*clock) + interval;
+        }
+        blocks[count++] = block;
+        if (count > counters.peak) {
+            counters.peak = count;
+        }
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.put(count);
+        out.put(nextDrain);
+        out.putVector(blocks);
+        out.put(counters);
+    }
+
+    void restore(SnapshotReader& in) {
+        in.get(&count);
+        in.get(&nextDrain);
+        in.getVector(&blocks);
+        in.get(&counters);
+        if (count > blocks.size()) {
+            SnapshotReader::corrupt();
+        }
+    }
+};
+
+// Looks up a write policy by name; returns false if there is no such policy
+static bool parseWritePolicy(const char* name, uint32_t* policy) {
+    for (uint32_t i = 0; i < WRITE_POLICY_COUNT; ++i) {
+        if (strcmp(name, writePolicyNames[i]) == 0) {
+            *policy = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses "POLICY" (every level), "L1:POLICY" or "L2:POLICY"; level is 0 for
+// every level. Returns false on anything else.
+static bool parseLevelWritePolicy(const char* text, uint32_t* level, uint32_t* policy) {
+    *level = 0;
+    if (text[0] == 'L' && (text[1] == '1' || text[1] == '2') && text[2] == ':') {
+        *level = uint32_t(text[1] - '0');
+        text += 3;
+    }
+    return parseWritePolicy(text, policy);
+}
@@ -0,0 +1,121 @@
+#ifndef SIM_XXHASH_CPP
+#define SIM_XXHASH_CPP
+
+#include <string.h>
+#include <inttypes.h>
+
+// XXH64 (https://github.com/Cyan4973/xxHash) of a stream of bytes, fed in
+// pieces of any length; digests the requests a snapshot covers (see
+// snapshot.cpp). Every file that hashes includes this one itself.
+class Xxh64 {
+private:
+    static const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+    static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+    static const uint64_t PRIME3 = 0x165667B19E3779F9ull;
+    static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+    static const uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+    uint64_t seed;
+    uint64_t lanes[4];
+    uint64_t total; // bytes fed so far
+    uint8_t stripe[32]; // bytes of an incomplete stripe...
+    uint32_t buffered; // ...and how many
+
+    static uint64_t rotl(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    static uint64_t read64(const uint8_t* bytes) {
+        uint64_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    static uint64_t round(uint64_t lane, uint64_t input) {
+        return rotl(lane + input * PRIME2, 31) * PRIME1;
+    }
+
+    static uint64_t merge(uint64_t hash, uint64_t lane) {
+        return (hash ^ round(0, lane)) * PRIME1 + PRIME4;
+    }
+
+    void consume(const uint8_t* bytes) {
+        for (int i = 0; i < 4; ++i) {
+            lanes[i] = round(lanes[i], read64(bytes + 8 * i));
+        }
+    }
+
+public:
+    Xxh64(uint64_t seed = 0) : seed(seed), total(0), buffered(0) {
+        lanes[0] = seed + PRIME1 + PRIME2;
+        lanes[1] = seed + PRIME2;
+        lanes[2] = seed;
+        lanes[3] = seed - PRIME1;
+    }
+
+    void update(const void* data, size_t length) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        total += length;
+        if (buffered + length < 32) {
+            memcpy(stripe + buffered, bytes, length);
+            buffered += uint32_t(length);
+            return;
+        }
+        if (buffered != 0) {
+            size_t fill = 32 - buffered;
+            memcpy(stripe + buffered, bytes, fill);
+            this->consume(stripe);
+            bytes += fill;
+            length -= fill;
+            buffered = 0;
+        }
+        for (; length >= 32; bytes += 32, length -= 32) {
+            this->consume(bytes);
+        }
+        memcpy(stripe, bytes, length);
+        buffered = uint32_t(length);
+    }
+
+    uint64_t digest() const {
+        uint64_t hash;
+        if (total >= 32) {
+            hash = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+            for (int i = 0; i < 4; ++i) {
+                hash = merge(hash, lanes[i]);
+            }
+        }
+        else {
+            hash = seed + PRIME5;
+        }
+        hash += total;
+        const uint8_t* bytes = stripe;
+        uint32_t left = buffered;
+        for (; left >= 8; bytes += 8, left -= 8) {
+            hash = rotl(hash ^ round(0, read64(bytes)), 27) * PRIME1 + PRIME4;
+        }
+        if (left >= 4) {
+            uint32_t word;
+            memcpy(&word, bytes, sizeof(word));
+            hash = rotl(hash ^ (uint64_t(word) * PRIME1), 23) * PRIME2 + PRIME3;
+            bytes += 4;
+            left -= 4;
+        }
+        for (; left > 0; ++bytes, --left) {
+            hash = rotl(hash ^ (*bytes * PRIME5), 11) * PRIME1;
+        }
+        hash ^= hash >> 33;
+        hash *= PRIME2;
+        hash ^= hash >> 29;
+        hash *= PRIME3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    static uint64_t of(const void* data, size_t length) {
+        Xxh64 hash;
+        hash.update(data, length);
+        return hash.digest();
+    }
+};
+
+#endif